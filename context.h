@@ -0,0 +1,275 @@
+/******************************************************************************\
+* Project:  RSP Emulation Context                                              *
+* License:  CC0 Public Domain Dedication                                       *
+*                                                                              *
+* To the extent possible under law, the author(s) have dedicated all copyright *
+* and related and neighboring rights to this software to the public domain     *
+* worldwide. This software is distributed without any warranty.                *
+*                                                                              *
+* You should have received a copy of the CC0 Public Domain Dedication along    *
+* with this software.                                                          *
+* If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.             *
+\******************************************************************************/
+
+#ifndef _CONTEXT_H_
+#define _CONTEXT_H_
+
+/*
+ * This is included by vu/vu.h, once N and VR_STATIC_WRAPAROUND are defined.
+ */
+#include "my_types.h"
+#include "rsp.h"
+
+/*
+ * Everything one emulated RSP keeps between two instructions, or from one
+ * task to the next, is in one rsp_context.  The old global names (SR, VR,
+ * DMEM, ...) are macros for its members, further below.
+ *
+ * Normally there is just the one context, at a fixed address, so accessing
+ * it costs the same as when these were separate globals.  Building with
+ * RSP_REENTRANT (REENTRANT=1 with the Unix makefile) gives every thread its
+ * own context instead, so that hosts can run one RSP per thread in the same
+ * process.  Each thread then has to call RomOpen() or InitiateRSP() for
+ * itself, which allocates the thread's context, and PluginShutdown() frees
+ * it again.
+ *
+ * Only the pointer to the thread's context is thread-local then, and with
+ * the initial-exec model where the compiler has it, so that finding it is
+ * one load and not a call into the dynamic linker.  That model has to fit
+ * all of the plugin's thread-local storage into the little the C library
+ * keeps spare for libraries loaded at run time, so nothing else may be.
+ */
+#ifdef RSP_REENTRANT
+#if defined(_MSC_VER)
+#define THREAD_LOCAL    __declspec(thread)
+#elif defined(__GNUC__)
+#define THREAD_LOCAL    __thread __attribute__((tls_model("initial-exec")))
+#else
+#define THREAD_LOCAL    __thread
+#endif
+#endif
+
+#ifdef _MSC_VER
+#define CACHE_ALIGNED   _declspec(align(64))
+#elif defined(__GNUC__)
+#define CACHE_ALIGNED   __attribute__((aligned(64)))
+#else
+#define CACHE_ALIGNED
+#endif
+
+/*
+ * `imm` is whatever immediate the handler wants:  sign- or zero-extended
+ * 16-bit immediates, pre-shifted LUI values, jump targets, branch offsets
+ * (including the delay slot adjustment) or the 7-bit LWC2/SWC2 offsets.
+ *
+ * For vector operations, rs is the element selector, rd is vs and sa is vd.
+ * For MFC2, MTC2 and LWC2/SWC2, e is the 4-bit element.
+ */
+typedef struct {
+    u32 word; /* the original instruction word the slot was decoded from */
+    s32 imm;
+    u8 op; /* the handler to run, which might be a superinstruction */
+    u8 base_op; /* the handler for just this one word (never a fused one) */
+    u8 rs, rt, rd, sa;
+    u8 func, e;
+} decoded_inst;
+
+/*
+ * bits decoding adds to the `func` of a vector operation (vu/matrix.h)
+ */
+#define DEAD_SIDE_EFFECTS   64 /* nothing reads the accumulator or $vco set */
+#define DEAD_VD             128 /* nothing reads the multiply's vd */
+
+/*
+ * The first cache lines hold what nearly every instruction touches.  What is
+ * only used around task boundaries starts on a cache line of its own.
+ */
+typedef struct {
+/*
+ * general-purpose scalar registers
+ *
+ * based on the MIPS instruction set architecture but without most of the
+ * original register names (for example, no kernel-reserved registers)
+ */
+    CACHE_ALIGNED u32 SR[32]; /* NUMBER_OF_SCALAR_REGISTERS */
+    pu32 CR[16]; /* NUMBER_OF_CP0_REGISTERS, in the core's own registers */
+
+    pu8 DRAM;
+    pu8 DMEM;
+    pu8 IMEM;
+
+/*
+ * Currently, the plugin system this module is written for doesn't notify us
+ * of how much RDRAM is installed to the system, so InitiateRSP() has to find
+ * it out for itself.
+ */
+    unsigned long su_max_address;
+
+/*
+ * the highest DMEM address a 16-byte window can be read or written at
+ * straight through the DMEM pointer, without wrapping around by hand:
+ * 0xFF0 if DMEM is the core's memory, or 0xFFF if it is mirrored (mirror.h)
+ */
+    u32 DMEM_window_end;
+
+/*
+ * We are going to need this for vector operations doing scalar things.
+ * The divides and VSAW need bit-wise information from the instruction word.
+ */
+    u32 inst_word;
+    int temp_PC;
+
+/*
+ * VCF-0 is the carry-out flags register:  $vco.
+ * VCF-1 is the compare code flags register:  $vcc.
+ * VCF-2 is the compare extension flags register:  $vce.
+ * There is no fourth RSP flags register.
+ */
+    u16 VCO; /* high byte "NOTEQUAL", low byte "carry/borrow in/out" */
+    u16 VCC; /* high byte clip tests (VCL, VCH, VCR), low byte compare codes */
+    u8 VCE; /* vector compare extension register */
+
+/*
+ * the buffered numerator and result of the vector divides, and whether the
+ * last one was the high half of a double-precision divide (vu/divide.c)
+ */
+    s32 DivIn;
+    s32 DivOut;
+    int DPH;
+
+/*
+ * The RSP accumulator is a vector of 3 48-bit integers.  Nearly all of the
+ * vector operations access it, but it's for multiply-accumulate operations.
+ *
+ * Access dimensions would be VACC[8][3] but are inverted for SIMD benefits.
+ */
+#ifdef VU_WIDE_ACCUMULATOR
+    ALIGNED i16 VACC_L[N];
+    ALIGNED i32 VACC_W[N];
+#else
+    ALIGNED i16 VACC[3][N];
+#endif
+
+/*
+ * When compiling without SSE2, we need to use a pointer to a destination
+ * vector instead of an XMM register in the return slot of the function.
+ * The vector "result" register will be emulated to serve this pointer.
+ */
+    ALIGNED i16 V_result[N];
+
+/*
+ * the flags expanded to one Boolean per element, for the scalar versions of
+ * the select operations (vu/select.c)
+ */
+    ALIGNED i16 cf_ne[N]; /* $vco:  high "NOTEQUAL" */
+    ALIGNED i16 cf_co[N]; /* $vco:  low "carry/borrow in/out" */
+    ALIGNED i16 cf_clip[N]; /* $vcc:  high (clip tests:  VCL, VCH, VCR) */
+    ALIGNED i16 cf_comp[N]; /* $vcc:  low (VEQ, VNE, VLT, VGE, VCL, VCH, VCR) */
+    ALIGNED i16 cf_vce[N]; /* $vce:  vector compare extension register */
+
+/*
+ * RSP virtual registers (of vector unit)
+ * The most important are the 32 general-purpose vector registers.
+ * The correct way to accurately store these is using big-endian vectors.
+ *
+ * For ?WC2 we may need to do byte-precision access just as directly.
+ * This is amended by using the `VU_S` and `VU_B` macros defined in `rsp.h`.
+ */
+    ALIGNED i16 VR[32][N << VR_STATIC_WRAPAROUND];
+
+    decoded_inst decoded_IMEM[4096 / 4];
+
+    CACHE_ALIGNED RSP_INFO info;
+
+/*
+ * When using a graphics plugin from specs version 1.2, LLE is not supported.
+ * The behavior of requesting the GBI lists should be adjusted accordingly.
+ */
+    p_func GBI_phase;
+    pu8 SP_memory; /* DMEM and IMEM mirrored, if map_SP_memory() could */
+    int RDP_queued; /* flush_RDP_queue() has a list to hand over */
+
+/*
+ * The number of times to tolerate executing `MFC0    $at, $c4`.
+ * Replace $at with any register--the timeout limit is per each.
+ *
+ * Set to a higher value to avoid prematurely quitting the interpreter.
+ * Set to a lower value for speed...you could get away with 10 sometimes.
+ */
+    int MF_SP_STATUS_TIMEOUT;
+    short MFC0_count[32]; /* one C0 MF status read count for each GPR */
+
+    u8 conf[32];
+#ifdef RSP_REENTRANT
+    pu8 allocation; /* the context, before it was aligned to a cache line */
+#endif
+} rsp_context;
+
+#ifdef RSP_REENTRANT
+extern THREAD_LOCAL rsp_context * RSP_current;
+#define RSP_CONTEXT     (*RSP_current)
+#else
+extern rsp_context RSP_state;
+#define RSP_CONTEXT     RSP_state
+#endif
+
+/*
+ * The RSP_INFO from the core is one more part of the context.
+ */
+#undef RSP_INFO_NAME
+#define RSP_INFO_NAME   (RSP_CONTEXT.info)
+
+/*
+ * The core's own DMEM and IMEM, which GET_RSP_INFO() can no longer name once
+ * DMEM and IMEM are macros for the context's pointers to them.
+ */
+static INLINE pu8 core_DMEM(void)
+{
+    return GET_RSP_INFO(DMEM);
+}
+static INLINE pu8 core_IMEM(void)
+{
+    return GET_RSP_INFO(IMEM);
+}
+
+#define SR                      (RSP_CONTEXT.SR)
+#define CR                      (RSP_CONTEXT.CR)
+#define DRAM                    (RSP_CONTEXT.DRAM)
+#define DMEM                    (RSP_CONTEXT.DMEM)
+#define IMEM                    (RSP_CONTEXT.IMEM)
+#define su_max_address          (RSP_CONTEXT.su_max_address)
+#define DMEM_window_end         (RSP_CONTEXT.DMEM_window_end)
+#define inst_word               (RSP_CONTEXT.inst_word)
+#define temp_PC                 (RSP_CONTEXT.temp_PC)
+
+#define VCO                     (RSP_CONTEXT.VCO)
+#define VCC                     (RSP_CONTEXT.VCC)
+#define VCE                     (RSP_CONTEXT.VCE)
+#define DivIn                   (RSP_CONTEXT.DivIn)
+#define DivOut                  (RSP_CONTEXT.DivOut)
+#define DPH                     (RSP_CONTEXT.DPH)
+
+#ifdef VU_WIDE_ACCUMULATOR
+#define VACC_L                  (RSP_CONTEXT.VACC_L)
+#define VACC_W                  (RSP_CONTEXT.VACC_W)
+#else
+#define VACC                    (RSP_CONTEXT.VACC)
+#endif
+#define V_result                (RSP_CONTEXT.V_result)
+#define cf_ne                   (RSP_CONTEXT.cf_ne)
+#define cf_co                   (RSP_CONTEXT.cf_co)
+#define cf_clip                 (RSP_CONTEXT.cf_clip)
+#define cf_comp                 (RSP_CONTEXT.cf_comp)
+#define cf_vce                  (RSP_CONTEXT.cf_vce)
+#define VR                      (RSP_CONTEXT.VR)
+
+#define decoded_IMEM            (RSP_CONTEXT.decoded_IMEM)
+
+#define GBI_phase               (RSP_CONTEXT.GBI_phase)
+#define SP_memory               (RSP_CONTEXT.SP_memory)
+#define RDP_queued              (RSP_CONTEXT.RDP_queued)
+#define MF_SP_STATUS_TIMEOUT    (RSP_CONTEXT.MF_SP_STATUS_TIMEOUT)
+#define MFC0_count              (RSP_CONTEXT.MFC0_count)
+#define conf                    (RSP_CONTEXT.conf)
+
+#endif
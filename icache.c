@@ -0,0 +1,239 @@
+/******************************************************************************\
+* Project:  Content-Addressed Cache of Predecoded IMEM Images                  *
+* License:  CC0 Public Domain Dedication                                       *
+*                                                                              *
+* To the extent possible under law, the author(s) have dedicated all copyright *
+* and related and neighboring rights to this software to the public domain     *
+* worldwide. This software is distributed without any warranty.                *
+*                                                                              *
+* You should have received a copy of the CC0 Public Domain Dedication along    *
+* with this software.                                                          *
+* If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.             *
+\******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "icache.h"
+#include "jit.h"
+
+#ifdef RSP_REENTRANT
+int fetch_icache(void)
+{
+    return 0;
+}
+void store_icache(void)
+{
+    return;
+}
+NOINLINE void load_icache(const char * source)
+{
+    (void)source; /* unused */
+    return;
+}
+NOINLINE void save_icache(const char * target)
+{
+    (void)target; /* unused */
+    return;
+}
+#else
+typedef struct {
+    u32 hash;
+    u32 valid;
+    decoded_inst slots[4096 / 4];
+} icache_image;
+
+typedef struct {
+    char magic[8];
+    u32 version;
+    u32 slot_size;
+    u32 handlers;
+    u32 images;
+    u32 link_offset;
+    u32 reserved;
+} icache_header;
+
+#define ICACHE_MAGIC    "cxd4ICA"
+#define ICACHE_VERSION  7
+
+static icache_image icache[ICACHE_IMAGES];
+static u32 icache_stamps[ICACHE_IMAGES];
+static u32 icache_clock;
+
+static unsigned int icache_current = ICACHE_IMAGES;
+static u32 icache_missed_hash;
+
+/*
+ * an xxHash32-style hash of all 1024 words, in four independent lanes
+ */
+#define PRIME32_1   2654435761u
+#define PRIME32_2   2246822519u
+#define PRIME32_3   3266489917u
+#define PRIME32_4    668265263u
+
+static u32 rotl32(u32 x, unsigned int count)
+{
+    return (x << count) | (x >> (32 - count));
+}
+static u32 icache_hash(const u32 * words)
+{
+    u32 lanes[4];
+    u32 hash;
+    register unsigned int i;
+
+    lanes[0] = 0 + PRIME32_1 + PRIME32_2;
+    lanes[1] = 0 + PRIME32_2;
+    lanes[2] = 0;
+    lanes[3] = 0 - PRIME32_1;
+    for (i = 0; i < 4096 / 4; i += 4) {
+        lanes[0] = rotl32(lanes[0] + words[i + 0]*PRIME32_2, 13) * PRIME32_1;
+        lanes[1] = rotl32(lanes[1] + words[i + 1]*PRIME32_2, 13) * PRIME32_1;
+        lanes[2] = rotl32(lanes[2] + words[i + 2]*PRIME32_2, 13) * PRIME32_1;
+        lanes[3] = rotl32(lanes[3] + words[i + 3]*PRIME32_2, 13) * PRIME32_1;
+    }
+    hash = 4096
+      + rotl32(lanes[0],  1) + rotl32(lanes[1],  7)
+      + rotl32(lanes[2], 12) + rotl32(lanes[3], 18)
+    ;
+    hash ^= hash >> 15;
+    hash *= PRIME32_2;
+    hash ^= hash >> 13;
+    hash *= PRIME32_3;
+    hash ^= hash >> 16;
+    return (hash);
+}
+
+static void icache_select(unsigned int image)
+{
+    icache_current = image;
+    if (image < ICACHE_IMAGES)
+        icache_stamps[image] = ++icache_clock;
+#ifdef SU_X64_JIT
+    select_recompiled(image);
+#endif
+    return;
+}
+
+int fetch_icache(void)
+{
+    const u32 * words = (const u32 *)IMEM;
+    register unsigned int i, j;
+
+    icache_missed_hash = icache_hash(words);
+    for (i = 0; i < ICACHE_IMAGES; i++) {
+        if (!icache[i].valid || icache[i].hash != icache_missed_hash)
+            continue;
+        for (j = 0; j < 4096 / 4; j++)
+            if (icache[i].slots[j].word != words[j])
+                break;
+        if (j < 4096 / 4)
+            continue; /* a hash collision, however unlikely */
+        memcpy(decoded_IMEM, icache[i].slots, sizeof(decoded_IMEM));
+        icache_select(i);
+        return 1;
+    }
+    return 0;
+}
+
+void store_icache(void)
+{
+    unsigned int victim;
+    register unsigned int i;
+
+    victim = 0;
+    for (i = 0; i < ICACHE_IMAGES; i++) {
+        if (!icache[i].valid) {
+            victim = i;
+            break;
+        }
+        if (icache_stamps[i] < icache_stamps[victim])
+            victim = i;
+    }
+    icache[victim].hash = icache_missed_hash;
+    icache[victim].valid = 1;
+    memcpy(icache[victim].slots, decoded_IMEM, sizeof(decoded_IMEM));
+#ifdef SU_X64_JIT
+    flush_recompiled(victim); /* Its blocks were for the image it replaced. */
+#endif
+    icache_select(victim);
+    return;
+}
+
+static void icache_set_header(icache_header * header)
+{
+    memset(header, 0x00, sizeof(*header));
+    strcpy(header -> magic, ICACHE_MAGIC);
+    header -> version = ICACHE_VERSION;
+    header -> slot_size = sizeof(decoded_inst);
+    header -> handlers = NUMBER_OF_SU_HANDLERS;
+    header -> images = ICACHE_IMAGES;
+    header -> link_offset = LINK_OFF;
+    return;
+}
+
+/*
+ * Nothing from the file gets used unless the stored hash matches the
+ * instruction words, and decoding those words again gives back every field
+ * of every slot, so that no stale or corrupted slot can pick a handler or
+ * index a table with something the decoder would never have made.
+ */
+static int icache_image_sane(const icache_image * image)
+{
+    static u32 words[4096 / 4];
+    register unsigned int i;
+
+    for (i = 0; i < 4096 / 4; i++)
+        words[i] = image -> slots[i].word;
+    if (icache_hash(words) != image -> hash)
+        return 0;
+    return decodes_to(image -> slots);
+}
+
+NOINLINE void load_icache(const char * source)
+{
+    icache_header header, expected;
+    FILE * stream;
+    register unsigned int i;
+
+    stream = fopen(source, "rb");
+    if (stream == NULL)
+        return; /* Nothing was saved yet. */
+    icache_set_header(&expected);
+    if (fread(&header, sizeof(header), 1, stream) != 1
+     || memcmp(&header, &expected, sizeof(header)) != 0
+     || fread(icache, sizeof(icache), 1, stream) != 1)
+        memset(icache, 0x00, sizeof(icache));
+    fclose(stream);
+
+    for (i = 0; i < ICACHE_IMAGES; i++) {
+        icache[i].valid = (icache[i].valid && icache_image_sane(&icache[i]));
+        icache_stamps[i] = 0;
+    }
+    icache_clock = 0;
+
+/*
+ * Whatever is in decoded_IMEM[] now might no longer be one of the images.
+ */
+#ifdef SU_X64_JIT
+    for (i = 0; i <= ICACHE_IMAGES; i++)
+        flush_recompiled(i);
+#endif
+    icache_select(ICACHE_IMAGES);
+    return;
+}
+
+NOINLINE void save_icache(const char * target)
+{
+    icache_header header;
+    FILE * stream;
+
+    stream = fopen(target, "wb");
+    if (stream == NULL)
+        return;
+    icache_set_header(&header);
+    fwrite(&header, sizeof(header), 1, stream);
+    fwrite(icache, sizeof(icache), 1, stream);
+    fclose(stream);
+    return;
+}
+#endif
@@ -0,0 +1,50 @@
+/******************************************************************************\
+* Project:  Content-Addressed Cache of Predecoded IMEM Images                  *
+* License:  CC0 Public Domain Dedication                                       *
+*                                                                              *
+* To the extent possible under law, the author(s) have dedicated all copyright *
+* and related and neighboring rights to this software to the public domain     *
+* worldwide. This software is distributed without any warranty.                *
+*                                                                              *
+* You should have received a copy of the CC0 Public Domain Dedication along    *
+* with this software.                                                          *
+* If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.             *
+\******************************************************************************/
+
+#ifndef _ICACHE_H_
+#define _ICACHE_H_
+
+#include "su.h"
+
+/*
+ * Games keep reloading the same few microcodes (and overlays of them) into
+ * IMEM, so every distinct 4-KiB IMEM image that gets predecoded is kept,
+ * looked up again by a hash of its instruction words.
+ *
+ * ICACHE_IMAGES is also the index used for whatever is in decoded_IMEM[]
+ * when it is not (or not yet) one of the cached images.
+ *
+ * With RSP_REENTRANT (context.h), one cache for all of the threads would
+ * need locking, and one for each thread is too big for thread-local storage,
+ * so each thread just re-decodes whatever changed in its IMEM instead.
+ */
+#define ICACHE_IMAGES   32
+
+#define ICACHE_FILE     "rsp_icache.bin"
+
+/*
+ * If the current IMEM contents were cached before, copy their predecoded
+ * slots into decoded_IMEM[] and return nonzero.  Otherwise return zero, and
+ * store_icache() should be called once decoded_IMEM[] has been re-decoded.
+ */
+extern int fetch_icache(void);
+extern void store_icache(void);
+
+/*
+ * The cache file is the fixed-size array of cached images, as is, after a
+ * short header which rejects it if it came from an incompatible build.
+ */
+NOINLINE extern void load_icache(const char * source);
+NOINLINE extern void save_icache(const char * target);
+
+#endif
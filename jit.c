@@ -0,0 +1,1279 @@
+/******************************************************************************\
+* Project:  x86-64 Basic Block Recompiler for the Scalar Unit                  *
+* License:  CC0 Public Domain Dedication                                       *
+*                                                                              *
+* To the extent possible under law, the author(s) have dedicated all copyright *
+* and related and neighboring rights to this software to the public domain     *
+* worldwide. This software is distributed without any warranty.                *
+*                                                                              *
+* You should have received a copy of the CC0 Public Domain Dedication along    *
+* with this software.                                                          *
+* If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.             *
+\******************************************************************************/
+
+#include "jit.h"
+#include "vu/vu.h"
+
+#ifdef SU_X64_JIT
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifndef MAP_ANONYMOUS
+#include <fcntl.h>
+#endif
+
+/*
+ * Recompiled blocks work straight out of the same SR[], VR[] and other
+ * globals the interpreter uses, so control can pass back and forth between
+ * the two at any block boundary without having to write anything back.
+ *
+ * Inside a block, RBX always points to SR[] and EBP holds the outcome of the
+ * last branch test (or the JR/JALR target) across its delay slot.  Scalar
+ * ALU operations are translated directly; loads, stores, COP0, COP2 moves and
+ * LWC2/SWC2 call the same functions the interpreter calls.
+ *
+ * The common vector operations (jit_inline_vector()) are translated directly
+ * too, with the vector registers and the accumulator they use kept in XMM
+ * registers until the block exits or calls anything.  The rest shuffle their
+ * vt operand in XMM1 and then call the COP2_C2[] kernel, which takes vs and
+ * vt in XMM0 and XMM1 and returns the result in XMM0.
+ */
+static p_block jit_tables[ICACHE_IMAGES + 1][4096 / 4];
+static u8 jit_visits[ICACHE_IMAGES + 1][4096 / 4];
+static unsigned int jit_image = ICACHE_IMAGES;
+
+p_block * recompiled = jit_tables[ICACHE_IMAGES];
+
+#define JIT_CODE_SIZE       (1024 * 1024)
+#define JIT_CODE_MARGIN     (32 * 1024)
+
+/*
+ * An entry is recompiled the JIT_HOT_VISITS-th time recompile() is asked for
+ * it, since a lot of them (after an overlay, most of all) never run again.
+ * Past that, its visits say it has been tried.
+ */
+#define JIT_HOT_VISITS      16
+#define JIT_ATTEMPTED       (JIT_HOT_VISITS + 1)
+#define JIT_MAX_BLOCK_SIZE  48
+
+static u8 * jit_code;
+static size_t jit_used;
+static size_t jit_page_size;
+static int jit_unavailable;
+
+static u8 * jit_out;
+
+static void jit_emit8(unsigned int byte)
+{
+    *(jit_out++) = (u8)byte;
+}
+static void jit_emit32(u32 word)
+{
+    memcpy(jit_out, &word, sizeof(word));
+    jit_out += sizeof(word);
+}
+static void jit_emit64(u64 quad)
+{
+    memcpy(jit_out, &quad, sizeof(quad));
+    jit_out += sizeof(quad);
+}
+
+/* op eax, [rbx + 4*sr] */
+static void jit_op_eax_SR(unsigned int opcode, unsigned int sr)
+{
+    jit_emit8(opcode);
+    jit_emit8(0x43);
+    jit_emit8(4 * sr);
+}
+/* mov [rbx + 4*sr], eax */
+static void jit_store_eax(unsigned int sr)
+{
+    jit_op_eax_SR(0x89, sr);
+}
+/* mov eax, [rbx + 4*sr] */
+static void jit_load_eax(unsigned int sr)
+{
+    jit_op_eax_SR(0x8B, sr);
+}
+/* mov dword [rbx + 4*sr], imm32 */
+static void jit_store_imm(unsigned int sr, u32 imm)
+{
+    jit_emit8(0xC7);
+    jit_emit8(0x43);
+    jit_emit8(4 * sr);
+    jit_emit32(imm);
+}
+/*
+ * SSE2 instructions, as the second byte of their 66 0F opcodes
+ */
+enum {
+    PUNPCKLWD   = 0x61,
+    PACKSSWB    = 0x63,
+    PCMPGTW     = 0x65,
+    PUNPCKHWD   = 0x69,
+    PACKSSDW    = 0x6B,
+    PUNPCKLQDQ  = 0x6C,
+    PUNPCKHQDQ  = 0x6D,
+    MOVD        = 0x6E, /* movd xmm, r32 */
+    MOVDQA      = 0x6F,
+    PSHUF       = 0x70, /* pshuflw (F2) and pshufhw (F3) */
+    PSHIFTW     = 0x71, /* psrlw, psraw and psllw by an immediate */
+    PCMPEQW     = 0x75,
+    MOVDQA_STORE= 0x7F,
+    PMULLW      = 0xD5,
+    PMOVMSKB    = 0xD7,
+    PAND        = 0xDB,
+    PANDN       = 0xDF,
+    PMULHUW     = 0xE4,
+    PMULHW      = 0xE5,
+    PSUBSW      = 0xE9,
+    PMINSW      = 0xEA,
+    POR         = 0xEB,
+    PADDSW      = 0xED,
+    PMAXSW      = 0xEE,
+    PXOR        = 0xEF,
+    PSUBW       = 0xF9,
+    PADDW       = 0xFD
+};
+#define PSRLW       2
+#define PSRAW       4
+#define PSLLW       6
+
+/* op reg, rm (either one an XMM or a 32-bit register, per the opcode) */
+static void jit_sse(unsigned int prefix, unsigned int op,
+    unsigned int reg, unsigned int rm)
+{
+    jit_emit8(prefix);
+    if ((reg | rm) & 8)
+        jit_emit8(0x40 | (reg & 8) >> 1 | (rm & 8) >> 3);
+    jit_emit8(0x0F);
+    jit_emit8(op);
+    jit_emit8(0xC0 | (reg & 7) << 3 | (rm & 7));
+}
+static void jit_xmm(unsigned int op, unsigned int dst, unsigned int src)
+{
+    jit_sse(0x66, op, dst, src);
+}
+/* psrlw, psraw or psllw xmm, count */
+static void jit_shift(unsigned int shift, unsigned int xmm, unsigned int count)
+{
+    jit_sse(0x66, PSHIFTW, shift, xmm);
+    jit_emit8(count);
+}
+/* op xmm, [rbx + offset] */
+static void jit_xmm_SR(unsigned int op, unsigned int xmm, s32 offset)
+{
+    jit_emit8(0x66);
+    if (xmm & 8)
+        jit_emit8(0x44);
+    jit_emit8(0x0F);
+    jit_emit8(op);
+    jit_emit8(0x83 | (xmm & 7) << 3);
+    jit_emit32((u32)offset);
+}
+
+/*
+ * Everything the recompiled code reads or writes in the rsp_context is at a
+ * fixed distance from SR[] in RBX.
+ */
+#define JIT_CONTEXT(x)      ((s32)((const u8 *)&(x) - (const u8 *)&SR[0]))
+
+/*
+ * While a block is being recompiled, these say what the code emitted so far
+ * leaves in XMM6 to XMM12 (vector registers) and XMM13 to XMM15 (the parts
+ * of the accumulator, HI, MD and LO), and which of those are newer than the
+ * rsp_context.  XMM0 to XMM5 are scratch for each operation.
+ *
+ * With VU_WIDE_ACCUMULATOR, the middle and the high parts are not vectors of
+ * their own, so only VACC_L is kept and the multiplies are not inlined.
+ */
+#define JIT_XMM_VR_FIRST    6
+#define JIT_XMM_VR_LAST     12
+#define JIT_XMM_ACC(part)   (13 + (part))
+
+static int jit_xmm_VR[16]; /* the vector register held, or -1 */
+static u8 jit_xmm_dirty[16];
+static unsigned int jit_xmm_used[16];
+static unsigned int jit_xmm_clock;
+static unsigned int jit_acc_cached; /* (1 << HI) | (1 << MD) | (1 << LO) */
+static unsigned int jit_acc_dirty;
+
+#ifdef VU_WIDE_ACCUMULATOR
+#define JIT_ACC_OFFSET(part)    JIT_CONTEXT(VACC_L[0])
+#else
+#define JIT_ACC_OFFSET(part)    JIT_CONTEXT(VACC[part][0])
+#endif
+
+static void jit_VR_write_back(unsigned int xmm)
+{
+    if (jit_xmm_dirty[xmm])
+        jit_xmm_SR(MOVDQA_STORE, xmm, JIT_CONTEXT(VR[jit_xmm_VR[xmm]][0]));
+    jit_xmm_dirty[xmm] = 0;
+}
+
+/*
+ * the XMM register for VR[vr], loaded from the rsp_context if `load` says so
+ * and it is not there already, taking the least recently used one if needed
+ */
+static unsigned int jit_VR(unsigned int vr, int load)
+{
+    register unsigned int xmm, i;
+
+    for (xmm = JIT_XMM_VR_FIRST; xmm <= JIT_XMM_VR_LAST; xmm++)
+        if (jit_xmm_VR[xmm] == (int)vr)
+            break;
+    if (xmm > JIT_XMM_VR_LAST) {
+        xmm = JIT_XMM_VR_FIRST;
+        for (i = JIT_XMM_VR_FIRST; i <= JIT_XMM_VR_LAST; i++) {
+            if (jit_xmm_VR[i] < 0) {
+                xmm = i;
+                break;
+            }
+            if (jit_xmm_used[i] < jit_xmm_used[xmm])
+                xmm = i;
+        }
+        jit_VR_write_back(xmm);
+        jit_xmm_VR[xmm] = (int)vr;
+        if (load)
+            jit_xmm_SR(MOVDQA, xmm, JIT_CONTEXT(VR[vr][0]));
+    }
+    jit_xmm_used[xmm] = ++jit_xmm_clock;
+    return (xmm);
+}
+static unsigned int jit_VR_read(unsigned int vr)
+{
+    return jit_VR(vr, 1);
+}
+static void jit_VR_write(unsigned int vr, unsigned int src)
+{
+    const unsigned int xmm = jit_VR(vr, 0);
+
+    jit_xmm(MOVDQA, xmm, src);
+    jit_xmm_dirty[xmm] = 1;
+}
+
+#ifndef VU_WIDE_ACCUMULATOR
+static unsigned int jit_acc_read(unsigned int part)
+{
+    if ((jit_acc_cached & (1 << part)) == 0)
+        jit_xmm_SR(MOVDQA, JIT_XMM_ACC(part), JIT_ACC_OFFSET(part));
+    jit_acc_cached |= 1 << part;
+    return JIT_XMM_ACC(part);
+}
+#endif
+static void jit_acc_write(unsigned int part, unsigned int src)
+{
+    jit_xmm(MOVDQA, JIT_XMM_ACC(part), src);
+    jit_acc_cached |= 1 << part;
+    jit_acc_dirty |= 1 << part;
+}
+
+/*
+ * Store whatever the XMM registers have that the rsp_context does not, for
+ * an exit from the block.  The registers still hold the same values after.
+ */
+static void jit_write_back(void)
+{
+    register unsigned int i;
+
+    for (i = JIT_XMM_VR_FIRST; i <= JIT_XMM_VR_LAST; i++)
+        jit_VR_write_back(i);
+    for (i = 0; i < 3; i++)
+        if (jit_acc_dirty & (1 << i))
+            jit_xmm_SR(MOVDQA_STORE, JIT_XMM_ACC(i), JIT_ACC_OFFSET(i));
+    jit_acc_dirty = 0;
+    return;
+}
+
+/*
+ * ...and then forget them, before calling anything (which the System V ABI
+ * lets clobber every XMM register).
+ */
+static void jit_forget_registers(void)
+{
+    register unsigned int i;
+
+    for (i = 0; i < 16; i++) {
+        jit_xmm_VR[i] = -1;
+        jit_xmm_dirty[i] = 0;
+    }
+    jit_acc_cached = jit_acc_dirty = 0;
+    return;
+}
+static void jit_forget(void)
+{
+    jit_write_back();
+    jit_forget_registers();
+    return;
+}
+
+#define JIT_ADDRESS(x)      ((u64)(size_t)(x))
+
+/* mov rax, imm64 */
+static void jit_rax(u64 address)
+{
+    jit_emit8(0x48);
+    jit_emit8(0xB8);
+    jit_emit64(address);
+}
+/* mov edi/esi/edx/ecx, imm32 */
+static void jit_args(int count, u32 a, u32 b, u32 c, u32 d)
+{
+    if (count > 0) { jit_emit8(0xBF); jit_emit32(a); }
+    if (count > 1) { jit_emit8(0xBE); jit_emit32(b); }
+    if (count > 2) { jit_emit8(0xBA); jit_emit32(c); }
+    if (count > 3) { jit_emit8(0xB9); jit_emit32(d); }
+}
+/* call qword [rax], to always go through any function table's latest entry */
+static void jit_call_table(u64 entry)
+{
+    jit_forget();
+    jit_rax(entry);
+    jit_emit8(0xFF);
+    jit_emit8(0x10);
+}
+/* mov rax, imm64; call rax */
+static void jit_call(u64 function)
+{
+    jit_forget();
+    jit_rax(function);
+    jit_emit8(0xFF);
+    jit_emit8(0xD0);
+}
+
+/* Return from the block with the IMEM address to resume at in EAX. */
+static void jit_return(void)
+{
+    jit_write_back();
+    jit_emit8(0x48); jit_emit8(0x83); jit_emit8(0xC4); jit_emit8(0x08);
+    jit_emit8(0x5D); /* pop rbp */
+    jit_emit8(0x5B); /* pop rbx */
+    jit_emit8(0xC3); /* ret */
+}
+static void jit_epilogue(u32 PC)
+{
+    jit_emit8(0xB8);
+    jit_emit32(FIT_IMEM(PC)); /* mov eax, PC */
+    jit_return();
+}
+
+/*
+ * Move the SP status register's HALT bit into ZF, for branching out after
+ * anything besides BREAK which could have halted the RSP.
+ */
+static void jit_test_halt(void)
+{
+    jit_rax(JIT_ADDRESS(&CR[0x4]));
+    jit_emit8(0x48); jit_emit8(0x8B); jit_emit8(0x00); /* mov rax, [rax] */
+    jit_emit8(0xF7); jit_emit8(0x00); /* test dword [rax], SP_STATUS_HALT */
+    jit_emit32(SP_STATUS_HALT);
+}
+
+/*
+ * dst = VR[vt] as element specifier `e` selects its elements (vector_select())
+ */
+static void jit_select(unsigned int dst, unsigned int src, unsigned int e)
+{
+    if (e >= 0x8) { /* pshufl/hw dst, src, imm8; punpckl/hqdq dst, dst */
+        jit_sse((e & 4) ? 0xF3 : 0xF2, PSHUF, dst, src);
+        jit_emit8(0x55 * (e & 3));
+        jit_xmm((e & 4) ? PUNPCKHQDQ : PUNPCKLQDQ, dst, dst);
+    } else if (e >= 0x2) { /* pshuflw and pshufhw */
+        const unsigned int order = (e >= 0x4)
+          ? 0x55 * (e & 3)
+          : ((e & 1) ? 0xF5 : 0xA0)
+        ;
+
+        jit_sse(0xF2, PSHUF, dst, src);
+        jit_emit8(order);
+        jit_sse(0xF3, PSHUF, dst, dst);
+        jit_emit8(order);
+    } else if (dst != src) {
+        jit_xmm(MOVDQA, dst, src);
+    }
+    return;
+}
+
+/*
+ * flags_to_mask() of $vco, of its NOTEQUAL half, of the two halves ANDed, or
+ * of $vcc, into XMM register `xmm`
+ */
+enum {
+    JIT_VCO,
+    JIT_VCO_NE,
+    JIT_VCO_NE_CO,
+    JIT_VCC
+};
+
+static ALIGNED const i16 jit_flag_bits[N] = {
+    0x0001, 0x0002, 0x0004, 0x0008, 0x0010, 0x0020, 0x0040, 0x0080
+};
+
+static void jit_flags_mask(unsigned int xmm, int flags)
+{
+    jit_emit8(0x0F); /* movzx eax, word or byte [rbx + offset] */
+    jit_emit8((flags == JIT_VCO_NE) ? 0xB6 : 0xB7);
+    jit_emit8(0x83);
+    switch (flags) {
+    case JIT_VCO_NE:
+        jit_emit32((u32)JIT_CONTEXT(VCO) + 1); /* the high byte */
+        break;
+    case JIT_VCC:
+        jit_emit32((u32)JIT_CONTEXT(VCC));
+        break;
+    default:
+        jit_emit32((u32)JIT_CONTEXT(VCO));
+    }
+    if (flags == JIT_VCO_NE_CO) {
+        jit_emit8(0x20); jit_emit8(0xE0); /* and al, ah */
+    }
+
+    jit_xmm(MOVD, xmm, 0);
+    jit_sse(0xF2, PSHUF, xmm, xmm); /* pshuflw xmm, xmm, 0 */
+    jit_emit8(0x00);
+    jit_xmm(PUNPCKLQDQ, xmm, xmm);
+    jit_rax(JIT_ADDRESS(&jit_flag_bits[0]));
+    jit_emit8(0x66); jit_emit8(0x0F); jit_emit8(PAND);
+    jit_emit8(xmm << 3); /* pand xmm, [rax] */
+    jit_emit8(0x66); jit_emit8(0x0F); jit_emit8(PCMPEQW);
+    jit_emit8(xmm << 3); /* pcmpeqw xmm, [rax] */
+    return;
+}
+
+/* mov word [rbx + offset], mask_to_flags(xmm), losing XMM register `xmm` */
+static void jit_store_flags(s32 offset, unsigned int xmm)
+{
+    jit_xmm(PACKSSWB, xmm, xmm);
+    jit_xmm(PMOVMSKB, 0, xmm);
+    jit_emit8(0x0F); jit_emit8(0xB6); jit_emit8(0xC0); /* movzx eax, al */
+    jit_emit8(0x66); jit_emit8(0x89); jit_emit8(0x83); /* mov [rbx + ...], ax */
+    jit_emit32((u32)offset);
+    return;
+}
+/* mov word [rbx + offset], 0 */
+static void jit_clear_flags(s32 offset)
+{
+    jit_emit8(0x66); jit_emit8(0xC7); jit_emit8(0x83);
+    jit_emit32((u32)offset);
+    jit_emit8(0x00); jit_emit8(0x00);
+    return;
+}
+
+/* dst = all 1s, and then 0x8000 in each element (_mm_setmin_epi16()) */
+static void jit_all_ones(unsigned int dst)
+{
+    jit_xmm(PCMPEQW, dst, dst);
+}
+static void jit_setmin(unsigned int dst)
+{
+    jit_all_ones(dst);
+    jit_shift(PSLLW, dst, 15);
+}
+/* dst = (a < b) unsigned, as _mm_cmplt_epu16(a, b), using `temp` */
+static void jit_cmplt_epu16(unsigned int dst, unsigned int a, unsigned int b,
+    unsigned int temp)
+{
+    jit_setmin(temp);
+    jit_xmm(MOVDQA, dst, b);
+    jit_xmm(PXOR, dst, temp);
+    jit_xmm(PXOR, temp, a);
+    jit_xmm(PCMPGTW, dst, temp);
+    return;
+}
+/* XMM0 = merge(mask, XMM0, XMM1), using `temp` */
+static void jit_merge(unsigned int mask, unsigned int temp)
+{
+    jit_xmm(PAND, 0, mask);
+    jit_xmm(MOVDQA, temp, mask);
+    jit_xmm(PANDN, temp, 1);
+    jit_xmm(POR, 0, temp);
+    return;
+}
+
+#ifndef VU_WIDE_ACCUMULATOR
+/*
+ * XMM0 = accumulator bits 47..16 (md and hi) clamped to 16 bits, as VM?DM
+ * and VM?DH do, using `temp`.  md may be XMM0.
+ */
+static void jit_clamp_acc_md(unsigned int md, unsigned int hi,
+    unsigned int temp)
+{
+    jit_xmm(MOVDQA, temp, md);
+    jit_xmm(PUNPCKHWD, temp, hi);
+    if (md != 0)
+        jit_xmm(MOVDQA, 0, md);
+    jit_xmm(PUNPCKLWD, 0, hi);
+    jit_xmm(PACKSSDW, 0, temp);
+    return;
+}
+/*
+ * XMM0 = the VM?DL and VM?DN clamp of the accumulator (see do_madl()), using
+ * `temp` and losing lo and md
+ */
+static void jit_clamp_acc_lo(unsigned int lo, unsigned int md,
+    unsigned int hi, unsigned int temp)
+{
+    jit_clamp_acc_md(md, hi, temp);
+    jit_xmm(PCMPEQW, md, 0); /* (unclamped == clamped) ... */
+    jit_xmm(PAND, lo, md); /* ... ? low : mid */
+    jit_all_ones(temp);
+    jit_xmm(PXOR, md, temp);
+    jit_xmm(PAND, 0, md);
+    jit_xmm(POR, 0, lo);
+    jit_shift(PSLLW, md, 15);
+    jit_xmm(PXOR, 0, md);
+    return;
+}
+
+/*
+ * With vs in XMM0 and vt in XMM1, leave the product of VM?DM or VM?DN in
+ * XMM2 (bits 15..0) and XMM3 (bits 31..16).  It is signed vs times unsigned
+ * vt for VM?DM, or the other way around for VM?DN.
+ */
+static void jit_mixed_product(int signed_vs)
+{
+    const unsigned int s = signed_vs ? 0 : 1;
+
+    jit_xmm(MOVDQA, 2, 0);
+    jit_xmm(PMULLW, 2, 1);
+    jit_xmm(MOVDQA, 3, 0);
+    jit_xmm(PMULHUW, 3, 1);
+    jit_shift(PSRAW, s, 15);
+    jit_xmm(PAND, s ^ 1, s); /* (u16)x * (u16)y - y, for each x < 0 */
+    jit_xmm(PSUBW, 3, s ^ 1);
+    return;
+}
+
+/*
+ * Accumulate the product in XMM2 and XMM3 (jit_mixed_product()), leaving the
+ * new accumulator in XMM4 (lo), XMM2 (md) and XMM1 (hi).
+ */
+static void jit_accumulate_product(void)
+{
+    jit_xmm(MOVDQA, 4, jit_acc_read(LO));
+    jit_xmm(PADDW, 4, 2);
+    jit_cmplt_epu16(0, 4, 2, 5); /* overflow:  (x + y < y) */
+    jit_xmm(PSUBW, 3, 0);
+    jit_xmm(MOVDQA, 2, jit_acc_read(MD));
+    jit_xmm(PADDW, 2, 3);
+    jit_cmplt_epu16(0, 2, 3, 5);
+    jit_shift(PSRAW, 3, 15);
+    jit_xmm(MOVDQA, 1, jit_acc_read(HI));
+    jit_xmm(PADDW, 1, 3);
+    jit_xmm(PSUBW, 1, 0);
+    return;
+}
+
+/*
+ * VMUDL, VMUDM, VMUDN and VMUDH, then VMADL, VMADM, VMADN and VMADH, the
+ * same as do_mudl() and the others do them in vu/multiply.c
+ */
+static void jit_multiply(unsigned int func, int vd_live, int acc_live)
+{
+    switch (func) {
+    case 004: /* VMUDL */
+        jit_xmm(PMULHUW, 0, 1);
+        if (acc_live) {
+            jit_xmm(PXOR, 1, 1);
+            jit_acc_write(LO, 0);
+            jit_acc_write(MD, 1);
+            jit_acc_write(HI, 1);
+        }
+        return;
+    case 005: /* VMUDM */
+    case 006: /* VMUDN */
+        jit_mixed_product(func == 005);
+        if (acc_live) {
+            jit_acc_write(LO, 2);
+            jit_acc_write(MD, 3);
+            jit_acc_write(HI, 3);
+            jit_shift(PSRAW, JIT_XMM_ACC(HI), 15);
+        }
+        jit_xmm(MOVDQA, 0, (func == 005) ? 3 : 2);
+        return;
+    case 007: /* VMUDH */
+        jit_xmm(MOVDQA, 3, 0);
+        jit_xmm(PMULHW, 3, 1);
+        jit_xmm(PMULLW, 0, 1);
+        if (acc_live) {
+            jit_xmm(PXOR, 1, 1);
+            jit_acc_write(LO, 1);
+            jit_acc_write(MD, 0);
+            jit_acc_write(HI, 3);
+        }
+        if (vd_live)
+            jit_clamp_acc_md(0, 3, 1);
+        return;
+
+    case 014: /* VMADL */
+        jit_xmm(PMULHUW, 0, 1);
+        jit_xmm(MOVDQA, 2, jit_acc_read(LO));
+        jit_xmm(PADDW, 2, 0);
+        jit_cmplt_epu16(1, 2, 0, 5); /* overflow:  (x + y < y) */
+        jit_xmm(MOVDQA, 3, jit_acc_read(MD));
+        jit_xmm(PSUBW, 3, 1);
+        jit_xmm(PXOR, 5, 5);
+        jit_xmm(PCMPEQW, 5, 3);
+        jit_xmm(PAND, 1, 5);
+        jit_xmm(MOVDQA, 4, jit_acc_read(HI));
+        jit_xmm(PSUBW, 4, 1);
+        if (acc_live) {
+            jit_acc_write(LO, 2);
+            jit_acc_write(MD, 3);
+            jit_acc_write(HI, 4);
+        }
+        if (vd_live)
+            jit_clamp_acc_lo(2, 3, 4, 1);
+        return;
+    case 015: /* VMADM */
+    case 016: /* VMADN */
+        jit_mixed_product(func == 015);
+        jit_accumulate_product();
+        if (acc_live) {
+            jit_acc_write(LO, 4);
+            jit_acc_write(MD, 2);
+            jit_acc_write(HI, 1);
+        }
+        if (vd_live) {
+            if (func == 015)
+                jit_clamp_acc_md(2, 1, 3);
+            else
+                jit_clamp_acc_lo(4, 2, 1, 3);
+        }
+        return;
+    case 017: /* VMADH */
+        jit_xmm(MOVDQA, 3, 0);
+        jit_xmm(PMULHW, 3, 1);
+        jit_xmm(PMULLW, 0, 1);
+        jit_xmm(MOVDQA, 2, jit_acc_read(MD));
+        jit_xmm(PADDW, 0, 2);
+        jit_xmm(MOVDQA, 1, jit_acc_read(HI));
+        jit_xmm(PADDW, 1, 3);
+        jit_cmplt_epu16(4, 0, 2, 5); /* acc.mid + prod.low < acc.mid */
+        jit_xmm(PSUBW, 1, 4);
+        if (acc_live) {
+            jit_acc_write(MD, 0);
+            jit_acc_write(HI, 1);
+        }
+        if (vd_live)
+            jit_clamp_acc_md(0, 1, 3);
+        return;
+    }
+    return;
+}
+#endif
+
+/*
+ * Translate the vector operations worth inlining, with vs and vt in XMM0 and
+ * XMM1 and the result in XMM0, or return zero to call the COP2_C2[] kernel.
+ */
+static int jit_inline_vector(const decoded_inst * inst)
+{
+    const unsigned int func = inst -> func % 64;
+#ifndef VU_WIDE_ACCUMULATOR
+    const int vd_live = (inst -> func & DEAD_VD) == 0;
+#endif
+    const int side_effects = (inst -> func & DEAD_SIDE_EFFECTS) == 0;
+    unsigned int result;
+
+    switch (func) {
+#ifndef VU_WIDE_ACCUMULATOR
+    case 004: case 005: case 006: case 007: /* VMUDL, VMUDM, VMUDN, VMUDH */
+    case 014: case 015: case 016: case 017: /* VMADL, VMADM, VMADN, VMADH */
+        if (!vd_live && !side_effects)
+            return 1; /* VNOP */
+#endif
+    case 020: case 021: case 024: case 025: /* VADD, VSUB, VADDC, VSUBC */
+    case 040: case 041: case 042: case 043: /* VLT, VEQ, VNE, VGE */
+    case 047: /* VMRG */
+    case 050: case 051: case 052: case 053: /* VAND, VNAND, VOR, VNOR */
+    case 054: case 055: /* VXOR, VNXOR */
+        break;
+    default:
+        return 0;
+    }
+
+    jit_xmm(MOVDQA, 0, jit_VR_read(inst -> rd));
+    jit_select(1, jit_VR_read(inst -> rt), inst -> rs & 0xF);
+    result = 0;
+    switch (func) {
+#ifndef VU_WIDE_ACCUMULATOR
+    default:
+        jit_multiply(func, vd_live, side_effects);
+        if (vd_live)
+            jit_VR_write(inst -> sa, 0);
+        return 1;
+#endif
+
+    case 020: /* VADD */
+        jit_flags_mask(2, JIT_VCO);
+        jit_shift(PSRLW, 2, 15);
+        jit_xmm(MOVDQA, 3, 0);
+        jit_xmm(PADDW, 3, 1);
+        jit_xmm(PADDW, 3, 2);
+        jit_acc_write(LO, 3);
+        jit_xmm(MOVDQA, 3, 0);
+        jit_xmm(PMINSW, 3, 1);
+        jit_xmm(PMAXSW, 0, 1);
+        jit_xmm(PADDSW, 3, 2); /* the lesser one with the carry first */
+        jit_xmm(PADDSW, 0, 3);
+        if (side_effects)
+            jit_clear_flags(JIT_CONTEXT(VCO));
+        break;
+    case 021: /* VSUB */
+        jit_flags_mask(2, JIT_VCO);
+        jit_shift(PSRLW, 2, 15);
+        jit_xmm(MOVDQA, 3, 0);
+        jit_xmm(PSUBW, 3, 1);
+        jit_xmm(PSUBW, 3, 2);
+        jit_acc_write(LO, 3);
+        jit_xmm(MOVDQA, 3, 0);
+        jit_xmm(PSUBSW, 3, 1);
+        jit_xmm(MOVDQA, 4, 3); /* SIGNED_CLAMP_SUB() */
+        jit_xmm(PADDW, 4, 2);
+        jit_xmm(PXOR, 4, 3);
+        jit_xmm(PAND, 4, 1);
+        jit_xmm(MOVDQA, 5, 0);
+        jit_xmm(PSUBW, 5, 1);
+        jit_xmm(PANDN, 0, 4);
+        jit_xmm(PAND, 5, 0);
+        jit_shift(PSRLW, 5, 15);
+        jit_xmm(PANDN, 5, 2);
+        jit_xmm(PSUBSW, 3, 5);
+        result = 3;
+        if (side_effects)
+            jit_clear_flags(JIT_CONTEXT(VCO));
+        break;
+    case 024: /* VADDC */
+        jit_xmm(MOVDQA, 2, 0);
+        jit_xmm(PADDW, 2, 1);
+        if (side_effects) {
+            jit_cmplt_epu16(3, 2, 0, 4); /* the carry out */
+            jit_store_flags(JIT_CONTEXT(VCO), 3);
+        }
+        result = 2;
+        break;
+    case 025: /* VSUBC */
+        jit_xmm(MOVDQA, 2, 0);
+        jit_xmm(PSUBW, 2, 1);
+        if (side_effects) {
+            jit_cmplt_epu16(3, 0, 1, 4); /* the borrow out */
+            jit_xmm(MOVDQA, 4, 0);
+            jit_xmm(PCMPEQW, 4, 1);
+            jit_xmm(PACKSSWB, 3, 4);
+            jit_xmm(PMOVMSKB, 0, 3);
+            jit_emit8(0x35); jit_emit32(0xFF00); /* xor eax, 0xFF00 */
+            jit_emit8(0x66); jit_emit8(0x89); jit_emit8(0x83);
+            jit_emit32((u32)JIT_CONTEXT(VCO)); /* mov [rbx + ...], ax */
+        }
+        result = 2;
+        break;
+
+    case 040: /* VLT */
+    case 043: /* VGE */
+        jit_flags_mask(4, JIT_VCO_NE_CO);
+        jit_xmm(MOVDQA, 3, 0);
+        jit_xmm(PCMPEQW, 3, 1);
+        if (func == 040) {
+            jit_xmm(PAND, 4, 3);
+            jit_xmm(MOVDQA, 2, 1);
+            jit_xmm(PCMPGTW, 2, 0);
+        } else {
+            jit_xmm(PANDN, 4, 3);
+            jit_xmm(MOVDQA, 2, 0);
+            jit_xmm(PCMPGTW, 2, 1);
+        }
+        jit_xmm(POR, 2, 4);
+        jit_merge(2, 3);
+        jit_store_flags(JIT_CONTEXT(VCC), 2);
+        jit_clear_flags(JIT_CONTEXT(VCO));
+        break;
+    case 041: /* VEQ */
+        jit_flags_mask(4, JIT_VCO_NE);
+        jit_xmm(MOVDQA, 3, 0);
+        jit_xmm(PCMPEQW, 3, 1);
+        jit_xmm(PANDN, 4, 3);
+        jit_store_flags(JIT_CONTEXT(VCC), 4);
+        jit_clear_flags(JIT_CONTEXT(VCO));
+        result = 1;
+        break;
+    case 042: /* VNE */
+        jit_flags_mask(4, JIT_VCO_NE);
+        jit_xmm(MOVDQA, 3, 0);
+        jit_xmm(PCMPEQW, 3, 1);
+        jit_all_ones(2);
+        jit_xmm(PXOR, 3, 2);
+        jit_xmm(POR, 3, 4);
+        jit_store_flags(JIT_CONTEXT(VCC), 3);
+        jit_clear_flags(JIT_CONTEXT(VCO));
+        break;
+    case 047: /* VMRG */
+        jit_flags_mask(2, JIT_VCC);
+        jit_merge(2, 3);
+        break;
+
+    case 050: /* VAND */
+    case 051: /* VNAND */
+        jit_xmm(PAND, 0, 1);
+        break;
+    case 052: /* VOR */
+    case 053: /* VNOR */
+        jit_xmm(POR, 0, 1);
+        break;
+    case 054: /* VXOR */
+    case 055: /* VNXOR */
+        jit_xmm(PXOR, 0, 1);
+        break;
+    }
+    if (func >= 050 && (func & 1)) {
+        jit_all_ones(2);
+        jit_xmm(PXOR, 0, 2);
+    }
+    if (func != 020 && func != 021) /* VADD and VSUB keep the unclamped sum. */
+        jit_acc_write(LO, result);
+    jit_VR_write(inst -> sa, result);
+    return 1;
+}
+
+static void jit_vector(const decoded_inst * inst)
+{
+    if (jit_inline_vector(inst))
+        return;
+    jit_forget();
+
+    jit_rax(JIT_ADDRESS(&inst_word));
+    jit_emit8(0xC7); jit_emit8(0x00); jit_emit32(inst -> word);
+
+    jit_xmm_SR(MOVDQA, 0, JIT_CONTEXT(VR[inst -> rd][0]));
+    jit_xmm_SR(MOVDQA, 1, JIT_CONTEXT(VR[inst -> rt][0]));
+    jit_select(1, 1, inst -> rs & 0xF);
+    jit_call_table(JIT_ADDRESS(&COP2_C2[inst -> func]));
+    jit_xmm_SR(MOVDQA_STORE, 0, JIT_CONTEXT(VR[inst -> sa][0]));
+}
+
+/*
+ * Translate one instruction that does not change the flow of control, or
+ * return zero if the interpreter should be left to execute it instead.
+ */
+static int jit_simple(const decoded_inst * inst)
+{
+    const unsigned int op = inst -> base_op;
+    const unsigned int rs = inst -> rs;
+    const unsigned int rt = inst -> rt;
+    const unsigned int rd = inst -> rd;
+
+    switch (op) {
+    case SU_SLL:
+    case SU_SRL:
+    case SU_SRA:
+        if (rd == zero)
+            return 1;
+        jit_load_eax(rt);
+        jit_emit8(0xC1);
+        jit_emit8(0xE0 | (op == SU_SRL ? 0x08 : 0x00)
+                       | (op == SU_SRA ? 0x18 : 0x00));
+        jit_emit8(inst -> sa & 31);
+        jit_store_eax(rd);
+        return 1;
+    case SU_SLLV:
+    case SU_SRLV:
+    case SU_SRAV:
+        if (rd == zero)
+            return 1;
+        jit_load_eax(rt);
+        jit_emit8(0x8B); jit_emit8(0x4B); jit_emit8(4 * rs); /* mov ecx */
+        jit_emit8(0xD3);
+        jit_emit8(0xE0 | (op == SU_SRLV ? 0x08 : 0x00)
+                       | (op == SU_SRAV ? 0x18 : 0x00));
+        jit_store_eax(rd);
+        return 1;
+    case SU_ADDU:
+    case SU_SUBU:
+    case SU_AND:
+    case SU_OR:
+    case SU_XOR:
+    case SU_NOR:
+        if (rd == zero)
+            return 1;
+        jit_load_eax(rs);
+        switch (op) {
+        case SU_ADDU:  jit_op_eax_SR(0x03, rt);  break;
+        case SU_SUBU:  jit_op_eax_SR(0x2B, rt);  break;
+        case SU_AND:   jit_op_eax_SR(0x23, rt);  break;
+        case SU_XOR:   jit_op_eax_SR(0x33, rt);  break;
+        default:
+            jit_op_eax_SR(0x0B, rt);
+            if (op == SU_NOR) {
+                jit_emit8(0xF7); jit_emit8(0xD0); /* not eax */
+            }
+        }
+        jit_store_eax(rd);
+        return 1;
+    case SU_SLT:
+    case SU_SLTU:
+        if (rd == zero)
+            return 1;
+        jit_load_eax(rs);
+        jit_op_eax_SR(0x3B, rt); /* cmp eax, [rbx + 4*rt] */
+        jit_emit8(0x0F); jit_emit8(op == SU_SLT ? 0x9C : 0x92);
+        jit_emit8(0xC0); /* setl or setb al */
+        jit_emit8(0x0F); jit_emit8(0xB6); jit_emit8(0xC0); /* movzx eax, al */
+        jit_store_eax(rd);
+        return 1;
+
+    case SU_ADDIU:
+    case SU_ANDI:
+    case SU_ORI:
+    case SU_XORI:
+    case SU_SLTI:
+    case SU_SLTIU:
+        if (rt == zero)
+            return 1;
+        jit_load_eax(rs);
+        switch (op) {
+        case SU_ADDIU:  jit_emit8(0x05);  break;
+        case SU_ANDI:   jit_emit8(0x25);  break;
+        case SU_ORI:    jit_emit8(0x0D);  break;
+        case SU_XORI:   jit_emit8(0x35);  break;
+        default:        jit_emit8(0x3D); /* cmp eax, imm32 */
+        }
+        jit_emit32(inst -> imm);
+        if (op == SU_SLTI || op == SU_SLTIU) {
+            jit_emit8(0x0F); jit_emit8(op == SU_SLTI ? 0x9C : 0x92);
+            jit_emit8(0xC0);
+            jit_emit8(0x0F); jit_emit8(0xB6); jit_emit8(0xC0);
+        }
+        jit_store_eax(rt);
+        return 1;
+    case SU_LUI:
+        if (rt != zero)
+            jit_store_imm(rt, inst -> imm);
+        return 1;
+
+    case SU_LB:
+    case SU_LH:
+    case SU_LW:
+    case SU_LBU:
+    case SU_LHU:
+    case SU_SB:
+    case SU_SH:
+    case SU_SW:
+        jit_args(3, rt, rs, inst -> imm, 0);
+        jit_call(JIT_ADDRESS(scalar_memory_ops[op - SU_LB]));
+        return 1;
+    case SU_LWC2:
+        jit_args(4, rt, inst -> e, inst -> imm, rs);
+        jit_call_table(JIT_ADDRESS(&LWC2[rd]));
+        return 1;
+    case SU_SWC2:
+        jit_args(4, rt, inst -> e, inst -> imm, rs);
+        jit_call_table(JIT_ADDRESS(&SWC2[rd]));
+        return 1;
+
+    case SU_MFC2:
+        jit_args(3, rt, rd, inst -> e, 0);
+        jit_call(JIT_ADDRESS(MFC2));
+        return 1;
+    case SU_MTC2:
+        jit_args(3, rt, rd, inst -> e, 0);
+        jit_call(JIT_ADDRESS(MTC2));
+        return 1;
+    case SU_CFC2:
+        jit_args(2, rt, rd, 0, 0);
+        jit_call(JIT_ADDRESS(CFC2));
+        return 1;
+    case SU_CTC2:
+        jit_args(2, rt, rd, 0, 0);
+        jit_call(JIT_ADDRESS(CTC2));
+        return 1;
+    case SU_VECTOR:
+        if (rs < 0x10) /* reserved element encodings */
+            return 0;
+        jit_vector(inst);
+        return 1;
+    case SU_RESERVED:
+        jit_call(JIT_ADDRESS(res_S));
+        return 1;
+    }
+    return 0;
+}
+
+static int jit_branches(unsigned int op)
+{
+    switch (op) {
+    case SU_JR:
+    case SU_JALR:
+    case SU_BLTZ:
+    case SU_BGEZ:
+    case SU_BLTZAL:
+    case SU_BGEZAL:
+    case SU_J:
+    case SU_JAL:
+    case SU_BEQ:
+    case SU_BNE:
+    case SU_BLEZ:
+    case SU_BGTZ:
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Translate a branch or jump at IMEM address PC along with its delay slot,
+ * finishing the block.  Returns zero if the delay slot would have to leave
+ * the block early, in which case the interpreter should do this branch.
+ */
+static int jit_branch(const decoded_inst * inst, u32 PC)
+{
+    const decoded_inst * slot = &decoded_IMEM[FIT_IMEM(PC + 4) / 4];
+    const u32 link = FIT_IMEM(PC + 8);
+    const u32 target = FIT_IMEM(PC + 4 + inst -> imm);
+    unsigned int setcc;
+
+    if (jit_branches(slot -> base_op))
+        return 0;
+    if (slot -> base_op == SU_MFC0 || slot -> base_op == SU_MTC0)
+        return 0;
+    if (slot -> base_op == SU_BREAK)
+        return 0;
+    if (slot -> base_op == SU_VECTOR && slot -> rs < 0x10)
+        return 0;
+
+    switch (inst -> base_op) {
+    case SU_JAL:
+    case SU_BLTZAL:
+    case SU_BGEZAL:
+        jit_store_imm(ra, link);
+        break;
+    case SU_JALR:
+        if (inst -> rd != zero)
+            jit_store_imm(inst -> rd, link);
+        break;
+    }
+
+    setcc = 0x00;
+    switch (inst -> base_op) {
+    case SU_JR:
+    case SU_JALR: /* mov ebp, [rbx + 4*rs]; and ebp, 0xFFC */
+        jit_emit8(0x8B); jit_emit8(0x6B); jit_emit8(4 * inst -> rs);
+        jit_emit8(0x81); jit_emit8(0xE5); jit_emit32(0xFFC);
+        break;
+    case SU_BEQ:
+    case SU_BNE:
+        jit_load_eax(inst -> rs);
+        jit_op_eax_SR(0x3B, inst -> rt);
+        setcc = (inst -> base_op == SU_BEQ) ? 0x94 : 0x95;
+        break;
+    case SU_BLEZ:
+    case SU_BGTZ:
+    case SU_BLTZ:
+    case SU_BGEZ:
+    case SU_BLTZAL:
+    case SU_BGEZAL: /* cmp dword [rbx + 4*rs], 0 */
+        jit_emit8(0x83); jit_emit8(0x7B); jit_emit8(4 * inst -> rs);
+        jit_emit8(0x00);
+        switch (inst -> base_op) {
+        case SU_BLEZ:  setcc = 0x9E;  break;
+        case SU_BGTZ:  setcc = 0x9F;  break;
+        case SU_BLTZ:
+        case SU_BLTZAL:  setcc = 0x9C;  break;
+        default:         setcc = 0x9D;
+        }
+        break;
+    }
+    if (setcc != 0x00) { /* setcc al; movzx ebp, al */
+        jit_emit8(0x0F); jit_emit8(setcc); jit_emit8(0xC0);
+        jit_emit8(0x0F); jit_emit8(0xB6); jit_emit8(0xE8);
+    }
+
+    jit_simple(slot);
+
+    switch (inst -> base_op) {
+    case SU_J:
+    case SU_JAL:
+        jit_epilogue(inst -> imm);
+        return 1;
+    case SU_JR:
+    case SU_JALR:
+        jit_emit8(0x89); jit_emit8(0xE8); /* mov eax, ebp */
+        jit_return();
+        return 1;
+    }
+    jit_emit8(0xB9); jit_emit32(target); /* mov ecx, target */
+    jit_emit8(0xB8); jit_emit32(link); /* mov eax, PC + 8 */
+    jit_emit8(0x85); jit_emit8(0xED); /* test ebp, ebp */
+    jit_emit8(0x0F); jit_emit8(0x45); jit_emit8(0xC1); /* cmovnz eax, ecx */
+    jit_return();
+    return 1;
+}
+
+void select_recompiled(unsigned int image)
+{
+    jit_image = image;
+    recompiled = jit_tables[image];
+    return;
+}
+void flush_recompiled(unsigned int image)
+{
+    memset(jit_tables[image], 0, sizeof(jit_tables[image]));
+    memset(jit_visits[image], 0, sizeof(jit_visits[image]));
+    return;
+}
+
+/*
+ * MAP_ANONYMOUS is hidden by _POSIX_SOURCE when everything is built as one
+ * unit through lto.c, so mapping /dev/zero is the fall-back for that.
+ *
+ * The buffer is never writable and executable at once:  it is mapped for
+ * writing, and recompile() switches just the pages the next block could
+ * take (JIT_CODE_MARGIN) to writing and back to executing around each one.
+ */
+static int jit_allocate(void)
+{
+    void * buffer;
+    long page_size;
+#ifndef MAP_ANONYMOUS
+    int fd;
+#endif
+
+    if (jit_unavailable)
+        return 0;
+    page_size = sysconf(_SC_PAGESIZE);
+    if (page_size <= 0 || JIT_CODE_SIZE % page_size != 0) {
+        jit_unavailable = 1;
+        return 0;
+    }
+    jit_page_size = (size_t)page_size;
+#ifdef MAP_ANONYMOUS
+    buffer = mmap(
+        NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+    );
+#else
+    fd = open("/dev/zero", O_RDWR);
+    buffer = (fd < 0) ? MAP_FAILED : mmap(
+        NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE, fd, 0
+    );
+    if (fd >= 0)
+        close(fd);
+#endif
+    if (buffer == MAP_FAILED) {
+        jit_unavailable = 1; /* Just keep interpreting everything. */
+        return 0;
+    }
+    jit_code = (u8 *)buffer;
+    return 1;
+}
+
+/*
+ * mprotect() the pages from where the next block starts, at jit_used, to as
+ * far as it could go.  This has to be done the same way both times, before
+ * the block moves jit_used on.
+ */
+static int jit_protect(int protection)
+{
+    size_t first, last;
+
+    first = jit_used & ~(jit_page_size - 1);
+    last = jit_used + JIT_CODE_MARGIN + jit_page_size - 1;
+    last &= ~(jit_page_size - 1);
+    if (last > JIT_CODE_SIZE)
+        last = JIT_CODE_SIZE;
+    return mprotect(jit_code + first, last - first, protection);
+}
+
+void recompile(unsigned int PC)
+{
+    const decoded_inst * inst;
+    union {
+        u8 * code;
+        p_block block;
+    } start;
+    u8 * skip;
+    unsigned int entry;
+    register int count;
+
+    entry = PC = FIT_IMEM(PC);
+    if (recompiled[entry / 4] != NULL)
+        return;
+    if (jit_visits[jit_image][entry / 4] >= JIT_ATTEMPTED)
+        return;
+    if (++jit_visits[jit_image][entry / 4] < JIT_HOT_VISITS)
+        return;
+    jit_visits[jit_image][entry / 4] = JIT_ATTEMPTED;
+
+    if (jit_code == NULL && jit_allocate() == 0)
+        return;
+    if (jit_unavailable)
+        return;
+    if (jit_used > JIT_CODE_SIZE - JIT_CODE_MARGIN) {
+        memset(jit_tables, 0, sizeof(jit_tables));
+        memset(jit_visits, 0, sizeof(jit_visits));
+        jit_visits[jit_image][entry / 4] = JIT_ATTEMPTED;
+        jit_used = 0;
+    }
+    if (jit_protect(PROT_READ | PROT_WRITE) != 0)
+        return; /* The blocks already made can still run. */
+
+    start.code = jit_out = jit_code + jit_used;
+    jit_emit8(0x53); /* push rbx */
+    jit_emit8(0x55); /* push rbp */
+    jit_emit8(0x48); jit_emit8(0x83); jit_emit8(0xEC); jit_emit8(0x08);
+    jit_emit8(0x48); jit_emit8(0xBB); /* mov rbx, SR */
+    jit_emit64(JIT_ADDRESS(&SR[0]));
+    jit_forget_registers();
+
+    for (count = 0; count < JIT_MAX_BLOCK_SIZE; count++) {
+        inst = &decoded_IMEM[PC / 4];
+        if (inst -> op == SU_SPIN_LOOP)
+            break; /* The interpreter decides whether to leave the loop. */
+        if (jit_branches(inst -> base_op)) {
+            if (jit_branch(inst, PC) == 0)
+                break;
+            goto finished;
+        }
+        switch (inst -> base_op) {
+        case SU_MFC0: /* ...can halt with the semaphore or status time-outs. */
+            jit_args(2, inst -> rt, inst -> rd, 0, 0);
+            jit_call(JIT_ADDRESS(SP_CP0_MF));
+            jit_test_halt();
+            jit_emit8(0x74); /* jz past the epilogue */
+            skip = jit_out++;
+            jit_epilogue(PC + 4);
+            *skip = (u8)(jit_out - skip - 1);
+            break;
+        case SU_MTC0: /* ...can halt, DMA over IMEM or start the RDP. */
+            jit_args(1, inst -> rt, 0, 0, 0);
+            jit_call_table(JIT_ADDRESS(&SP_CP0_MT[inst -> rd]));
+            jit_epilogue(PC + 4);
+            goto finished;
+        case SU_BREAK:
+            jit_call(JIT_ADDRESS(BREAK));
+            jit_epilogue(PC + 4);
+            goto finished;
+        default:
+            if (jit_simple(inst) == 0)
+                goto unfinished;
+        }
+        PC = FIT_IMEM(PC + 4);
+    }
+unfinished:
+    if (count == 0)
+        start.code = NULL;
+    else
+        jit_epilogue(PC);
+finished:
+    if (jit_protect(PROT_READ | PROT_EXEC) != 0) {
+        memset(jit_tables, 0, sizeof(jit_tables));
+        jit_unavailable = 1; /* Just keep interpreting everything. */
+        return;
+    }
+    if (start.code != NULL) {
+        recompiled[entry / 4] = start.block;
+        jit_used = (size_t)(jit_out - jit_code);
+        jit_used = (jit_used + 15) & ~(size_t)15;
+    }
+    return;
+}
+#endif
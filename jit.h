@@ -0,0 +1,47 @@
+/******************************************************************************\
+* Project:  x86-64 Basic Block Recompiler for the Scalar Unit                  *
+* License:  CC0 Public Domain Dedication                                       *
+*                                                                              *
+* To the extent possible under law, the author(s) have dedicated all copyright *
+* and related and neighboring rights to this software to the public domain     *
+* worldwide. This software is distributed without any warranty.                *
+*                                                                              *
+* You should have received a copy of the CC0 Public Domain Dedication along    *
+* with this software.                                                          *
+* If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.             *
+\******************************************************************************/
+
+#ifndef _JIT_H_
+#define _JIT_H_
+
+#include "su.h"
+#include "icache.h"
+
+#ifdef SU_X64_JIT
+/*
+ * A recompiled block runs from its IMEM address until it either branches or
+ * reaches something only the interpreter handles, then returns the IMEM
+ * address to resume at.  The SP_STATUS_HALT bit must be checked afterwards.
+ */
+typedef u32 (*p_block)(void);
+
+extern p_block * recompiled;
+
+/*
+ * Try to recompile the block starting at the IMEM address PC, once it has
+ * been asked for often enough to look worth it, unless it has already been
+ * recompiled (or already been found not worth recompiling).
+ */
+extern void recompile(unsigned int PC);
+
+/*
+ * Every cached IMEM image has its own table of recompiled blocks, so that
+ * switching microcodes does not throw away the blocks made for the others.
+ * `image` is an index into the IMEM image cache, or ICACHE_IMAGES for an
+ * image in decoded_IMEM[] which is not cached.
+ */
+extern void select_recompiled(unsigned int image);
+extern void flush_recompiled(unsigned int image);
+#endif
+
+#endif
@@ -24,8 +24,17 @@
  *   $ ld --shared -o rsp.so -lc rsp.o --strip-all
  */
 
+/*
+ * One translation unit means one set of target flags, so the SSSE3, SSE4.1
+ * and AVX2 variants of the vector unit (vu/vu_*.c) are left out of it.
+ */
+#define VU_NO_ISA_DISPATCH
+
 #include "module.c"
 #include "su.c"
+#include "icache.c"
+#include "jit.c"
+#include "mirror.c"
 
 #include "vu/vu.c"
 
@@ -7,6 +7,9 @@ obj="$src/obj"
 OBJ_LIST="\
     $obj/module.o \
     $obj/su.o \
+    $obj/icache.o \
+    $obj/jit.o \
+    $obj/mirror.o \
     $obj/vu/vu.o \
     $obj/vu/multiply.o \
     $obj/vu/add.o \
@@ -22,6 +25,7 @@ FLAGS_x86="\
     -fPIC \
     -DPLUGIN_API_VERSION=0x0101 \
     -DARCH_MIN_SSE2 \
+    -DVU_NO_ISA_DISPATCH \
     -march=native \
     -mstackrealign \
     -Wall \
@@ -35,6 +39,7 @@ FLAGS_x86="\
     -masm=intel \
     -DPLUGIN_API_VERSION=0x0101 \
     -DARCH_MIN_SSE2 \
+    -DVU_NO_ISA_DISPATCH \
     -march=native \
     -mstackrealign \
     -Wall \
@@ -49,6 +54,9 @@ C_FLAGS=$FLAGS_x86 # default since Intel SIMD was the most tested
 echo Compiling C source code...
 cc -S -Os $C_FLAGS -o $obj/module.s  $src/module.c
 cc -S -O3 $C_FLAGS -o $obj/su.s      $src/su.c
+cc -S -O3 $C_FLAGS -o $obj/icache.s  $src/icache.c
+cc -S -O2 $C_FLAGS -o $obj/jit.s     $src/jit.c
+cc -S -Os $C_FLAGS -o $obj/mirror.s  $src/mirror.c
 cc -S -O3 $C_FLAGS -o $obj/vu/vu.s       $src/vu/vu.c
 cc -S -O3 $C_FLAGS -o $obj/vu/multiply.s $src/vu/multiply.c
 cc -S -O3 $C_FLAGS -o $obj/vu/add.s      $src/vu/add.c
@@ -59,6 +67,9 @@ cc -S -O2 $C_FLAGS -o $obj/vu/divide.s   $src/vu/divide.c
 echo Assembling compiled sources...
 as -o $obj/module.o $obj/module.s
 as -o $obj/su.o     $obj/su.s
+as -o $obj/icache.o $obj/icache.s
+as -o $obj/jit.o    $obj/jit.s
+as -o $obj/mirror.o $obj/mirror.s
 as -o $obj/vu/vu.o  $obj/vu/vu.s
 as -o $obj/vu/multiply.o $obj/vu/multiply.s
 as -o $obj/vu/add.o      $obj/vu/add.s
@@ -67,5 +78,5 @@ as -o $obj/vu/logical.o  $obj/vu/logical.s
 as -o $obj/vu/divide.o   $obj/vu/divide.s
 
 echo Linking assembled object files...
-ld --shared -o $obj/rspdebug.so -lc $OBJ_LIST
+ld --shared -o $obj/rspdebug.so -lc -lrt $OBJ_LIST
 strip -o $obj/rsp.so $obj/rspdebug.so --strip-all
@@ -20,6 +20,8 @@ set obj=%rsp%\obj
 set OBJ_LIST=^
  "%obj%\module.o"^
  "%obj%\su.o"^
+ "%obj%\icache.o"^
+ "%obj%\mirror.o"^
  "%obj%\vu\vu.o"^
  "%obj%\vu\multiply.o"^
  "%obj%\vu\add.o"^
@@ -35,6 +37,7 @@ set FLAGS_x86=-Wall -pedantic^
  -masm=intel^
  -DPLUGIN_API_VERSION=0x0101^
  -DARCH_MIN_SSE2^
+ -DVU_NO_ISA_DISPATCH^
  -mstackrealign^
  -march=native
 set C_FLAGS=%FLAGS_x86%
@@ -50,6 +53,8 @@ ECHO Compiling C source code...
 @ECHO ON
 gcc -Os -S %C_FLAGS% -o "%obj%\module.asm"      "%rsp%\module.c"
 gcc -O3 -S %C_FLAGS% -o "%obj%\su.asm"          "%rsp%\su.c"
+gcc -O3 -S %C_FLAGS% -o "%obj%\icache.asm"      "%rsp%\icache.c"
+gcc -Os -S %C_FLAGS% -o "%obj%\mirror.asm"      "%rsp%\mirror.c"
 gcc -O3 -S %C_FLAGS% -o "%obj%\vu\vu.asm"       "%rsp%\vu\vu.c"
 gcc -O3 -S %C_FLAGS% -o "%obj%\vu\multiply.asm" "%rsp%\vu\multiply.c"
 gcc -O3 -S %C_FLAGS% -o "%obj%\vu\add.asm"      "%rsp%\vu\add.c"
@@ -62,6 +67,8 @@ ECHO.
 ECHO Assembling compiled sources...
 as -o "%obj%\module.o"            "%obj%\module.asm"
 as -o "%obj%\su.o"                "%obj%\su.asm"
+as -o "%obj%\icache.o"            "%obj%\icache.asm"
+as -o "%obj%\mirror.o"            "%obj%\mirror.asm"
 as -o "%obj%\vu\vu.o"             "%obj%\vu\vu.asm"
 as -o "%obj%\vu\multiply.o"       "%obj%\vu\multiply.asm"
 as -o "%obj%\vu\add.o"            "%obj%\vu\add.asm"
@@ -24,6 +24,8 @@ set obj=%rsp%\obj
 set OBJ_LIST=^
  "%obj%\module.o"^
  "%obj%\su.o"^
+ "%obj%\icache.o"^
+ "%obj%\mirror.o"^
  "%obj%\vu\vu.o"^
  "%obj%\vu\multiply.o"^
  "%obj%\vu\add.o"^
@@ -38,6 +40,7 @@ set FLAGS_ANSI=-Wall -pedantic^
 set FLAGS_x86=-Wall -pedantic^
  -DPLUGIN_API_VERSION=0x0101^
  -DARCH_MIN_SSE2^
+ -DVU_NO_ISA_DISPATCH^
  -masm=intel^
  -mstackrealign^
  -march=native
@@ -54,6 +57,8 @@ ECHO Compiling C source code...
 @ECHO ON
 gcc -S -Os %C_FLAGS% -o "%obj%\module.asm"      "%rsp%\module.c"
 gcc -S -O3 %C_FLAGS% -o "%obj%\su.asm"          "%rsp%\su.c"
+gcc -S -O3 %C_FLAGS% -o "%obj%\icache.asm"      "%rsp%\icache.c"
+gcc -S -Os %C_FLAGS% -o "%obj%\mirror.asm"      "%rsp%\mirror.c"
 gcc -S -O3 %C_FLAGS% -o "%obj%\vu\vu.asm"       "%rsp%\vu\vu.c"
 gcc -S -O3 %C_FLAGS% -o "%obj%\vu\multiply.asm" "%rsp%\vu\multiply.c"
 gcc -S -O3 %C_FLAGS% -o "%obj%\vu\add.asm"      "%rsp%\vu\add.c"
@@ -66,6 +71,8 @@ ECHO.
 ECHO Assembling compiled sources...
 as -o "%obj%\module.o"            "%obj%\module.asm"
 as -o "%obj%\su.o"                "%obj%\su.asm"
+as -o "%obj%\icache.o"            "%obj%\icache.asm"
+as -o "%obj%\mirror.o"            "%obj%\mirror.asm"
 as -o "%obj%\vu\vu.o"             "%obj%\vu\vu.asm"
 as -o "%obj%\vu\multiply.o"       "%obj%\vu\multiply.asm"
 as -o "%obj%\vu\add.o"            "%obj%\vu\add.asm"
@@ -0,0 +1,100 @@
+/******************************************************************************\
+* Project:  Double-Mapped Mirrors of DMEM and IMEM                             *
+* License:  CC0 Public Domain Dedication                                       *
+*                                                                              *
+* To the extent possible under law, the author(s) have dedicated all copyright *
+* and related and neighboring rights to this software to the public domain     *
+* worldwide. This software is distributed without any warranty.                *
+*                                                                              *
+* You should have received a copy of the CC0 Public Domain Dedication along    *
+* with this software.                                                          *
+* If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.             *
+\******************************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "mirror.h"
+
+#ifdef _WIN32
+pu8 map_SP_memory(void)
+{
+    return NULL;
+}
+void unmap_SP_memory(pu8 memory)
+{
+    (void)memory; /* unused */
+    return;
+}
+#else
+/*
+ * A shared memory object of 16 KiB is mapped once to reserve the addresses,
+ * and then each 4-KiB page of those is mapped again over the first or the
+ * second page of the object.
+ */
+pu8 map_SP_memory(void)
+{
+    char name[32];
+    pu8 memory;
+    volatile u8 * probe;
+    long page_size;
+    int fd;
+    register int i;
+
+    page_size = sysconf(_SC_PAGESIZE);
+    if (page_size <= 0 || 0x1000 % page_size != 0)
+        return NULL;
+
+    sprintf(name, "/rsp-cxd4-%lu", (unsigned long)getpid());
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+        return NULL;
+    shm_unlink(name); /* Only the mappings have to keep it now. */
+
+    memory = MAP_FAILED;
+    if (ftruncate(fd, MIRRORED_SP_MEMORY_SIZE) == 0)
+        memory = mmap(
+            NULL, MIRRORED_SP_MEMORY_SIZE, PROT_READ | PROT_WRITE,
+            MAP_SHARED, fd, 0
+        );
+    for (i = 0; i < 4 && memory != MAP_FAILED; i++)
+        if (mmap(
+            memory + 0x1000*i, 0x1000, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_FIXED, fd, 0x1000*(i / 2)) == MAP_FAILED
+        ) {
+            munmap(memory, MIRRORED_SP_MEMORY_SIZE);
+            memory = MAP_FAILED;
+        }
+    close(fd);
+    if (memory == MAP_FAILED)
+        return NULL;
+
+/*
+ * Make sure that the two mappings really are the same memory, in case the
+ * host quietly made private copies.  The compiler takes memory[0x0000] and
+ * memory[0x1000] for two different bytes, so the test has to go through a
+ * volatile pointer.
+ */
+    probe = memory;
+    probe[0x0000] = 0xFF;
+    if (probe[0x1000] != 0xFF) {
+        unmap_SP_memory(memory);
+        return NULL;
+    }
+    probe[0x0000] = 0x00;
+    return (memory);
+}
+void unmap_SP_memory(pu8 memory)
+{
+    if (memory != NULL)
+        munmap(memory, MIRRORED_SP_MEMORY_SIZE);
+    return;
+}
+#endif
@@ -0,0 +1,35 @@
+/******************************************************************************\
+* Project:  Double-Mapped Mirrors of DMEM and IMEM                             *
+* License:  CC0 Public Domain Dedication                                       *
+*                                                                              *
+* To the extent possible under law, the author(s) have dedicated all copyright *
+* and related and neighboring rights to this software to the public domain     *
+* worldwide. This software is distributed without any warranty.                *
+*                                                                              *
+* You should have received a copy of the CC0 Public Domain Dedication along    *
+* with this software.                                                          *
+* If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.             *
+\******************************************************************************/
+
+#ifndef _MIRROR_H_
+#define _MIRROR_H_
+
+#include "my_types.h"
+
+/*
+ * 16 KiB of the plugin's own memory for DMEM and IMEM:  DMEM at offset
+ * 0x0000 and IMEM at 0x2000, each followed by a second mapping of the same
+ * 4-KiB page.  Anything read or written running over the end of either one
+ * lands at its start, the same as the RSP's own address wrapping, so wide
+ * loads and stores near the end need no special cases.
+ *
+ * NULL is returned if the host cannot map 4-KiB pages twice over, such as
+ * any host with bigger pages, or Windows, where views of a file mapping
+ * must start on 64-KiB boundaries.
+ */
+#define MIRRORED_SP_MEMORY_SIZE 0x4000
+
+extern pu8 map_SP_memory(void);
+extern void unmap_SP_memory(pu8 memory);
+
+#endif
@@ -13,7 +13,7 @@
 * If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.             *
 \******************************************************************************/
 
-#define _POSIX_SOURCE 1
+#define _POSIX_C_SOURCE 200112L
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -32,6 +32,9 @@
 
 #include "module.h"
 #include "su.h"
+#include "icache.h"
+#include "mirror.h"
+#include "trace.h"
 
 #include "m64p_common.h"
 
@@ -57,7 +60,35 @@ static void ISA_op_illegal(int signal_code)
     raise(signal_code); /* e.g., rsp.dll built with -mssse3; the CPU is SSE2. */
 }
 
-RSP_INFO RSP_INFO_NAME;
+#ifdef RSP_REENTRANT
+static int open_context(void)
+{
+    pu8 allocation;
+
+    if (RSP_current != NULL)
+        return 1;
+    allocation = calloc(1, sizeof(rsp_context) + 64);
+    if (allocation == NULL)
+        return 0;
+    RSP_current = (rsp_context *)(allocation + 64 - (size_t)allocation % 64);
+    RSP_current -> allocation = allocation;
+    return 1;
+}
+#endif
+static void close_context(void)
+{
+#ifdef RSP_REENTRANT
+    if (RSP_current == NULL)
+        return;
+#endif
+    unmap_SP_memory(SP_memory);
+    SP_memory = NULL;
+#ifdef RSP_REENTRANT
+    free(RSP_current -> allocation);
+    RSP_current = NULL;
+#endif
+    return;
+}
 
 #define RSP_CXD4_VERSION 0x0101
 
@@ -84,6 +115,7 @@ ptr_ConfigGetParameter     ConfigGetParameter = NULL;
 ptr_ConfigSetDefaultFloat  ConfigSetDefaultFloat;
 ptr_ConfigSetDefaultBool   ConfigSetDefaultBool = NULL;
 ptr_ConfigGetParamBool     ConfigGetParamBool = NULL;
+ptr_ConfigGetUserCachePath ConfigGetUserCachePath = NULL;
 ptr_CoreDoCommand          CoreDoCommand = NULL;
 
 NOINLINE void update_conf(const char* source)
@@ -96,6 +128,7 @@ NOINLINE void update_conf(const char* source)
     CFG_HLE_AUD = ConfigGetParamBool(l_ConfigRsp, "AudioListToAudioPlugin");
     CFG_WAIT_FOR_CPU_HOST = ConfigGetParamBool(l_ConfigRsp, "WaitForCPUHost");
     CFG_MEND_SEMAPHORE_LOCK = ConfigGetParamBool(l_ConfigRsp, "SupportCPUSemaphoreLock");
+    CFG_PERSISTENT_ICACHE = ConfigGetParamBool(l_ConfigRsp, "PersistentInstructionCache");
 }
 
 static void DebugMessage(int level, const char *message, ...) ATTR_FMT(2, 3);
@@ -155,6 +188,7 @@ EXPORT m64p_error CALL PluginStartup(m64p_dynlib_handle CoreLibHandle, void *Con
     ConfigSetDefaultFloat = (ptr_ConfigSetDefaultFloat) osal_dynlib_getproc(CoreLibHandle, "ConfigSetDefaultFloat");
     ConfigSetDefaultBool = (ptr_ConfigSetDefaultBool) osal_dynlib_getproc(CoreLibHandle, "ConfigSetDefaultBool");
     ConfigGetParamBool = (ptr_ConfigGetParamBool) osal_dynlib_getproc(CoreLibHandle, "ConfigGetParamBool");
+    ConfigGetUserCachePath = (ptr_ConfigGetUserCachePath) osal_dynlib_getproc(CoreLibHandle, "ConfigGetUserCachePath");
     CoreDoCommand = (ptr_CoreDoCommand) osal_dynlib_getproc(CoreLibHandle, "CoreDoCommand");
 
     if (!ConfigOpenSection || !ConfigDeleteSection || !ConfigSetParameter || !ConfigGetParameter ||
@@ -200,6 +234,7 @@ EXPORT m64p_error CALL PluginStartup(m64p_dynlib_handle CoreLibHandle, void *Con
     ConfigSetDefaultBool(l_ConfigRsp, "AudioListToAudioPlugin", 0, "Send audio lists to the audio plugin");
     ConfigSetDefaultBool(l_ConfigRsp, "WaitForCPUHost", 0, "Force CPU-RSP signals synchronization");
     ConfigSetDefaultBool(l_ConfigRsp, "SupportCPUSemaphoreLock", 0, "Support CPU-RSP semaphore lock");
+    ConfigSetDefaultBool(l_ConfigRsp, "PersistentInstructionCache", 0, "Save predecoded RSP microcodes to " ICACHE_FILE " in the user cache directory for the next run");
 
     l_PluginInit = 1;
     return M64ERR_SUCCESS;
@@ -207,6 +242,7 @@ EXPORT m64p_error CALL PluginStartup(m64p_dynlib_handle CoreLibHandle, void *Con
 
 EXPORT m64p_error CALL PluginShutdown(void)
 {
+    close_context(); /* even if another thread shut the plugin down first */
     if (!l_PluginInit)
         return M64ERR_NOT_INIT;
 
@@ -239,6 +275,10 @@ EXPORT m64p_error CALL PluginGetVersion(m64p_plugin_type *PluginType, int *Plugi
 
 EXPORT int CALL RomOpen(void)
 {
+#ifdef RSP_REENTRANT
+    if (open_context() == 0)
+        return 0;
+#endif
     if (!l_PluginInit)
         return 0;
 
@@ -265,8 +305,12 @@ static void init_regs(void)
     srand(time(NULL));
 
     for (i = 0; i < N; i++) {
+#ifdef VU_WIDE_ACCUMULATOR
+        VACC_W[i] = ((u64)0xFFFFFFFF0000 >> 16) & 0x00000000;
+#else
         VACC_H[i] = ((u64)0xFFFF00000000 >> 32) & 0x0000;
         VACC_M[i] = ((u64)0x0000FFFF0000 >> 16) & 0x0000;
+#endif
         VACC_L[i] = ((u64)0x00000000FFFF >>  0) & 0x0000;
     }
 #if 0
@@ -282,13 +326,15 @@ static void init_regs(void)
  * explicitly initialized to 0 at power-on or if they temporarily retain old
  * decaying bits, we'll just make them 0 to hush krom's RSP test FAIL yells.
  */
+    VCO = VCC = 0x0000;
+    VCE = 0x00;
     for (i = 0; i < N; i++) {
-        cf_ne[i]   = (rand() & (1 << 15)) ? 0*TRUE : FALSE;
-        cf_co[i]   = (rand() & (1 << 12)) ? 0*TRUE : FALSE;
-        cf_clip[i] = (rand() & (1 <<  9)) ? 0*TRUE : FALSE;
-        cf_comp[i] = (rand() & (1 <<  6)) ? 0*TRUE : FALSE;
+        VCO |= ((rand() & (1 << 15)) ? 0*TRUE : FALSE) << (i + 0x8);
+        VCO |= ((rand() & (1 << 12)) ? 0*TRUE : FALSE) << (i + 0x0);
+        VCC |= ((rand() & (1 <<  9)) ? 0*TRUE : FALSE) << (i + 0x8);
+        VCC |= ((rand() & (1 <<  6)) ? 0*TRUE : FALSE) << (i + 0x0);
 
-        cf_vce[i]  = (rand() & (1 <<  0)) ? 0*TRUE : FALSE;
+        VCE |= ((rand() & (1 <<  0)) ? 0*TRUE : FALSE) << i;
     }
 
     for (i = 0; i < 32; i++)
@@ -337,7 +383,12 @@ static void init_regs(void)
 
 EXPORT void CALL CloseDLL(void)
 {
+#ifdef RSP_REENTRANT
+    if (RSP_current == NULL)
+        return;
+#endif
     DRAM = NULL; /* so DllTest benchmark doesn't think ROM is still open */
+    close_context();
     return;
 }
 
@@ -367,6 +418,20 @@ EXPORT void CALL DllConfig(p_void hParent)
 
 #endif
 
+/*
+ * Every task is run to its BREAK (or to the semaphore or timeout exits of
+ * run_task()) before this returns, on the thread of the core that called.
+ *
+ * Running it on a thread of our own and returning at once would be unsafe.
+ * The core reads SP_STATUS, the MI interrupt register and its own copy of
+ * DMEM whenever it likes, without telling the plugin.  It may write to the
+ * SP registers or DMA into DMEM in between, too.  CheckInterrupts() is not
+ * safe to call from any other thread.  The plugin specs have no later call
+ * on the core's own thread at which a finished task could be published or
+ * a running one waited for.  The RSP interrupt that the game is waiting for
+ * would then only be raised at the next DoRspCycles(), which the game will
+ * not start until it has had that interrupt.
+ */
 EXPORT unsigned int CALL DoRspCycles(unsigned int cycles)
 {
     static char task_debug[] = "unknown task type:  0x????????";
@@ -380,14 +445,18 @@ EXPORT unsigned int CALL DoRspCycles(unsigned int cycles)
     }
     task_debug_type = &task_debug[strlen("unknown task type:  0x")];
 
+/*
+ * The task header is read straight out of the core's DMEM, so that the HLE
+ * tasks, which never touch the mirrors (mirror.h), skip copying them in.
+ */
 #ifdef USE_CLIENT_ENDIAN
-    memcpy(&task_type, DMEM + 0xFC0, 4);
+    memcpy(&task_type, core_DMEM() + 0xFC0, 4);
 #else
     task_type = 0x00000000
-      | (u32)(DMEM[0xFC0 ^ 0] & 0xFFu) << 24
-      | (u32)(DMEM[0xFC1 ^ 0] & 0xFFu) << 16
-      | (u32)(DMEM[0xFC2 ^ 0] & 0xFFu) <<  8
-      | (u32)(DMEM[0xFC3 ^ 0] & 0xFFu) <<  0
+      | (u32)(core_DMEM()[0xFC0 ^ 0] & 0xFFu) << 24
+      | (u32)(core_DMEM()[0xFC1 ^ 0] & 0xFFu) << 16
+      | (u32)(core_DMEM()[0xFC2 ^ 0] & 0xFFu) <<  8
+      | (u32)(core_DMEM()[0xFC3 ^ 0] & 0xFFu) <<  0
     ;
 #endif
     switch (task_type) {
@@ -395,7 +464,7 @@ EXPORT unsigned int CALL DoRspCycles(unsigned int cycles)
         if (CFG_HLE_GFX == 0)
             break;
 
-        if (*(pi32)(DMEM + 0xFF0) == 0x00000000)
+        if (*(pi32)(core_DMEM() + 0xFF0) == 0x00000000)
             break; /* Resident Evil 2, null task pointers */
         GET_RCP_REG(SP_STATUS_REG) |=
             SP_STATUS_SIG2 | SP_STATUS_BROKE | SP_STATUS_HALT
@@ -466,11 +535,21 @@ EXPORT unsigned int CALL DoRspCycles(unsigned int cycles)
         message(task_debug);
     }
 
+    fetch_SP_memory();
 #ifdef WAIT_FOR_CPU_HOST
     for (i = 0; i < NUMBER_OF_SCALAR_REGISTERS; i++)
         MFC0_count[i] = 0;
 #endif
+#ifdef SP_CAPTURE_TASKS
+    capture_task_begin(cycles);
+#endif
+    decode_IMEM(); /* The CPU may have reloaded IMEM since the last task. */
     run_task();
+    flush_RDP_queue();
+    flush_SP_memory();
+#ifdef SP_CAPTURE_TASKS
+    capture_task_end();
+#endif
 
 /*
  * An optional EMMS when compiling with Intel SIMD or MMX support.
@@ -511,7 +590,6 @@ EXPORT void CALL GetDllInfo(PLUGIN_INFO *PluginInfo)
     return;
 }
 
-p_func GBI_phase;
 void no_LLE(void)
 {
     static int already_warned;
@@ -522,18 +600,131 @@ void no_LLE(void)
     already_warned = TRUE;
     return;
 }
+/*
+ * the number of bytes which can be read from `address` on, or zero if the
+ * host has no way to tell without reading them
+ */
+static size_t readable_bytes(const void * address)
+{
+#if defined(_WIN32)
+    MEMORY_BASIC_INFORMATION region;
+    const char * base = (const char *)address;
+    size_t bytes;
+
+    bytes = 0;
+    while (bytes < 0x80000000ul) {
+        if (VirtualQuery(base + bytes, &region, sizeof(region)) == 0)
+            break;
+        if (region.State != MEM_COMMIT)
+            break;
+        if (region.Protect & (PAGE_NOACCESS | PAGE_GUARD))
+            break;
+        bytes = (const char *)region.BaseAddress + region.RegionSize - base;
+    }
+    return (bytes);
+#elif defined(__linux__)
+    char line[256];
+    unsigned long start, end, reach;
+    char readable;
+    FILE * maps;
+    int whole_line;
+
+    maps = fopen("/proc/self/maps", "r");
+    if (maps == NULL)
+        return 0;
+    reach = 0;
+    whole_line = 1; /* Path names longer than line[] come in several parts. */
+    while (fgets(line, sizeof(line), maps) != NULL) {
+        const int at_line_start = whole_line;
+
+        whole_line = (strchr(line, '\n') != NULL);
+        if (!at_line_start)
+            continue;
+        if (sscanf(line, "%lx-%lx %c", &start, &end, &readable) != 3)
+            continue;
+        if (reach == 0) {
+            if ((unsigned long)address - start < end - start && readable == 'r')
+                reach = end;
+        } else if (start == reach && readable == 'r') {
+            reach = end; /* The readable memory goes on in the next mapping. */
+        } else if (start >= reach) {
+            break;
+        }
+    }
+    fclose(maps);
+    return (reach == 0) ? 0 : (size_t)(reach - (unsigned long)address);
+#else
+    address = NULL; /* unused */
+    return 0;
+#endif
+}
+
+/*
+ * the offset of the first 2-MiB step into DRAM that cannot be read
+ *
+ * Asking the host how far the readable memory from DRAM on goes takes
+ * microseconds and touches none of it.  Only if the host cannot say are the
+ * steps read one by one until one of them faults, under a SIGSEGV handler.
+ * Zero means that neither way was available.
+ */
+static u32 probe_RDRAM(void)
+{
+    size_t bytes;
+    volatile u32 offset; /* kept in memory across siglongjmp() */
+
+    bytes = readable_bytes(DRAM);
+    if (bytes != 0) {
+        if (bytes > 0x80000000ul)
+            bytes = 0x80000000ul;
+        return (u32)((bytes + 0x001FFFFFul) & ~0x001FFFFFul);
+    }
+#ifdef _WIN32
+    offset = 0;
+#else
+    struct sigaction sa = {.sa_handler = seg_av_handler};
+    struct sigaction prev_sa;
+
+    sigaction(SIGSEGV, &sa, &prev_sa);
+    for (offset = 0; offset < 0x80000000ul; offset += 0x200000) {
+        int recovered_from_exception = sigsetjmp(CPU_state, 1);
+        if (recovered_from_exception)
+            break;
+        SR[at] += DRAM[offset];
+    }
+    sigaction(SIGSEGV, &prev_sa, NULL);
+#endif
+    return (offset);
+}
+
 EXPORT void CALL InitiateRSP(RSP_INFO Rsp_Info, pu32 CycleCount)
 {
     if (CycleCount != NULL) /* cycle-accuracy not doable with today's hosts */
         *CycleCount = 0;
+#ifdef RSP_REENTRANT
+    if (open_context() == 0) {
+        message("Out of memory for another RSP context.");
+        return;
+    }
+#endif
     update_conf(CFG_FILE);
+    select_vector_ISA();
 
     RSP_INFO_NAME = Rsp_Info;
     DRAM = GET_RSP_INFO(RDRAM);
-    if (Rsp_Info.DMEM == Rsp_Info.IMEM) /* usually dummy RSP data for testing */
+    su_max_address = 0x007FFFFFul; /* unless the RDRAM can be measured */
+    DMEM_window_end = 0x00000FF0;
+    if (core_DMEM() == core_IMEM()) /* usually dummy RSP data for testing */
         return; /* DMA is not executed just because plugin initiates. */
-    DMEM = GET_RSP_INFO(DMEM);
-    IMEM = GET_RSP_INFO(IMEM);
+    if (SP_memory == NULL)
+        SP_memory = map_SP_memory();
+    if (SP_memory == NULL) {
+        DMEM = core_DMEM();
+        IMEM = core_IMEM();
+    } else {
+        DMEM = SP_memory + 0x0000;
+        IMEM = SP_memory + 0x2000;
+        DMEM_window_end = 0x00000FFF;
+    }
 
     CR[0x0] = &GET_RCP_REG(SP_MEM_ADDR_REG);
     CR[0x1] = &GET_RCP_REG(SP_DRAM_ADDR_REG);
@@ -552,6 +743,8 @@ EXPORT void CALL InitiateRSP(RSP_INFO Rsp_Info, pu32 CycleCount)
     CR[0xE] = &GET_RCP_REG(DPC_PIPEBUSY_REG);
     CR[0xF] = &GET_RCP_REG(DPC_TMEM_REG);
     init_regs();
+    if (CFG_PERSISTENT_ICACHE)
+        load_icache(cache_file(ICACHE_FILE));
 
     MF_SP_STATUS_TIMEOUT = 32767;
 #if 1
@@ -563,24 +756,15 @@ EXPORT void CALL InitiateRSP(RSP_INFO Rsp_Info, pu32 CycleCount)
         GBI_phase = no_LLE;
 
     signal(SIGILL, ISA_op_illegal);
-#ifndef _WIN32
-    struct sigaction sa = {.sa_handler = seg_av_handler};
-    struct sigaction prev_sa;
-    sigaction(SIGSEGV, &sa, &prev_sa);
-    for (SR[ra] = 0; SR[ra] < 0x80000000ul; SR[ra] += 0x200000) {
-        int recovered_from_exception = sigsetjmp(CPU_state, 1);
-        if (recovered_from_exception)
-            break;
-        SR[at] += DRAM[SR[ra]];
-    }
-    sigaction(SIGSEGV, &prev_sa, NULL);
-    for (SR[at] = 0; SR[at] < 31; SR[at]++) {
-        SR[ra] = (SR[ra] & ~1) >> 1;
-        if (SR[ra] == 0)
-            break;
+    SR[ra] = probe_RDRAM();
+    if (SR[ra] != 0) {
+        for (SR[at] = 0; SR[at] < 31; SR[at]++) {
+            SR[ra] = (SR[ra] & ~1) >> 1;
+            if (SR[ra] == 0)
+                break;
+        }
+        su_max_address = (1 << SR[at]) - 1;
     }
-    su_max_address = (1 << SR[at]) - 1;
-#endif
 
     if (su_max_address < 0x1FFFFFul)
         su_max_address = 0x1FFFFFul; /* 2 MiB */
@@ -592,6 +776,14 @@ EXPORT void CALL InitiateRSP(RSP_INFO Rsp_Info, pu32 CycleCount)
 EXPORT void CALL RomClosed(void)
 {
     GET_RCP_REG(SP_PC_REG) = 0x04001000;
+    if (CFG_PERSISTENT_ICACHE)
+        save_icache(cache_file(ICACHE_FILE));
+#ifdef SU_PROFILE_IDIOMS
+    export_idiom_profile(cache_file(IDIOM_PROFILE_FILE));
+#endif
+#ifdef SP_CAPTURE_TASKS
+    capture_close();
+#endif
 
 /*
  * Sometimes the end user won't correctly install to the right directory. :(
@@ -731,6 +923,29 @@ NOINLINE void export_instruction_cache(void)
     free(IMEM_swapped);
     return;
 }
+/*
+ * DMEM and IMEM are the core's memory only if they could not be mirrored.
+ * Otherwise the core's copies are only read in when a task starts, and
+ * written back when it ends or when the RDP is to read commands from DMEM.
+ * The RSP's own DMA transfers go straight to or from the mirrors.
+ */
+void fetch_SP_memory(void)
+{
+    if (DMEM == core_DMEM())
+        return;
+    memcpy(DMEM, core_DMEM(), 4096);
+    memcpy(IMEM, core_IMEM(), 4096);
+    return;
+}
+void flush_SP_memory(void)
+{
+    if (DMEM == core_DMEM())
+        return;
+    memcpy(core_DMEM(), DMEM, 4096);
+    memcpy(core_IMEM(), IMEM, 4096);
+    return;
+}
+
 void export_SP_memory(void)
 {
     export_data_cache();
@@ -738,6 +953,218 @@ void export_SP_memory(void)
     return;
 }
 
+const char * cache_file(const char * name)
+{
+#if defined(M64P_PLUGIN_API)
+    static char path[1024];
+    const char * directory;
+    size_t length;
+
+    directory = NULL;
+    if (ConfigGetUserCachePath != NULL)
+        directory = ConfigGetUserCachePath();
+    if (directory == NULL)
+        return (name);
+    length = strlen(directory);
+    if (length + 1 + strlen(name) >= sizeof(path))
+        return (name);
+    strcpy(path, directory);
+    if (length != 0 && path[length - 1] != '/' && path[length - 1] != '\\')
+        path[length++] = '/';
+    strcpy(path + length, name);
+    return (path);
+#else
+    return (name);
+#endif
+}
+
+#ifdef SP_CAPTURE_TASKS
+/*
+ * The record of the task being run is put together here and only written
+ * out once the task is over, with the hashes of what it left behind.  The
+ * trace file is started at the first task after the ROM opened.
+ */
+u64 capture_steps;
+
+static FILE * capture_stream;
+static trace_header capture_header;
+static trace_task capture_task;
+static int capture_lost; /* The task could not be recorded in full. */
+
+static pu8 capture_reads;
+static size_t capture_reads_size, capture_reads_limit;
+static trace_span * capture_writes;
+static size_t capture_writes_limit;
+
+static void * capture_grow(void * buffer, size_t * limit, size_t needed)
+{
+    void * grown;
+    size_t size;
+
+    if (needed <= *limit)
+        return (buffer);
+    for (size = (*limit != 0) ? *limit : 0x1000; size < needed; size *= 2)
+        ;
+    grown = realloc(buffer, size);
+    if (grown == NULL) {
+        capture_lost = 1;
+        return (buffer);
+    }
+    *limit = size;
+    return (grown);
+}
+
+/*
+ * Only tried once until the ROM is closed, so as not to complain every task.
+ */
+static void capture_open(void)
+{
+    memset(&capture_header, 0x00, sizeof(capture_header));
+    strcpy(capture_header.magic, TRACE_MAGIC);
+    capture_header.version = TRACE_VERSION;
+    capture_header.header_size = sizeof(trace_header);
+    capture_header.byte_order = 0x01020304;
+    capture_header.RDRAM_size = (u32)(su_max_address + 1);
+
+    capture_stream = fopen(cache_file(TRACE_FILE), "wb");
+    if (capture_stream == NULL) {
+        message("Failed to create the task trace.");
+        return;
+    }
+    fwrite(&capture_header, sizeof(capture_header), 1, capture_stream);
+    return;
+}
+
+void capture_task_begin(unsigned int cycles)
+{
+    trace_task * task = &capture_task;
+    register unsigned int i;
+
+    if (capture_header.version == 0)
+        capture_open();
+    memset(task, 0x00, sizeof(trace_task));
+    task -> cycles = cycles;
+
+    task -> regs[TRACE_MI_INTR] = GET_RCP_REG(MI_INTR_REG);
+    task -> regs[TRACE_SP_PC] = GET_RCP_REG(SP_PC_REG);
+    for (i = 0; i < 7; i++)
+        task -> regs[TRACE_SP_MEM_ADDR + i] = *CR[0x0 + i];
+    task -> regs[TRACE_SP_SEMAPHORE] = *CR[0x7];
+    for (i = 0; i < 8; i++)
+        task -> regs[TRACE_DPC_START + i] = *CR[0x8 + i];
+
+    memcpy(task -> scalars, SR, sizeof(task -> scalars));
+    for (i = 0; i < 32; i++)
+        memcpy(task -> vectors[i], VR[i], sizeof(task -> vectors[i]));
+    for (i = 0; i < N; i++) {
+        task -> acc[0][i] = ACC_H(i);
+        task -> acc[1][i] = ACC_M(i);
+        task -> acc[2][i] = ACC_L(i);
+    }
+    task -> vco = VCO;
+    task -> vcc = VCC;
+    task -> vce = VCE;
+    task -> div_in = DivIn;
+    task -> div_out = DivOut;
+    task -> div_high = DPH;
+    task -> status_timeout = MF_SP_STATUS_TIMEOUT;
+    memcpy(task -> status_reads, MFC0_count, sizeof(task -> status_reads));
+    memcpy(task -> imem, IMEM, 4096);
+    memcpy(task -> dmem, DMEM, 4096);
+
+    capture_reads_size = 0;
+    capture_lost = 0;
+    capture_steps = 0;
+    return;
+}
+
+void capture_DRAM_read(u32 address, u32 length)
+{
+    trace_span span;
+    const size_t padded = sizeof(span) + TRACE_PADDED(length);
+
+    capture_reads = capture_grow(
+        capture_reads, &capture_reads_limit, capture_reads_size + padded
+    );
+    if (capture_lost)
+        return;
+    span.address = address;
+    span.length = length;
+    memset(capture_reads + capture_reads_size, 0x00, padded);
+    memcpy(capture_reads + capture_reads_size, &span, sizeof(span));
+    memcpy(capture_reads + capture_reads_size + sizeof(span), DRAM + address,
+        length);
+    capture_reads_size += padded;
+    capture_task.reads += 1;
+    return;
+}
+
+void capture_DRAM_write(u32 address, u32 length)
+{
+    const size_t count = capture_task.writes;
+
+    capture_writes = capture_grow(
+        capture_writes, &capture_writes_limit, (count + 1) * sizeof(trace_span)
+    );
+    if (capture_lost)
+        return;
+    capture_writes[count].address = address;
+    capture_writes[count].length = length;
+    capture_task.writes += 1;
+    return;
+}
+
+void capture_task_end(void)
+{
+    trace_task * task = &capture_task;
+    u64 hash;
+    register u32 i;
+
+    if (capture_stream == NULL || capture_lost)
+        return;
+    task -> steps = capture_steps;
+    task -> DMEM_hash = trace_hash(TRACE_HASH_SEED, DMEM, 4096);
+    task -> IMEM_hash = trace_hash(TRACE_HASH_SEED, IMEM, 4096);
+    hash = TRACE_HASH_SEED;
+    for (i = 0; i < task -> writes; i++) {
+        hash = trace_hash(hash, &capture_writes[i], sizeof(trace_span));
+        hash = trace_hash(hash,
+            DRAM + capture_writes[i].address, capture_writes[i].length);
+    }
+    task -> RDRAM_hash = hash;
+    task -> record_size = (u32)(sizeof(trace_task)
+      + capture_reads_size + task -> writes * sizeof(trace_span)
+    );
+
+    fwrite(task, sizeof(trace_task), 1, capture_stream);
+    fwrite(capture_reads, 1, capture_reads_size, capture_stream);
+    fwrite(capture_writes, sizeof(trace_span), task -> writes, capture_stream);
+
+/*
+ * The core might never close the ROM, so the count is kept up to date.
+ */
+    capture_header.tasks += 1;
+    fseek(capture_stream, 0, SEEK_SET);
+    fwrite(&capture_header, sizeof(capture_header), 1, capture_stream);
+    fseek(capture_stream, 0, SEEK_END);
+    return;
+}
+
+NOINLINE void capture_close(void)
+{
+    if (capture_stream != NULL)
+        fclose(capture_stream);
+    capture_stream = NULL;
+    capture_header.version = 0;
+    free(capture_reads);
+    free(capture_writes);
+    capture_reads = NULL;
+    capture_writes = NULL;
+    capture_reads_limit = capture_writes_limit = 0;
+    return;
+}
+#endif
+
 /*
  * Microsoft linker defaults to an entry point of `_DllMainCRTStartup',
  * which attaches several CRT dependencies.  To eliminate linkage of unused
@@ -67,16 +67,16 @@ typedef enum {
 #define CFG_TRACE_RSP_REGISTERS     (*(pi32)(conf + 0x18))
 
 /*
- * Update RSP configuration memory from local file resource.
+ * Keep the IMEM image cache of predecoded microcodes in a file (ICACHE_FILE)
+ * from one session to the next, instead of starting over with each run.
  */
-#define CHARACTERS_PER_LINE     (80)
-/* typical standard DOS text file limit per line */
+#define CFG_PERSISTENT_ICACHE       (*(pi32)(conf + 0x1C))
 
 /*
- * When using a graphics plugin from specs version 1.2, LLE is not supported.
- * The behavior of requesting the GBI lists should be adjusted accordingly.
+ * Update RSP configuration memory from local file resource.
  */
-extern p_func GBI_phase;
+#define CHARACTERS_PER_LINE     (80)
+/* typical standard DOS text file limit per line */
 
 NOINLINE extern void update_conf(const char* source);
 
@@ -89,4 +89,42 @@ extern void step_SP_commands(u32 inst);
 #endif
 extern void export_SP_memory(void);
 
+/*
+ * the path to keep a file the plugin makes for itself (such as ICACHE_FILE)
+ * at:  the core's user cache directory with the Mupen64Plus API, else the
+ * working directory.  The path only lasts until the next call.
+ */
+extern const char * cache_file(const char * name);
+
+/*
+ * Copy DMEM and IMEM in from the core's memory, or back out to it, if the
+ * plugin is working on mirrors of them (mirror.h).
+ */
+extern void fetch_SP_memory(void);
+extern void flush_SP_memory(void);
+
+/*
+ * With SP_CAPTURE_TASKS (CAPTURE=1 with the Unix makefile), every task that
+ * DoRspCycles() runs itself, rather than handing it to an HLE plugin, is
+ * appended to TRACE_FILE (trace.h), kept where cache_file() says, for
+ * rsp-replay to run again.  Nothing is fused or recompiled then, so that
+ * run_task() counts every instruction in capture_steps.
+ *
+ * One trace cannot take the tasks of several threads at once, so there is
+ * no capturing with RSP_REENTRANT.
+ */
+#if defined(SP_CAPTURE_TASKS) && defined(RSP_REENTRANT)
+#undef SP_CAPTURE_TASKS
+#endif
+
+#ifdef SP_CAPTURE_TASKS
+extern u64 capture_steps;
+
+extern void capture_task_begin(unsigned int cycles);
+extern void capture_task_end(void);
+extern void capture_DRAM_read(u32 address, u32 length);
+extern void capture_DRAM_write(u32 address, u32 length);
+NOINLINE extern void capture_close(void);
+#endif
+
 #endif
@@ -0,0 +1,492 @@
+/******************************************************************************\
+* Project:  Headless Replay of Captured RSP Tasks                              *
+* License:  CC0 Public Domain Dedication                                       *
+*                                                                              *
+* To the extent possible under law, the author(s) have dedicated all copyright *
+* and related and neighboring rights to this software to the public domain     *
+* worldwide. This software is distributed without any warranty.                *
+*                                                                              *
+* You should have received a copy of the CC0 Public Domain Dedication along    *
+* with this software.                                                          *
+* If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.             *
+\******************************************************************************/
+
+/*
+ * rsp-replay runs the tasks of a trace (trace.h) through the same scalar and
+ * vector unit the plugin is built from, with a stand-in for the core's side
+ * of RSP_INFO, and prints how fast they ran as one JSON object:
+ *
+ *   $ rsp-replay [-p passes] rsp_tasks.trace
+ *
+ * Every task gets back the registers, DMEM and IMEM it started with, and the
+ * RDRAM it is going to read.  The first pass also checks DMEM, IMEM and the
+ * RDRAM each task wrote against the hashes the capture took.  Only running
+ * the task is timed, as DoRspCycles() would run it after the task was set
+ * up.  The exit status is 0 if every task matched, 1 if any did not, and 2
+ * if the trace could not be used at all.
+ *
+ * The RDP is taken to finish each list at once, the way a graphics plugin
+ * does, so micro-code which looks at how far the real one got might not do
+ * the same thing it did when it was captured.
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "su.h"
+#include "module.h"
+#include "mirror.h"
+#include "trace.h"
+
+#define REPLAY_PASSES   5
+
+typedef struct {
+    const trace_task * task;
+    const trace_span * writes;
+    size_t first_read; /* in replay_reads[] */
+} replay_task;
+
+static const u8 * trace_image;
+static size_t trace_size;
+
+static replay_task * replay_tasks;
+static const trace_span ** replay_reads; /* all of them, task by task */
+static u32 replay_task_count;
+
+static u32 RCP_regs[TRACE_REGISTERS];
+static pu8 RDRAM;
+static ALIGNED u8 SP_cache[0x2000]; /* if DMEM and IMEM cannot be mirrored */
+
+/*
+ * what module.c would have provided to su.c and the vector unit
+ */
+NOINLINE void message(const char* body)
+{
+    fprintf(stderr, "%s\n", body);
+    return;
+}
+void flush_SP_memory(void)
+{
+    return; /* There is no core with its own copy of DMEM and IMEM. */
+}
+#ifdef SP_CAPTURE_TASKS
+u64 capture_steps;
+
+void capture_DRAM_read(u32 address, u32 length)
+{
+    (void)address; /* unused */
+    (void)length;
+    return;
+}
+void capture_DRAM_write(u32 address, u32 length)
+{
+    (void)address; /* unused */
+    (void)length;
+    return;
+}
+#endif
+
+static void replay_RDP(void)
+{
+    RCP_regs[TRACE_DPC_CURRENT] = RCP_regs[TRACE_DPC_END];
+    return;
+}
+static void replay_interrupts(void)
+{
+    return;
+}
+
+static double replay_clock(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER count, frequency;
+
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+    return ((double)count.QuadPart / (double)frequency.QuadPart);
+#else
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((double)now.tv_sec + (double)now.tv_nsec / 1e9);
+#endif
+}
+
+static int map_trace(const char * source)
+{
+#ifdef _WIN32
+    FILE * stream;
+    u8 * image;
+    long size;
+
+    stream = fopen(source, "rb");
+    if (stream == NULL)
+        return 0;
+    fseek(stream, 0, SEEK_END);
+    size = ftell(stream);
+    fseek(stream, 0, SEEK_SET);
+    image = (size > 0) ? malloc((size_t)size) : NULL;
+    if (image == NULL || fread(image, (size_t)size, 1, stream) != 1) {
+        free(image);
+        fclose(stream);
+        return 0;
+    }
+    fclose(stream);
+    trace_image = image;
+    trace_size = (size_t)size;
+    return 1;
+#else
+    struct stat status;
+    void * image;
+    int fd;
+
+    fd = open(source, O_RDONLY);
+    if (fd < 0)
+        return 0;
+    image = MAP_FAILED;
+    if (fstat(fd, &status) == 0 && status.st_size > 0)
+        image = mmap(
+            NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, fd, 0
+        );
+    close(fd);
+    if (image == MAP_FAILED)
+        return 0;
+    trace_image = image;
+    trace_size = (size_t)status.st_size;
+    return 1;
+#endif
+}
+
+/*
+ * Check that every record and span lies within the file before any of them
+ * is used, and find where each task's spans are.
+ */
+static const char * index_trace(void)
+{
+    const trace_header * header = (const trace_header *)trace_image;
+    const trace_task * task;
+    const trace_span * span;
+    size_t offset, end, cursor, reads;
+    register u32 i, j;
+
+    if (trace_size < sizeof(trace_header))
+        return "too short for a trace";
+    if (memcmp(header -> magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0)
+        return "not a trace";
+    if (header -> byte_order != 0x01020304)
+        return "captured on a host of another byte order";
+    if (header -> version != TRACE_VERSION)
+        return "captured with another version of the trace format";
+    if (header -> header_size < sizeof(trace_header))
+        return "damaged header";
+    if (header -> RDRAM_size == 0 || header -> RDRAM_size > 0x01000000ul)
+        return "bad RDRAM size";
+
+    reads = 0;
+    offset = header -> header_size;
+    for (i = 0; i < header -> tasks; i++) {
+        if (offset % 8 != 0 || trace_size - offset < sizeof(trace_task))
+            return "cut short";
+        task = (const trace_task *)(trace_image + offset);
+        if (task -> record_size % 8 != 0
+         || task -> record_size > trace_size - offset)
+            return "cut short";
+        reads += task -> reads;
+        offset += task -> record_size;
+    }
+    replay_task_count = header -> tasks;
+    replay_tasks = calloc(replay_task_count + 1, sizeof(replay_task));
+    replay_reads = calloc(reads + 1, sizeof(const trace_span *));
+    if (replay_tasks == NULL || replay_reads == NULL)
+        return "out of memory";
+
+    reads = 0;
+    offset = header -> header_size;
+    for (i = 0; i < replay_task_count; i++) {
+        task = (const trace_task *)(trace_image + offset);
+        end = offset + task -> record_size;
+        cursor = offset + sizeof(trace_task);
+        replay_tasks[i].task = task;
+        replay_tasks[i].first_read = reads;
+        for (j = 0; j < task -> reads; j++) {
+            if (end - cursor < sizeof(trace_span))
+                return "damaged task record";
+            span = (const trace_span *)(trace_image + cursor);
+            cursor += sizeof(trace_span);
+            if (end - cursor < TRACE_PADDED(span -> length)
+             || span -> address >= header -> RDRAM_size
+             || header -> RDRAM_size - span -> address < span -> length)
+                return "damaged task record";
+            cursor += TRACE_PADDED(span -> length);
+            replay_reads[reads++] = span;
+        }
+        if ((end - cursor) / sizeof(trace_span) != task -> writes
+         || (end - cursor) % sizeof(trace_span) != 0)
+            return "damaged task record";
+        replay_tasks[i].writes = (const trace_span *)(trace_image + cursor);
+        for (j = 0; j < task -> writes; j++)
+            if (replay_tasks[i].writes[j].address >= header -> RDRAM_size
+             || header -> RDRAM_size - replay_tasks[i].writes[j].address
+              < replay_tasks[i].writes[j].length)
+                return "damaged task record";
+        offset = end;
+    }
+    return NULL;
+}
+
+#ifdef RSP_REENTRANT
+static int open_context(void)
+{
+    pu8 allocation;
+
+    allocation = calloc(1, sizeof(rsp_context) + 64);
+    if (allocation == NULL)
+        return 0;
+    RSP_current = (rsp_context *)(allocation + 64 - (size_t)allocation % 64);
+    RSP_current -> allocation = allocation;
+    return 1;
+}
+#endif
+
+/*
+ * the same set-up as InitiateRSP(), with this file standing in for the core
+ */
+static int init_replay(u32 RDRAM_size)
+{
+    register unsigned int i;
+
+#ifdef RSP_REENTRANT
+    if (open_context() == 0)
+        return 0;
+#endif
+    RDRAM = calloc(RDRAM_size, 1);
+    if (RDRAM == NULL)
+        return 0;
+    select_vector_ISA();
+
+    GET_RSP_INFO(RDRAM) = RDRAM;
+    RSP_INFO_NAME.MI_INTR_REG       = &RCP_regs[TRACE_MI_INTR];
+    RSP_INFO_NAME.SP_MEM_ADDR_REG   = &RCP_regs[TRACE_SP_MEM_ADDR];
+    RSP_INFO_NAME.SP_DRAM_ADDR_REG  = &RCP_regs[TRACE_SP_DRAM_ADDR];
+    RSP_INFO_NAME.SP_RD_LEN_REG     = &RCP_regs[TRACE_SP_RD_LEN];
+    RSP_INFO_NAME.SP_WR_LEN_REG     = &RCP_regs[TRACE_SP_WR_LEN];
+    RSP_INFO_NAME.SP_STATUS_REG     = &RCP_regs[TRACE_SP_STATUS];
+    RSP_INFO_NAME.SP_DMA_FULL_REG   = &RCP_regs[TRACE_SP_DMA_FULL];
+    RSP_INFO_NAME.SP_DMA_BUSY_REG   = &RCP_regs[TRACE_SP_DMA_BUSY];
+    RSP_INFO_NAME.SP_PC_REG         = &RCP_regs[TRACE_SP_PC];
+    RSP_INFO_NAME.SP_SEMAPHORE_REG  = &RCP_regs[TRACE_SP_SEMAPHORE];
+    RSP_INFO_NAME.DPC_START_REG     = &RCP_regs[TRACE_DPC_START];
+    RSP_INFO_NAME.DPC_END_REG       = &RCP_regs[TRACE_DPC_END];
+    RSP_INFO_NAME.DPC_CURRENT_REG   = &RCP_regs[TRACE_DPC_CURRENT];
+    RSP_INFO_NAME.DPC_STATUS_REG    = &RCP_regs[TRACE_DPC_STATUS];
+    RSP_INFO_NAME.DPC_CLOCK_REG     = &RCP_regs[TRACE_DPC_CLOCK];
+    RSP_INFO_NAME.DPC_BUFBUSY_REG   = &RCP_regs[TRACE_DPC_BUFBUSY];
+    RSP_INFO_NAME.DPC_PIPEBUSY_REG  = &RCP_regs[TRACE_DPC_PIPEBUSY];
+    RSP_INFO_NAME.DPC_TMEM_REG      = &RCP_regs[TRACE_DPC_TMEM];
+    GET_RSP_INFO(CheckInterrupts) = replay_interrupts;
+    GET_RSP_INFO(ProcessRdpList) = replay_RDP;
+
+    for (i = 0; i < 7; i++)
+        CR[0x0 + i] = &RCP_regs[TRACE_SP_MEM_ADDR + i];
+    CR[0x7] = &RCP_regs[TRACE_SP_SEMAPHORE];
+    for (i = 0; i < 8; i++)
+        CR[0x8 + i] = &RCP_regs[TRACE_DPC_START + i];
+
+    DRAM = RDRAM;
+    su_max_address = RDRAM_size - 1;
+    SP_memory = map_SP_memory();
+    if (SP_memory == NULL) {
+        DMEM = SP_cache + 0x0000;
+        IMEM = SP_cache + 0x1000;
+        DMEM_window_end = 0x00000FF0;
+    } else {
+        DMEM = SP_memory + 0x0000;
+        IMEM = SP_memory + 0x2000;
+        DMEM_window_end = 0x00000FFF;
+    }
+    GBI_phase = replay_RDP;
+    return 1;
+}
+
+static void restore_task(const replay_task * entry)
+{
+    const trace_task * task = entry -> task;
+    const trace_span * span;
+    register u32 i;
+
+    memcpy(RCP_regs, task -> regs, sizeof(RCP_regs));
+    memcpy(SR, task -> scalars, sizeof(task -> scalars));
+    for (i = 0; i < 32; i++)
+        memcpy(VR[i], task -> vectors[i], sizeof(task -> vectors[i]));
+    for (i = 0; i < N; i++) {
+#ifdef VU_WIDE_ACCUMULATOR
+        VACC_W[i] = (i32)((u32)(u16)task -> acc[0][i] << 16
+          | (u32)(u16)task -> acc[1][i]);
+#else
+        VACC_H[i] = task -> acc[0][i];
+        VACC_M[i] = task -> acc[1][i];
+#endif
+        VACC_L[i] = task -> acc[2][i];
+    }
+    VCO = task -> vco;
+    VCC = task -> vcc;
+    VCE = task -> vce;
+    DivIn = task -> div_in;
+    DivOut = task -> div_out;
+    DPH = task -> div_high;
+    MF_SP_STATUS_TIMEOUT = task -> status_timeout;
+    memcpy(MFC0_count, task -> status_reads, sizeof(task -> status_reads));
+    memcpy(IMEM, task -> imem, 4096);
+    memcpy(DMEM, task -> dmem, 4096);
+    RDP_queued = 0;
+
+/*
+ * Backwards, so that where the task read the same RDRAM more than once, what
+ * it read first is what is there when it starts.  Whatever it read later is
+ * then what the task itself wrote there in between.
+ */
+    for (i = task -> reads; i != 0; i--) {
+        span = replay_reads[entry -> first_read + i - 1];
+        memcpy(RDRAM + span -> address, span + 1, span -> length);
+    }
+    return;
+}
+
+static u64 hash_RDRAM(const replay_task * entry)
+{
+    const trace_span * spans = entry -> writes;
+    u64 hash;
+    register u32 i;
+
+    hash = TRACE_HASH_SEED;
+    for (i = 0; i < entry -> task -> writes; i++) {
+        hash = trace_hash(hash, &spans[i], sizeof(trace_span));
+        hash = trace_hash(hash, RDRAM + spans[i].address, spans[i].length);
+    }
+    return (hash);
+}
+
+static void print_string(const char * text)
+{
+    putchar('"');
+    for (; *text != '\0'; text++)
+        if (*text == '"' || *text == '\\')
+            printf("\\%c", *text);
+        else if ((unsigned char)*text < 0x20)
+            printf("\\u%04x", (unsigned char)*text);
+        else
+            putchar(*text);
+    putchar('"');
+    return;
+}
+
+int main(int argc, char ** argv)
+{
+    const char * source;
+    const char * failure;
+    u64 instructions;
+    double seconds, start;
+    long passes;
+    u32 DMEM_mismatches, IMEM_mismatches, RDRAM_mismatches;
+    u32 mismatched_tasks;
+    long first_mismatch;
+    int mismatched;
+    register long pass;
+    register u32 i;
+
+    source = NULL;
+    passes = REPLAY_PASSES;
+    for (i = 1; i < (u32)argc; i++)
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < (u32)argc)
+            passes = strtol(argv[++i], NULL, 0);
+        else if (source == NULL)
+            source = argv[i];
+        else
+            source = "";
+    if (source == NULL || *source == '\0' || passes < 1) {
+        fprintf(stderr, "usage:  %s [-p passes] trace\n", argv[0]);
+        return 2;
+    }
+
+    if (map_trace(source) == 0) {
+        fprintf(stderr, "%s:  cannot be read\n", source);
+        return 2;
+    }
+    failure = index_trace();
+    if (failure == NULL)
+        if (!init_replay(((const trace_header *)trace_image) -> RDRAM_size))
+            failure = "out of memory";
+    if (failure != NULL) {
+        fprintf(stderr, "%s:  %s\n", source, failure);
+        return 2;
+    }
+
+    instructions = 0;
+    for (i = 0; i < replay_task_count; i++)
+        instructions += replay_tasks[i].task -> steps;
+    DMEM_mismatches = IMEM_mismatches = RDRAM_mismatches = 0;
+    mismatched_tasks = 0;
+    first_mismatch = -1;
+    seconds = 0;
+    for (pass = 0; pass < passes; pass++)
+        for (i = 0; i < replay_task_count; i++) {
+            const trace_task * task = replay_tasks[i].task;
+
+            restore_task(&replay_tasks[i]);
+            start = replay_clock();
+            decode_IMEM();
+            run_task();
+            flush_RDP_queue();
+            seconds += replay_clock() - start;
+            if (pass != 0)
+                continue;
+
+            mismatched = 0;
+            if (trace_hash(TRACE_HASH_SEED, DMEM, 4096) != task -> DMEM_hash)
+                mismatched = ++DMEM_mismatches;
+            if (trace_hash(TRACE_HASH_SEED, IMEM, 4096) != task -> IMEM_hash)
+                mismatched = ++IMEM_mismatches;
+            if (hash_RDRAM(&replay_tasks[i]) != task -> RDRAM_hash)
+                mismatched = ++RDRAM_mismatches;
+            if (mismatched == 0)
+                continue;
+            if (first_mismatch < 0)
+                first_mismatch = (long)i;
+            ++mismatched_tasks;
+        }
+
+    printf("{\n");
+    printf("  \"trace\": ");
+    print_string(source);
+    printf(",\n");
+    printf("  \"version\": %u,\n", TRACE_VERSION);
+    printf("  \"tasks\": %lu,\n", (unsigned long)replay_task_count);
+    printf("  \"passes\": %ld,\n", passes);
+    printf("  \"instructions\": %.0f,\n", (double)instructions);
+    printf("  \"seconds\": %.9f,\n", seconds);
+    printf("  \"tasks_per_second\": %.1f,\n", (seconds > 0)
+      ? (double)replay_task_count * (double)passes / seconds : 0.0);
+    printf("  \"ns_per_instruction\": %.3f,\n", (instructions != 0)
+      ? seconds * 1e9 / ((double)instructions * (double)passes) : 0.0);
+    printf("  \"DMEM_mismatches\": %lu,\n", (unsigned long)DMEM_mismatches);
+    printf("  \"IMEM_mismatches\": %lu,\n", (unsigned long)IMEM_mismatches);
+    printf("  \"RDRAM_mismatches\": %lu,\n", (unsigned long)RDRAM_mismatches);
+    printf("  \"mismatched_tasks\": %lu,\n", (unsigned long)mismatched_tasks);
+    printf("  \"first_mismatch\": %ld\n", first_mismatch);
+    printf("}\n");
+
+    unmap_SP_memory(SP_memory);
+    return (mismatched_tasks != 0) ? 1 : 0;
+}
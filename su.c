@@ -14,6 +14,8 @@
 \******************************************************************************/
 
 #include "su.h"
+#include "icache.h"
+#include "jit.h"
 
 /*
  * including modular interface structure to access configuration settings...
@@ -24,17 +26,16 @@
 /* memcpy() and memset() in SP DMA */
 #include <string.h>
 
-u32 inst_word;
+/* qsort() for the SU_PROFILE_IDIOMS report */
+#include <stdlib.h>
 
-u32 SR[NUMBER_OF_SCALAR_REGISTERS];
-typedef VECTOR_OPERATION(*p_vector_func)(v16, v16);
-
-pu8 DRAM;
-pu8 DMEM;
-pu8 IMEM;
-unsigned long su_max_address = 0x007FFFFFul;
+#ifdef RSP_REENTRANT
+THREAD_LOCAL rsp_context * RSP_current;
+#else
+rsp_context RSP_state;
+#endif
 
-static int temp_PC;
+typedef VECTOR_OPERATION(*p_vector_func)(v16, v16);
 
 NOINLINE void res_S(void)
 {
@@ -51,14 +52,12 @@ void set_PC(unsigned int address)
     return;
 }
 
-pu32 CR[NUMBER_OF_CP0_REGISTERS];
-u8 conf[32];
-
-int MF_SP_STATUS_TIMEOUT;
-
 void SP_CP0_MF(unsigned int rt, unsigned int rd)
 {
-    SR[rt] = *(CR[rd %= NUMBER_OF_CP0_REGISTERS]);
+    rd %= NUMBER_OF_CP0_REGISTERS;
+    if (rd >= 0x8)
+        flush_RDP_queue(); /* The RDP has to catch up with what it was told. */
+    SR[rt] = *(CR[rd]);
     SR[zero] = 0x00000000;
     if (rd == 0x7) {
         if (CFG_MEND_SEMAPHORE_LOCK == 0)
@@ -148,12 +147,39 @@ static void MT_SP_RESERVED(unsigned int rt)
     GET_RCP_REG(SP_SEMAPHORE_REG) = source;
     return;
 }
+
+/*
+ * Lists for the RDP are not handed to the graphics plugin every time the
+ * micro-code moves DPC_END.  As long as DPC_END only moves forward, they
+ * make up one list, from DPC_CURRENT up to the latest DPC_END, which one
+ * call to ProcessRdpList() takes the next time the RSP reads or writes any
+ * other DPC register or stops, or once RDP_QUEUE_LIMIT bytes are waiting.
+ *
+ * Micro-code has to read DPC_CURRENT or DPC_STATUS before it writes over
+ * any commands it gave the RDP anyway, since the real RDP runs alongside.
+ * The plugin specs have ProcessRdpList() read the DPC registers itself, so
+ * only such a single list can be held back, not a queue of separate ones.
+ */
+#define RDP_QUEUE_LIMIT     0x00001000ul
+
+void flush_RDP_queue(void)
+{
+    if (RDP_queued == 0)
+        return;
+    RDP_queued = 0;
+    if (GET_RCP_REG(DPC_STATUS_REG) & 0x00000001) /* XBUS_DMEM_DMA */
+        flush_SP_memory(); /* The RDP reads its commands out of DMEM. */
+    GBI_phase();
+    return;
+}
+
 static void MT_CMD_START(unsigned int rt)
 {
     const u32 source = SR[rt] & 0xFFFFFFF8ul; /* Funnelcube demo by marshallh */
 
     if (GET_RCP_REG(DPC_BUFBUSY_REG)) /* lock hazards not implemented */
         message("MTC0\nCMD_START");
+    flush_RDP_queue();
     GET_RCP_REG(DPC_END_REG)
   = GET_RCP_REG(DPC_CURRENT_REG)
   = GET_RCP_REG(DPC_START_REG)
@@ -162,10 +188,16 @@ static void MT_CMD_START(unsigned int rt)
 }
 static void MT_CMD_END(unsigned int rt)
 {
+    const u32 source = SR[rt] & 0xFFFFFFF8ul;
+
     if (GET_RCP_REG(DPC_BUFBUSY_REG))
         message("MTC0\nCMD_END"); /* This is just CA-related. */
-    GET_RCP_REG(DPC_END_REG) = SR[rt] & 0xFFFFFFF8ul;
-    GBI_phase();
+    if (source < GET_RCP_REG(DPC_END_REG))
+        flush_RDP_queue(); /* The new list does not go on from the old one. */
+    GET_RCP_REG(DPC_END_REG) = source;
+    RDP_queued = 1;
+    if (source - GET_RCP_REG(DPC_CURRENT_REG) >= RDP_QUEUE_LIMIT)
+        flush_RDP_queue();
     return;
 }
 static void MT_CMD_STATUS(unsigned int rt)
@@ -174,6 +206,7 @@ static void MT_CMD_STATUS(unsigned int rt)
 
     if (SR[rt] & 0xFFFFFD80ul) /* unsupported or reserved bits */
         message("MTC0\nCMD_STATUS");
+    flush_RDP_queue();
     DPC_STATUS_REG = GET_RSP_INFO(DPC_STATUS_REG);
 
     *DPC_STATUS_REG &= ~(!!(SR[rt] & 0x00000001) << 0);
@@ -192,6 +225,7 @@ static void MT_CMD_STATUS(unsigned int rt)
 static void MT_CMD_CLOCK(unsigned int rt)
 {
     message("MTC0\nCMD_CLOCK"); /* read-only?? */
+    flush_RDP_queue();
     GET_RCP_REG(DPC_CLOCK_REG) = SR[rt];
     return; /* Appendix says this is RW; elsewhere it says R. */
 }
@@ -205,16 +239,77 @@ static void MT_READ_ONLY(unsigned int rt)
     return;
 }
 
-static void (*SP_CP0_MT[NUMBER_OF_CP0_REGISTERS])(unsigned int) = {
+void (*SP_CP0_MT[NUMBER_OF_CP0_REGISTERS])(unsigned int) = {
 MT_DMA_CACHE       ,MT_DMA_DRAM        ,MT_DMA_READ_LENGTH ,MT_DMA_WRITE_LENGTH,
 MT_SP_STATUS       ,MT_READ_ONLY       ,MT_READ_ONLY       ,MT_SP_RESERVED,
 MT_CMD_START       ,MT_CMD_END         ,MT_READ_ONLY       ,MT_CMD_STATUS,
 MT_CMD_CLOCK       ,MT_READ_ONLY       ,MT_READ_ONLY       ,MT_READ_ONLY
 };
 
+/*
+ * SP DMA moves `count` rows of `length` bytes (in whole 8-byte chunks), and
+ * the rows are `skip` bytes apart in RDRAM.  Each row is copied in as few
+ * contiguous spans as it can be:  it only has to be broken up where it runs
+ * over the end of DMEM or IMEM, over the end of the RDRAM there is, or over
+ * the end of the 16-MiB RDRAM address space, which is at most three times.
+ *
+ * Whatever lies past the end of the RDRAM reads as zeroes and ignores any
+ * writes.
+ */
+static INLINE u32 DMA_span(u32 offC, u32 offD, u32 left)
+{
+    u32 span;
+
+    span = left;
+    if (span > 0x00001000ul - offC)
+        span = 0x00001000ul - offC;
+    if (offD > su_max_address) {
+        if (span > 0x01000000ul - offD)
+            span = 0x01000000ul - offD;
+    } else {
+        if (span > su_max_address + 1 - offD)
+            span = (u32)(su_max_address + 1 - offD);
+    }
+    return (span);
+}
+
+/*
+ * Writing big blocks back to RDRAM (frame buffers, audio buffers) with
+ * non-temporal stores keeps them from evicting the rest of the RSP state
+ * out of the host's cache, at the cost of whoever reads them back next.
+ */
+#if defined(SP_DMA_STREAM) && defined(ARCH_MIN_SSE2)
+#define DMA_STREAM_MIN  0x400
+#endif
+
+static void DMA_to_DRAM(pu8 dst, const u8 * src, u32 span)
+{
+#ifdef DMA_STREAM_MIN
+    u32 head;
+
+    if (span >= DMA_STREAM_MIN) {
+        head = (u32)(-(size_t)dst & 0xF);
+        memcpy(dst, src, head);
+        dst += head;
+        src += head;
+        span -= head;
+        while (span >= 16) {
+            _mm_stream_si128((v16 *)dst, _mm_loadu_si128((const v16 *)src));
+            dst += 16;
+            src += 16;
+            span -= 16;
+        }
+    }
+#endif
+    memcpy(dst, src, span);
+    return;
+}
+
 void SP_DMA_READ(void)
 {
-    unsigned int offC, offD; /* SP cache and dynamic DMA pointers */
+    u32 offC, offD; /* SP cache and dynamic DMA pointers */
+    u32 left, span;
+    pu8 SP_mem; /* DMEM and IMEM need not be next to each other. */
     register unsigned int length;
     register unsigned int count;
     register unsigned int skip;
@@ -228,31 +323,38 @@ void SP_DMA_READ(void)
     ++length;
     ++count;
     skip += length;
+    SP_mem = (*CR[0x0] & 0x00001000ul) ? IMEM : DMEM;
     do {
-        register unsigned int i;
-
-        i = 0;
         --count;
-        do {
-            offC = ((count*length + *CR[0x0] + i) & 0x00000FF8ul)
-                 | (*CR[0x0] & 0x00001000ul);
-            offD = (count*skip + *CR[0x1] + i) & 0x00FFFFF8ul;
-            i += 0x008;
+        offC = (count*length + *CR[0x0]) & 0x00000FF8ul;
+        offD = (count*skip + *CR[0x1]) & 0x00FFFFF8ul;
+        for (left = (length + 7) & ~7u; left != 0; left -= span) {
+            span = DMA_span(offC, offD, left);
             if (offD > su_max_address) {
-                memset(DMEM + offC, 0x00, 8);
-                continue;
+                memset(SP_mem + offC, 0x00, span);
+            } else {
+                memcpy(SP_mem + offC, DRAM + offD, span);
+#ifdef SP_CAPTURE_TASKS
+                capture_DRAM_read(offD, span);
+#endif
             }
-            memcpy(DMEM + offC, DRAM + offD, 8);
-        } while (i < length);
+            offC = (offC + span) & 0x00000FFFul;
+            offD = (offD + span) & 0x00FFFFFFul;
+        }
     } while (count);
 
+    if (*CR[0x0] & 0x00001000ul)
+        decode_IMEM(); /* Only re-decode the words the overlay changed. */
+
     GET_RCP_REG(SP_DMA_BUSY_REG)  =  0x00000000;
     GET_RCP_REG(SP_STATUS_REG)   &= ~SP_STATUS_DMA_BUSY;
     return;
 }
 void SP_DMA_WRITE(void)
 {
-    unsigned int offC, offD; /* SP cache and dynamic DMA pointers */
+    u32 offC, offD; /* SP cache and dynamic DMA pointers */
+    u32 left, span;
+    pu8 SP_mem; /* DMEM and IMEM need not be next to each other. */
     register unsigned int length;
     register unsigned int count;
     register unsigned int skip;
@@ -267,21 +369,26 @@ void SP_DMA_WRITE(void)
     ++length;
     ++count;
     skip += length;
+    SP_mem = (*CR[0x0] & 0x00001000ul) ? IMEM : DMEM;
     do {
-        register unsigned int i;
-
-        i = 0;
         --count;
-        do {
-            offC = ((count*length + *CR[0x0] + i) & 0x00000FF8ul)
-                 | (*CR[0x0] & 0x00001000ul);
-            offD = (count*skip + *CR[0x1] + i) & 0x00FFFFF8ul;
-            i += 0x000008;
-            if (offD > su_max_address)
-                continue;
-            memcpy(DRAM + offD, DMEM + offC, 8);
-        } while (i < length);
+        offC = (count*length + *CR[0x0]) & 0x00000FF8ul;
+        offD = (count*skip + *CR[0x1]) & 0x00FFFFF8ul;
+        for (left = (length + 7) & ~7u; left != 0; left -= span) {
+            span = DMA_span(offC, offD, left);
+            if (offD <= su_max_address) {
+                DMA_to_DRAM(DRAM + offD, SP_mem + offC, span);
+#ifdef SP_CAPTURE_TASKS
+                capture_DRAM_write(offD, span);
+#endif
+            }
+            offC = (offC + span) & 0x00000FFFul;
+            offD = (offD + span) & 0x00FFFFFFul;
+        }
     } while (count);
+#ifdef DMA_STREAM_MIN
+    _mm_sfence(); /* Let the streamed stores land before the CPU looks. */
+#endif
 
     GET_RCP_REG(SP_DMA_BUSY_REG)  =  0x00000000;
     GET_RCP_REG(SP_STATUS_REG)   &= ~SP_STATUS_DMA_BUSY;
@@ -290,143 +397,118 @@ void SP_DMA_WRITE(void)
 
 /*** scalar, R4000 control flow manipulation ***/
 
-PROFILE_MODE void J(u32 inst)
+PROFILE_MODE void J(u32 target)
 {
-    set_PC(4 * inst);
+    set_PC(target);
 }
-PROFILE_MODE void JAL(u32 inst, u32 PC)
+PROFILE_MODE void JAL(u32 target, u32 PC)
 {
     SR[ra] = FIT_IMEM(PC + LINK_OFF);
-    set_PC(4 * inst);
+    set_PC(target);
 }
 
-PROFILE_MODE int BEQ(u32 inst, u32 PC)
+/*
+ * The branch `offset` is predecoded as (4*immediate + SLOT_OFF), so it only
+ * needs to be added to the PC at the time the branch is actually executed.
+ */
+PROFILE_MODE int BEQ(unsigned int rs, unsigned int rt, u32 offset, u32 PC)
 {
-    const unsigned int rs = (inst >> 21) % (1 << 5);
-    const unsigned int rt = (inst >> 16) % (1 << 5);
-
     if (!(SR[rs] == SR[rt]))
         return 0;
-    set_PC(PC + 4*inst + SLOT_OFF);
+    set_PC(PC + offset);
     return 1;
 }
-PROFILE_MODE int BNE(u32 inst, u32 PC)
+PROFILE_MODE int BNE(unsigned int rs, unsigned int rt, u32 offset, u32 PC)
 {
-    const unsigned int rs = (inst >> 21) % (1 << 5);
-    const unsigned int rt = (inst >> 16) % (1 << 5);
-
     if (!(SR[rs] != SR[rt]))
         return 0;
-    set_PC(PC + 4*inst + SLOT_OFF);
+    set_PC(PC + offset);
     return 1;
 }
-PROFILE_MODE int BLEZ(u32 inst, u32 PC)
+PROFILE_MODE int BLEZ(unsigned int rs, u32 offset, u32 PC)
 {
-    const unsigned int rs = (inst >> 21) % (1 << 5);
-
     if (!((s32)SR[rs] <= 0))
         return 0;
-    set_PC(PC + 4*inst + SLOT_OFF);
+    set_PC(PC + offset);
     return 1;
 }
-PROFILE_MODE int BGTZ(u32 inst, u32 PC)
+PROFILE_MODE int BGTZ(unsigned int rs, u32 offset, u32 PC)
 {
-    const unsigned int rs = (inst >> 21) % (1 << 5);
-
     if (!((s32)SR[rs] >  0))
         return 0;
-    set_PC(PC + 4*inst + SLOT_OFF);
+    set_PC(PC + offset);
+    return 1;
+}
+PROFILE_MODE int BLTZ(unsigned int rs, u32 offset, u32 PC)
+{
+    if (!((s32)SR[rs] <  0))
+        return 0;
+    set_PC(PC + offset);
+    return 1;
+}
+PROFILE_MODE int BGEZ(unsigned int rs, u32 offset, u32 PC)
+{
+    if (!((s32)SR[rs] >= 0))
+        return 0;
+    set_PC(PC + offset);
     return 1;
 }
 
 /*** scalar, R4000 bit-wise logical operations ***/
 
-PROFILE_MODE void ANDI(u32 inst)
+PROFILE_MODE void ANDI(unsigned int rt, unsigned int rs, u32 immediate)
 {
-    const u16 immediate = (u16)(inst & 0x0000FFFFu);
-    const unsigned int rs = (inst >> 21) % (1 << 5);
-    const unsigned int rt = (inst >> 16) % (1 << 5);
-
     SR[rt] = SR[rs] & immediate;
     SR[zero] = 0x00000000;
 }
-PROFILE_MODE void ORI(u32 inst)
+PROFILE_MODE void ORI(unsigned int rt, unsigned int rs, u32 immediate)
 {
-    const u16 immediate = (u16)(inst & 0x0000FFFFu);
-    const unsigned int rs = (inst >> 21) % (1 << 5);
-    const unsigned int rt = (inst >> 16) % (1 << 5);
-
     SR[rt] = SR[rs] | immediate;
     SR[zero] = 0x00000000;
 }
-PROFILE_MODE void XORI(u32 inst)
+PROFILE_MODE void XORI(unsigned int rt, unsigned int rs, u32 immediate)
 {
-    const u16 immediate = (u16)(inst & 0x0000FFFFu);
-    const unsigned int rs = (inst >> 21) % (1 << 5);
-    const unsigned int rt = (inst >> 16) % (1 << 5);
-
     SR[rt] = SR[rs] ^ immediate;
     SR[zero] = 0x00000000;
 }
-PROFILE_MODE void LUI(u32 inst)
+PROFILE_MODE void LUI(unsigned int rt, u32 immediate)
 {
-    const u16 immediate = (u16)(inst & 0x0000FFFFu);
-    const unsigned int rt = (inst >> 16) % (1 << 5);
-
-    SR[rt] = (u32)immediate << 16; /* or:  SR[rt] = 0; SR[rt]31..16 = imm; */
+    SR[rt] = immediate; /* already shifted:  SR[rt]31..16 = imm */
     SR[zero] = 0x00000000;
 }
 
 /*** scalar, R4000 arithmetic operations ***/
 
-PROFILE_MODE void ADDIU(u32 inst)
+PROFILE_MODE void ADDIU(unsigned int rt, unsigned int rs, s32 immediate)
 {
-    const u16 immediate = (u16)(inst & 0x0000FFFFu);
-    const unsigned int rs = (inst >> 21) % (1 << 5);
-    const unsigned int rt = (inst >> 16) % (1 << 5);
-
-    SR[rt] = SR[rs] + (s16)(immediate);
+    SR[rt] = SR[rs] + immediate;
     SR[zero] = 0x00000000;
 }
-PROFILE_MODE void SLTI(u32 inst)
+PROFILE_MODE void SLTI(unsigned int rt, unsigned int rs, s32 immediate)
 {
-    const u16 immediate = (u16)(inst & 0x0000FFFFu);
-    const unsigned int rs = (inst >> 21) % (1 << 5);
-    const unsigned int rt = (inst >> 16) % (1 << 5);
-
-    SR[rt] = ((s32)(SR[rs]) < (s32)SIGNED_IMM16(immediate)) ? 1 : 0;
+    SR[rt] = ((s32)(SR[rs]) < immediate) ? 1 : 0;
     SR[zero] = 0x00000000;
 }
-PROFILE_MODE void SLTIU(u32 inst)
+PROFILE_MODE void SLTIU(unsigned int rt, unsigned int rs, s32 immediate)
 {
-    const u16 immediate = (u16)(inst & 0x0000FFFFu);
-    const unsigned int rs = (inst >> 21) % (1 << 5);
-    const unsigned int rt = (inst >> 16) % (1 << 5);
-
-    SR[rt] = ((u32)(SR[rs]) < (u32)SIGNED_IMM16(immediate)) ? 1 : 0;
+    SR[rt] = ((u32)(SR[rs]) < (u32)immediate) ? 1 : 0;
     SR[zero] = 0x00000000;
 }
 
 /*** scalar, R4000 memory loads and stores ***/
 
-PROFILE_MODE void LB(u32 inst)
+PROFILE_MODE void LB(unsigned int rt, unsigned int base, s32 offset)
 {
     u32 addr;
-    const s16 offset = (s16)(inst & 0x0000FFFFul);
-    const unsigned int base = (inst >> 21) % (1 << 5);
-    const unsigned int rt   = (inst >> 16) % (1 << 5);
 
     addr = SR[base] + offset;
     SR[rt] = DMEM[BES(addr) & 0x00000FFFul];
     SR[rt] = (s8)SR[rt];
     SR[zero] = 0x00000000;
 }
-PROFILE_MODE void LH(u32 inst)
+PROFILE_MODE void LH(unsigned int rt, unsigned int base, s32 offset)
 {
     u32 addr;
-    const s16 offset = (s16)(inst & 0x0000FFFFul);
-    const unsigned int base = (inst >> 21) % (1 << 5);
-    const unsigned int rt   = (inst >> 16) % (1 << 5);
 
     addr = SR[base] + offset;
     SR[rt] = 0x00000000
@@ -436,12 +518,9 @@ PROFILE_MODE void LH(u32 inst)
     SR[rt] = (s16)SR[rt];
     SR[zero] = 0x00000000;
 }
-PROFILE_MODE void LW(u32 inst)
+PROFILE_MODE void LW(unsigned int rt, unsigned int base, s32 offset)
 {
     u32 addr;
-    const s16 offset = (s16)(inst & 0x0000FFFFul);
-    const unsigned int base = (inst >> 21) % (1 << 5);
-    const unsigned int rt   = (inst >> 16) % (1 << 5);
 
     addr = SR[base] + offset;
     SR_B(rt, 0) = DMEM[BES(addr + 0) & 0x00000FFFul];
@@ -450,23 +529,17 @@ PROFILE_MODE void LW(u32 inst)
     SR_B(rt, 3) = DMEM[BES(addr + 3) & 0x00000FFFul];
     SR[zero] = 0x00000000;
 }
-PROFILE_MODE void LBU(u32 inst)
+PROFILE_MODE void LBU(unsigned int rt, unsigned int base, s32 offset)
 {
     u32 addr;
-    const s16 offset = (s16)(inst & 0x0000FFFFul);
-    const unsigned int base = (inst >> 21) % (1 << 5);
-    const unsigned int rt   = (inst >> 16) % (1 << 5);
 
     addr = SR[base] + offset;
     SR[rt] = DMEM[BES(addr) & 0x00000FFFul];
     SR[zero] = 0x00000000;
 }
-PROFILE_MODE void LHU(u32 inst)
+PROFILE_MODE void LHU(unsigned int rt, unsigned int base, s32 offset)
 {
     u32 addr;
-    const s16 offset = (s16)(inst & 0x0000FFFFul);
-    const unsigned int base = (inst >> 21) % (1 << 5);
-    const unsigned int rt   = (inst >> 16) % (1 << 5);
 
     addr = SR[base] + offset;
     SR[rt] = 0x00000000
@@ -476,33 +549,28 @@ PROFILE_MODE void LHU(u32 inst)
     SR[zero] = 0x00000000;
 }
 
-PROFILE_MODE void SB(u32 inst)
+/*
+ * Scalar stores are always masked to the 4-KiB DMEM, so they can never
+ * write over any IMEM words the predecoded instruction slots were made from.
+ */
+PROFILE_MODE void SB(unsigned int rt, unsigned int base, s32 offset)
 {
     u32 addr;
-    const s16 offset = (s16)(inst & 0x0000FFFFul);
-    const unsigned int base = (inst >> 21) % (1 << 5);
-    const unsigned int rt   = (inst >> 16) % (1 << 5);
 
     addr = SR[base] + offset;
     DMEM[BES(addr) & 0x00000FFFul] = (u8)(SR[rt] & 0xFFu);
 }
-PROFILE_MODE void SH(u32 inst)
+PROFILE_MODE void SH(unsigned int rt, unsigned int base, s32 offset)
 {
     u32 addr;
-    const s16 offset = (s16)(inst & 0x0000FFFFul);
-    const unsigned int base = (inst >> 21) % (1 << 5);
-    const unsigned int rt   = (inst >> 16) % (1 << 5);
 
     addr = SR[base] + offset;
     DMEM[BES(addr + 0) & 0x00000FFFul] = SR_B(rt, 2);
     DMEM[BES(addr + 1) & 0x00000FFFul] = SR_B(rt, 3);
 }
-PROFILE_MODE void SW(u32 inst)
+PROFILE_MODE void SW(unsigned int rt, unsigned int base, s32 offset)
 {
     u32 addr;
-    const s16 offset = (s16)(inst & 0x0000FFFFul);
-    const unsigned int base = (inst >> 21) % (1 << 5);
-    const unsigned int rt   = (inst >> 16) % (1 << 5);
 
     addr = SR[base] + offset;
     DMEM[BES(addr + 0) & 0x00000FFFul] = SR_B(rt, 0);
@@ -511,6 +579,20 @@ PROFILE_MODE void SW(u32 inst)
     DMEM[BES(addr + 3) & 0x00000FFFul] = SR_B(rt, 3);
 }
 
+void (*const scalar_memory_ops[SU_SW - SU_LB + 1])(unsigned, unsigned, s32) = {
+    LB     ,LH     ,LW     ,LBU    ,LHU    ,SB     ,SH     ,SW     ,
+};
+
+void BREAK(void)
+{
+    *CR[0x4] |= SP_STATUS_BROKE | SP_STATUS_HALT;
+    if (*CR[0x4] & SP_STATUS_INTR_BREAK) {
+        GET_RCP_REG(MI_INTR_REG) |= 0x00000001;
+        GET_RSP_INFO(CheckInterrupts)();
+    }
+    return;
+}
+
 /*** scalar, coprocessor operations (vector unit) ***/
 
 u16 rwR_VCE(void)
@@ -522,11 +604,7 @@ u16 rwR_VCE(void)
 }
 void rwW_VCE(u16 vce)
 { /* never saw a game try to write VCE using a scalar GPR yet */
-    register int i;
-
-    vce = 0x00 | (vce & 0xFF);
-    for (i = 0; i < 8; i++)
-        cf_vce[i] = (vce >> i) & 1;
+    set_VCE((u8)(vce & 0xFF));
     return;
 }
 
@@ -799,7 +877,7 @@ void SDV(unsigned vt, unsigned element, signed offset, unsigned base)
         addr += 0x005 + BES(0x000);
         addr &= 0x00000FFF;
         DMEM[addr] = VR_U(vt, e+0x5);
-        *(pi16)(DMEM + addr + 0x001 - BES(0x000)) = VR_S(vt, 0x6);
+        *(pi16)(DMEM + addr + 0x001 - BES(0x000)) = VR_S(vt, e+0x6);
         break;
     case 04:
         *(pi16)(DMEM + addr + HES(0x000)) = VR_S(vt, e+0x0);
@@ -1644,10 +1722,6 @@ void STV(unsigned vt, unsigned element, signed offset, unsigned base)
     return;
 }
 
-#ifdef WAIT_FOR_CPU_HOST
-short MFC0_count[NUMBER_OF_SCALAR_REGISTERS];
-#endif
-
 mwc2_func LWC2[2 * 8*2] = {
     LBV    ,LSV    ,LLV    ,LDV    ,LQV    ,LRV    ,LPV    ,LUV    ,
     LHV    ,LFV    ,res_lsw,LTV    ,res_lsw,res_lsw,res_lsw,res_lsw,
@@ -1661,271 +1735,675 @@ mwc2_func SWC2[2 * 8*2] = {
     res_lsw,res_lsw,res_lsw,res_lsw,res_lsw,res_lsw,res_lsw,res_lsw,
 };
 
+void set_vector_transfers(const vector_transfers * transfers)
+{
+    LWC2[003] = transfers -> LDV;
+    LWC2[004] = transfers -> LQV;
+    LWC2[005] = transfers -> LRV;
+    LWC2[006] = transfers -> LPV;
+    LWC2[007] = transfers -> LUV;
+    LWC2[010] = transfers -> LHV;
+    SWC2[003] = transfers -> SDV;
+    SWC2[004] = transfers -> SQV;
+    SWC2[005] = transfers -> SRV;
+    SWC2[006] = transfers -> SPV;
+    SWC2[007] = transfers -> SUV;
+    SWC2[010] = transfers -> SHV;
+    return;
+}
+
+
+/*
+ * IMEM is kept around as predecoded instruction slots, one for each of its
+ * 1024 words, so that the interpreter loop does not have to split the same
+ * instruction word into its fields every single time that it runs it.
+ *
+ * A zero-filled slot is the exact decoding of the word 0x00000000 (NOP), so
+ * decoded_IMEM[] needs no other initialization than what C gives the rest
+ * of the rsp_context.
+ */
 
-PROFILE_MODE int SPECIAL(u32 inst, u32 PC)
-{
-    unsigned int rd, rs, rt;
-
-    rd = IW_RD(inst);
-    rt = (inst >> 16) % (1 << 5);
-
-    switch (inst % 64) {
-    case 000: /* SLL */
-        SR[rd] = SR[rt] << MASK_SA(inst >> 6);
-        SR[zero] = 0x00000000;
-        break;
-    case 002: /* SRL */
-        SR[rd] = (u32)(SR[rt]) >> MASK_SA(inst >> 6);
-        SR[zero] = 0x00000000;
-        break;
-    case 003: /* SRA */
-        SR[rd] = (s32)(SR[rt]) >> MASK_SA(inst >> 6);
-        SR[zero] = 0x00000000;
-        break;
-    case 004: /* SLLV */
-        rs = SPECIAL_DECODE_RS(inst);
-        SR[rd] = SR[rt] << MASK_SA(SR[rs]);
-        SR[zero] = 0x00000000;
-        break;
-    case 006: /* SRLV */
-        rs = SPECIAL_DECODE_RS(inst);
-        SR[rd] = (u32)(SR[rt]) >> MASK_SA(SR[rs]);
-        SR[zero] = 0x00000000;
-        break;
-    case 007: /* SRAV */
-        rs = SPECIAL_DECODE_RS(inst);
-        SR[rd] = (s32)(SR[rt]) >> MASK_SA(SR[rs]);
-        SR[zero] = 0x00000000;
-        break;
-    case 011: /* JALR */
-        SR[rd] = FIT_IMEM(PC + LINK_OFF);
-        SR[zero] = 0x00000000;
-     /* Fall through. */
-    case 010: /* JR */
-        rs = SPECIAL_DECODE_RS(inst);
-        set_PC(SR[rs]);
-        return 1;
-    case 015: /* BREAK */
-        *CR[0x4] |= SP_STATUS_BROKE | SP_STATUS_HALT;
-        if (*CR[0x4] & SP_STATUS_INTR_BREAK) {
-            GET_RCP_REG(MI_INTR_REG) |= 0x00000001;
-            GET_RSP_INFO(CheckInterrupts)();
+static void decode_inst(decoded_inst * inst, u32 word)
+{
+    const unsigned int rs = (word >> 21) % (1 << 5);
+    const unsigned int rt = (word >> 16) % (1 << 5);
+    const unsigned int rd = (word >> 11) % (1 << 5);
+    su_handler op;
+
+    inst -> word = word;
+    inst -> rs = (u8)rs;
+    inst -> rt = (u8)rt;
+    inst -> rd = (u8)rd;
+    inst -> sa = (u8)((word >> 6) % (1 << 5));
+    inst -> func = (u8)(word % (1 << 6));
+    inst -> e = (u8)((word >> 7) % (1 << 4));
+    inst -> imm = (s16)(word & 0x0000FFFFul);
+
+    switch (word >> 26) {
+    case 000: /* SPECIAL */
+        switch (word % 64) {
+        case 000:  op = SU_SLL;     break;
+        case 002:  op = SU_SRL;     break;
+        case 003:  op = SU_SRA;     break;
+        case 004:  op = SU_SLLV;    break;
+        case 006:  op = SU_SRLV;    break;
+        case 007:  op = SU_SRAV;    break;
+        case 010:  op = SU_JR;      break;
+        case 011:  op = SU_JALR;    break;
+        case 015:  op = SU_BREAK;   break;
+        case 040: /* ADD */
+        case 041:  op = SU_ADDU;    break;
+        case 042: /* SUB */
+        case 043:  op = SU_SUBU;    break;
+        case 044:  op = SU_AND;     break;
+        case 045:  op = SU_OR;      break;
+        case 046:  op = SU_XOR;     break;
+        case 047:  op = SU_NOR;     break;
+        case 052:  op = SU_SLT;     break;
+        case 053:  op = SU_SLTU;    break;
+        default:   op = SU_RESERVED;
+        }
+        break;
+    case 001: /* REGIMM */
+        switch (rt) {
+        case 000:  op = SU_BLTZ;    break;
+        case 001:  op = SU_BGEZ;    break;
+        case 020:  op = SU_BLTZAL;  break;
+        case 021:  op = SU_BGEZAL;  break;
+        default:   op = SU_RESERVED;
+        }
+        inst -> imm = FIT_IMEM(4*word + SLOT_OFF);
+        break;
+    case 002:
+    case 003:
+        op = (word >> 26 == 002) ? SU_J : SU_JAL;
+        inst -> imm = FIT_IMEM(4 * word);
+        break;
+    case 004:
+    case 005:
+    case 006:
+    case 007:
+        op = SU_BEQ + (word >> 26) - 004;
+        inst -> imm = FIT_IMEM(4*word + SLOT_OFF);
+        break;
+    case 010: /* ADDI:  Traps don't exist on the RCP. */
+    case 011:  op = SU_ADDIU;   break;
+    case 012:  op = SU_SLTI;    break;
+    case 013:  op = SU_SLTIU;   break;
+    case 014:
+    case 015:
+    case 016:
+        op = SU_ANDI + (word >> 26) - 014;
+        inst -> imm = word & 0x0000FFFFul;
+        break;
+    case 017:
+        op = SU_LUI;
+        inst -> imm = (word & 0x0000FFFFul) << 16;
+        break;
+    case 020: /* COP0 */
+        switch (rs) {
+        case 000:  op = SU_MFC0;    break;
+        case 004:  op = SU_MTC0;    break;
+        default:   op = SU_RESERVED;
         }
-        return -1;
-    case 040: /* ADD */
-    case 041: /* ADDU */
-        rs = SPECIAL_DECODE_RS(inst);
-        SR[rd] = SR[rs] + SR[rt];
-        SR[zero] = 0x00000000; /* needed for Rareware micro-codes */
-        break;
-    case 042: /* SUB */
-    case 043: /* SUBU */
-        rs = SPECIAL_DECODE_RS(inst);
-        SR[rd] = SR[rs] - SR[rt];
-        SR[zero] = 0x00000000;
-        break;
-    case 044: /* AND */
-        rs = SPECIAL_DECODE_RS(inst);
-        SR[rd] = SR[rs] & SR[rt];
-        SR[zero] = 0x00000000; /* needed for Rareware micro-codes */
-        break;
-    case 045: /* OR */
-        rs = SPECIAL_DECODE_RS(inst);
-        SR[rd] = SR[rs] | SR[rt];
-        SR[zero] = 0x00000000;
-        break;
-    case 046: /* XOR */
-        rs = SPECIAL_DECODE_RS(inst);
-        SR[rd] = SR[rs] ^ SR[rt];
-        SR[zero] = 0x00000000;
-        break;
-    case 047: /* NOR */
-        rs = SPECIAL_DECODE_RS(inst);
-        SR[rd] = ~(SR[rs] | SR[rt]);
-        SR[zero] = 0x00000000;
-        break;
-    case 052: /* SLT */
-        rs = SPECIAL_DECODE_RS(inst);
-        SR[rd] = ((s32)(SR[rs]) < (s32)(SR[rt]));
-        SR[zero] = 0x00000000;
-        break;
-    case 053: /* SLTU */
-        rs = SPECIAL_DECODE_RS(inst);
-        SR[rd] = ((u32)(SR[rs]) < (u32)(SR[rt]));
-        SR[zero] = 0x00000000;
+        inst -> rd = (u8)(rd % NUMBER_OF_CP0_REGISTERS);
+        break;
+    case 022: /* COP2 */
+        switch (rs) {
+        case 000:  op = SU_MFC2;    break;
+        case 002:  op = SU_CFC2;    break;
+        case 004:  op = SU_MTC2;    break;
+        case 006:  op = SU_CTC2;    break;
+        default:   op = (rs & 020) ? SU_VECTOR : SU_RESERVED;
+        }
+        break;
+    case 040:  op = SU_LB;      break;
+    case 041:  op = SU_LH;      break;
+    case 043:  op = SU_LW;      break;
+    case 044:  op = SU_LBU;     break;
+    case 045:  op = SU_LHU;     break;
+    case 050:  op = SU_SB;      break;
+    case 051:  op = SU_SH;      break;
+    case 053:  op = SU_SW;      break;
+    case 062: /* LWC2 */
+    case 072: /* SWC2 */
+        op = (word >> 26 == 062) ? SU_LWC2 : SU_SWC2;
+        inst -> imm = (word & 64) ? -(s32)(~word%64 + 1) : (s32)(word % 64);
         break;
     default:
-        res_S();
+        op = SU_RESERVED;
     }
-    return 0;
+    inst -> op = inst -> base_op = (u8)op;
+    return;
 }
 
-PROFILE_MODE int REGIMM(u32 inst, u32 PC)
+/*
+ * Superinstructions are picked at decode time, for pairs of instructions
+ * found to be the most common in hot micro-code loops (SU_PROFILE_IDIOMS).
+ * The first slot of the pair gets the superinstruction, which runs both of
+ * them and moves the PC past the second one.  The second slot keeps its own
+ * handler for anything that branches straight to it.
+ *
+ * The first instruction must not be in a branch delay slot, or else taking
+ * that branch would wrongly run the second instruction before the target.
+ */
+#if defined(EMULATE_STATIC_PC) && !defined(SP_EXECUTE_LOG)
+#if !defined(SU_PROFILE_IDIOMS) && !defined(SP_CAPTURE_TASKS)
+#define SU_FUSE_IDIOMS
+#endif
+#endif
+
+static int is_branch(unsigned int op)
 {
-    const unsigned int base = (inst >> 21) % (1 << 5);
-    const unsigned int rt   = (inst >> 16) % (1 << 5);
+    return (op >= SU_BLTZ && op <= SU_BGTZ) || op == SU_JR || op == SU_JALR;
+}
 
-    switch (rt) {
-    case 020: /* BLTZAL */
-        SR[ra] = FIT_IMEM(PC + LINK_OFF);
-     /* Fall through. */
-    case 000: /* BLTZ */
-        if (!((s32)SR[base] < 0))
-            return 0;
-        set_PC(PC + 4*inst + SLOT_OFF);
-        break;
-    case 021: /* BGEZAL */
-        SR[ra] = FIT_IMEM(PC + LINK_OFF);
-     /* Fall through. */
-    case 001: /* BGEZ */
-        if (!((s32)SR[base] >= 0))
-            return 0;
-        set_PC(PC + 4*inst + SLOT_OFF);
+/*
+ * Micro-code waiting on the CPU host polls SP_STATUS or the semaphore in a
+ * tight loop, which used to spin here MF_SP_STATUS_TIMEOUT times per task.
+ * Neither of those can change before the CPU host gets to run again, so a
+ * loop that does nothing but read them and compute with what it read will
+ * loop forever once it has looped once.  The DMA and RDP registers are left
+ * out, as the RDP (or the DMA) may well have moved on by the next read.
+ *
+ * Such a loop must not carry anything from one pass to the next (no counting
+ * of tries), so that it can be left right at its start without running the
+ * branch delay slot, to retry from the top the next time the RSP is started.
+ */
+#if defined(EMULATE_STATIC_PC) && defined(WAIT_FOR_CPU_HOST)
+#define SU_YIELD_SPIN_LOOPS
+#endif
+
+#ifdef SU_YIELD_SPIN_LOOPS
+#define SPIN_LOOP_LIMIT     8
+
+static int spin_loop_step(const decoded_inst * inst, u32 * written)
+{
+    u32 reads, writes;
+
+    switch (inst -> base_op) {
+    case SU_MFC0:
+        switch (inst -> rd % NUMBER_OF_CP0_REGISTERS) {
+        case 0x4: /* SP_STATUS */
+        case 0x7: /* SP_SEMAPHORE */
+            break;
+        default:
+            return 0; /* DMA or RDP progress, which can change mid-task */
+        }
+        reads = 0;
+        writes = 1u << inst -> rt;
+        break;
+    case SU_SLL:
+    case SU_SRL:
+    case SU_SRA:
+        reads = 1u << inst -> rt;
+        writes = 1u << inst -> rd;
+        break;
+    case SU_SLLV:
+    case SU_SRLV:
+    case SU_SRAV:
+    case SU_ADDU:
+    case SU_SUBU:
+    case SU_AND:
+    case SU_OR:
+    case SU_XOR:
+    case SU_NOR:
+    case SU_SLT:
+    case SU_SLTU:
+        reads = (1u << inst -> rs) | (1u << inst -> rt);
+        writes = 1u << inst -> rd;
+        break;
+    case SU_ADDIU:
+    case SU_SLTI:
+    case SU_SLTIU:
+    case SU_ANDI:
+    case SU_ORI:
+    case SU_XORI:
+        reads = 1u << inst -> rs;
+        writes = 1u << inst -> rt;
+        break;
+    case SU_LUI:
+        reads = 0;
+        writes = 1u << inst -> rt;
+        break;
+    case SU_BEQ:
+    case SU_BNE:
+        reads = (1u << inst -> rs) | (1u << inst -> rt);
+        writes = 0;
+        break;
+    case SU_BLTZ:
+    case SU_BGEZ:
+    case SU_BLEZ:
+    case SU_BGTZ:
+        reads = 1u << inst -> rs;
+        writes = 0;
         break;
     default:
-        res_S();
+        return 0; /* memory, COP2, MTC0 or jumps */
     }
+    if (reads & ~*written)
+        return 0; /* left over from the previous time around the loop */
+    *written |= writes;
     return 1;
 }
 
-PROFILE_MODE void MWC2_load(u32 inst)
+static int is_spin_loop(unsigned int branch)
 {
-    s16 offset;
-    const unsigned int base    = (inst >> 21) % (1 << 5);
-    const unsigned int vt      = (inst >> 16) % (1 << 5);
-    const unsigned int element = (inst >>  7) % (1 << 4);
+    const decoded_inst * inst = &decoded_IMEM[branch];
+    unsigned int start, i;
+    u32 written;
+    int polls;
 
-#if defined(ARCH_MIN_SSE2) && !defined(SSE2NEON)
-    offset   = (s16)inst;
-    offset <<= 5 + 4; /* safe on x86, skips 5-bit rd, 4-bit element */
-    offset >>= 5 + 4;
-#else
-    offset = (inst & 64) ? -(s16)(~inst%64 + 1) : (s16)(inst % 64);
+    switch (inst -> base_op) {
+    case SU_BLTZ:
+    case SU_BGEZ:
+    case SU_BEQ:
+    case SU_BNE:
+    case SU_BLEZ:
+    case SU_BGTZ:
+        break;
+    default:
+        return 0;
+    }
+    if (branch >= 4096/4 - 1)
+        return 0; /* The delay slot would wrap around. */
+    start = FIT_IMEM(4*branch + 4 + inst -> imm) / 4;
+    if (start > branch || branch - start >= SPIN_LOOP_LIMIT)
+        return 0;
+
+    written = 1u << zero;
+    polls = 0;
+    for (i = start; i <= branch + 1; i++) {
+        if (spin_loop_step(&decoded_IMEM[i], &written) == 0)
+            return 0;
+        if (i == branch)
+            continue;
+        if (decoded_IMEM[i].base_op >= SU_BLTZ)
+            if (decoded_IMEM[i].base_op <= SU_BGTZ)
+                return 0;
+        polls |= (decoded_IMEM[i].base_op == SU_MFC0);
+    }
+    return (polls);
+}
+
+static int spin_loops_again(const decoded_inst * inst, u32 PC)
+{
+    switch (inst -> base_op) {
+    case SU_BLTZ:  return BLTZ(inst -> rs, inst -> imm, PC);
+    case SU_BGEZ:  return BGEZ(inst -> rs, inst -> imm, PC);
+    case SU_BEQ:   return BEQ(inst -> rs, inst -> rt, inst -> imm, PC);
+    case SU_BNE:   return BNE(inst -> rs, inst -> rt, inst -> imm, PC);
+    case SU_BLEZ:  return BLEZ(inst -> rs, inst -> imm, PC);
+    case SU_BGTZ:  return BGTZ(inst -> rs, inst -> imm, PC);
+    }
+    return 0;
+}
 #endif
-    LWC2[IW_RD(inst)](vt, element, offset, base);
+
+/*
+ * Liveness:  a backward pass over the straight-line code, to find vector
+ * results which are overwritten before anything reads them, so that their
+ * operations can be given cheaper kernels (see COP2_C2 for the variants).
+ *
+ * Branches are not followed, so everything counts as live past a delay slot,
+ * as it does past anything which could stop the RSP or DMA in new IMEM.
+ */
+#define VCF_VCO         0x1
+#define VCF_VCC         0x2
+#define VCF_VCE         0x4
+#define VCF_ALL         (VCF_VCO | VCF_VCC | VCF_VCE)
+
+#define ACC_LO          0x1
+#define ACC_MD          0x2
+#define ACC_HI          0x4
+#define ACC_ALL         (ACC_LO | ACC_MD | ACC_HI)
+
+static unsigned int control_flag(unsigned int rd)
+{
+    return (rd & 3) == 0 ? VCF_VCO : ((rd & 3) == 1 ? VCF_VCC : VCF_VCE);
 }
-PROFILE_MODE void MWC2_store(u32 inst)
+static unsigned int flags_read(const decoded_inst * inst)
 {
-    s16 offset;
-    const unsigned int base    = (inst >> 21) % (1 << 5);
-    const unsigned int vt      = (inst >> 16) % (1 << 5);
-    const unsigned int element = (inst >>  7) % (1 << 4);
+    if (inst -> base_op == SU_CFC2)
+        return control_flag(inst -> rd);
+    if (inst -> base_op != SU_VECTOR)
+        return 0;
+    switch (inst -> func % 64) {
+    case 020: /* VADD */
+    case 021: /* VSUB */
+    case 040: /* VLT */
+    case 041: /* VEQ */
+    case 042: /* VNE */
+    case 043: /* VGE */
+        return VCF_VCO;
+    case 044: /* VCL */
+        return VCF_ALL;
+    case 047: /* VMRG */
+        return VCF_VCC;
+    }
+    return 0;
+}
+static unsigned int flags_written(const decoded_inst * inst)
+{
+    if (inst -> base_op == SU_CTC2)
+        return control_flag(inst -> rd);
+    if (inst -> base_op != SU_VECTOR)
+        return 0;
+    switch (inst -> func % 64) {
+    case 020: /* VADD */
+    case 021: /* VSUB */
+    case 024: /* VADDC */
+    case 025: /* VSUBC */
+        return VCF_VCO;
+    case 040: /* VLT */
+    case 041: /* VEQ */
+    case 042: /* VNE */
+    case 043: /* VGE */
+        return VCF_VCO | VCF_VCC;
+    case 044: /* VCL */
+    case 045: /* VCH */
+    case 046: /* VCR */
+        return VCF_ALL;
+    }
+    return 0;
+}
 
-#if defined(ARCH_MIN_SSE2) && !defined(SSE2NEON)
-    offset = (s16)inst;
-    offset <<= 5 + 4; /* safe on x86, skips 5-bit rd, 4-bit element */
-    offset >>= 5 + 4;
-#else
-    offset = (inst & 64) ? -(s16)(~inst%64 + 1) : (s16)(inst % 64);
+static int is_multiply(unsigned int func)
+{
+    return (func < 020 && (func & 6) != 2); /* not VRNDP, VMULQ and so on */
+}
+static unsigned int accumulator_read(const decoded_inst * inst)
+{
+    if (inst -> base_op != SU_VECTOR)
+        return 0;
+    if (inst -> func % 64 >= 010 && is_multiply(inst -> func % 64))
+        return ACC_ALL; /* VMACF, VMACU, VMADL, VMADM, VMADN, VMADH */
+    if (inst -> func % 64 == 035)
+        return ACC_ALL; /* VSAW */
+    return 0;
+}
+static unsigned int accumulator_written(const decoded_inst * inst)
+{
+    const unsigned int func = inst -> func % 64;
+
+    if (inst -> base_op != SU_VECTOR)
+        return 0;
+    if (func == 017)
+        return ACC_MD | ACC_HI; /* VMADH */
+    if (is_multiply(func))
+        return ACC_ALL;
+    if (func >= 020 && func <= 025 && func != 022)
+        return ACC_LO;
+    if (func >= 040 && func <= 055)
+        return ACC_LO; /* select and logical operations */
+    if (func >= 060 && func <= 066)
+        return ACC_LO; /* VRCP through VRSQH, and VMOV */
+    return 0;
+}
+
+/*
+ * Vector register reads and whole-register writes, as masks of registers.
+ * Writes of single elements (VMOV, VRCP, LWC2 and MTC2) do not count.
+ */
+static u32 registers_read(const decoded_inst * inst)
+{
+    switch (inst -> base_op) {
+    case SU_VECTOR:
+        return (1ul << inst -> rd) | (1ul << inst -> rt); /* vs, vt */
+    case SU_MFC2:
+        return (1ul << inst -> rd);
+    case SU_SWC2:
+        if (inst -> rd >= 010)
+            return 0xFFFFFFFFul; /* SWV and STV, or reserved */
+        return (1ul << inst -> rt);
+    }
+    return 0;
+}
+static u32 registers_written(const decoded_inst * inst)
+{
+    const unsigned int func = inst -> func % 64;
+
+    if (inst -> base_op != SU_VECTOR)
+        return 0;
+    if (is_multiply(func) || func == 035)
+        return (1ul << inst -> sa);
+    if (func >= 020 && func <= 025 && func != 022)
+        return (1ul << inst -> sa);
+    if (func >= 040 && func <= 055)
+        return (1ul << inst -> sa);
+    return 0;
+}
+
+static void kill_dead_writes(void)
+{
+    unsigned int flags, accumulator;
+    u32 registers;
+    register unsigned int i;
+
+    flags = VCF_ALL;
+    accumulator = ACC_ALL;
+    registers = 0xFFFFFFFFul;
+    for (i = 4096 / 4; i-- != 0; ) {
+        decoded_inst * inst = &decoded_IMEM[i];
+        const unsigned int op = inst -> base_op;
+        int ends = 0;
+
+        ends |= (i == 4096/4 - 1);
+        ends |= (op == SU_MFC0 || op == SU_MTC0 || op == SU_BREAK);
+        ends |= (i != 0 && is_branch(decoded_IMEM[i - 1].base_op));
+        if (ends) {
+            flags = VCF_ALL;
+            accumulator = ACC_ALL;
+            registers = 0xFFFFFFFFul;
+        }
+
+        if (op == SU_VECTOR) {
+            const unsigned int func = inst -> func %= 64;
+
+            if (func == 020 || func == 021 || func == 024 || func == 025)
+                if ((flags & VCF_VCO) == 0)
+                    inst -> func |= DEAD_SIDE_EFFECTS;
+            if (is_multiply(func)) {
+                if ((accumulator & accumulator_written(inst)) == 0)
+                    inst -> func |= DEAD_SIDE_EFFECTS;
+                if ((registers & registers_written(inst)) == 0)
+                    inst -> func |= DEAD_VD;
+            }
+        }
+        flags = (flags & ~flags_written(inst)) | flags_read(inst);
+        accumulator &= ~accumulator_written(inst);
+        accumulator |= accumulator_read(inst);
+        registers &= ~registers_written(inst);
+        registers |= registers_read(inst);
+    }
+    return;
+}
+
+#ifdef SU_FUSE_IDIOMS
+/*
+ * The multiply chains (see FUSED_MULTIPLIES in vu/vu.h) need SSE2 and the
+ * dead result flags from kill_dead_writes(), which they have to agree with.
+ */
+#ifdef ARCH_MIN_SSE2
+#define SU_FUSE_MULTIPLIES
 #endif
-    SWC2[IW_RD(inst)](vt, element, offset, base);
+
+#ifdef SU_FUSE_MULTIPLIES
+static int is_vector_op(const decoded_inst * inst, unsigned int func)
+{
+    return (inst -> base_op == SU_VECTOR && inst -> func % 64 == func);
 }
 
-PROFILE_MODE void COP0(u32 inst)
+static int is_mul_32x32(const decoded_inst * inst)
 {
-    const unsigned int rd = IW_RD(inst);
-    const unsigned int rs = (inst >> 21) % (1 << 5);
-    const unsigned int rt = (inst >> 16) % (1 << 5);
+    const decoded_inst * mudl = &inst[0];
+    const decoded_inst * madm = &inst[1];
+    const decoded_inst * madn = &inst[2];
+    const decoded_inst * madh = &inst[3];
 
-    switch (rs) {
-    case 000:
-        SP_CP0_MF(rt, rd);
-        break;
-    case 004:
-        SP_CP0_MT[rd % NUMBER_OF_CP0_REGISTERS](rt);
-        break;
-    default:
-        res_S();
+    if (!is_vector_op(mudl, 004) && !is_vector_op(mudl, 014))
+        return 0; /* VMUDL or VMADL */
+    if (!is_vector_op(madm, 015) || !is_vector_op(madn, 016))
+        return 0;
+    if (!is_vector_op(madh, 017))
+        return 0;
+    if (mudl -> rd != madn -> rd || madm -> rd != madh -> rd)
+        return 0; /* vs:  the same a_lo and a_hi */
+    if (mudl -> rt != madm -> rt || mudl -> rs != madm -> rs)
+        return 0; /* vt:  the same b_lo, with the same element */
+    if (madn -> rt != madh -> rt || madn -> rs != madh -> rs)
+        return 0; /* vt:  the same b_hi, with the same element */
+    if (!(mudl -> func & DEAD_VD) || !(madm -> func & DEAD_VD))
+        return 0;
+    return (madn -> sa != madh -> rd && madn -> sa != madh -> rt);
+}
+
+static int is_mulf_macf(const decoded_inst * inst)
+{
+    if (!is_vector_op(&inst[0], 000) || !is_vector_op(&inst[1], 010))
+        return 0;
+    return (inst[0].sa != inst[1].rd && inst[0].sa != inst[1].rt);
+}
+
+static int is_mul_pair(const decoded_inst * inst)
+{
+    const unsigned int func = inst[0].func % 64;
+
+    if (func > 007 || func == 002 || func == 003)
+        return 0; /* not VMULF, VMULU or VMUD? */
+    if (!is_vector_op(&inst[0], func) || !is_vector_op(&inst[1], func))
+        return 0;
+    return (inst[0].sa != inst[1].rd && inst[0].sa != inst[1].rt);
+}
+#endif
+
+static su_handler fused_handler(const decoded_inst * a, const decoded_inst * b)
+{
+    if (a -> base_op == SU_LUI && b -> base_op == SU_ORI)
+        return SU_LUI_ORI;
+    if (a -> base_op == SU_ADDIU && b -> base_op == SU_BNE)
+        return SU_ADDIU_BNE;
+    if (a -> base_op == SU_LWC2 && b -> base_op == SU_LWC2)
+        if (a -> rd == 004 && b -> rd == 005) /* LQV, LRV */
+            return SU_LQV_LRV;
+#ifdef SU_FUSE_MULTIPLIES
+    if (a + 3 < &decoded_IMEM[4096 / 4] && is_mul_32x32(a))
+        return SU_VMUDL_VMADH;
+    if (is_mulf_macf(a))
+        return SU_VMULF_VMACF;
+    if (is_mul_pair(a))
+        return SU_VMUL_PAIR;
+#endif
+    if (a -> base_op == SU_VECTOR && b -> base_op == SU_VECTOR)
+        return SU_VECTOR_VECTOR;
+    return (su_handler)(a -> base_op);
+}
+#endif
+
+static void fuse_IMEM(void)
+{
+    register unsigned int i;
+
+    for (i = 0; i < 4096 / 4; i++)
+        decoded_IMEM[i].op = decoded_IMEM[i].base_op;
+#ifdef SU_YIELD_SPIN_LOOPS
+    for (i = 0; i < 4096 / 4; i++)
+        if (is_spin_loop(i))
+            decoded_IMEM[i].op = SU_SPIN_LOOP;
+#endif
+#ifdef SU_FUSE_IDIOMS
+    for (i = 0; i < 4096 / 4 - 1; i++) {
+        if (is_branch(decoded_IMEM[(i - 1) % (4096 / 4)].base_op))
+            continue;
+        if (decoded_IMEM[i + 0].op == SU_SPIN_LOOP)
+            continue;
+        if (decoded_IMEM[i + 1].op == SU_SPIN_LOOP)
+            continue;
+        decoded_IMEM[i].op = (u8)fused_handler(
+            &decoded_IMEM[i + 0],
+            &decoded_IMEM[i + 1]
+        );
     }
+#endif
+    return;
+}
+
+void decode_IMEM(void)
+{
+    register unsigned int i;
+
+    for (i = 0; i < 4096 / 4; i++)
+        if (decoded_IMEM[i].word != *(pu32)(IMEM + 4*i))
+            break;
+    if (i >= 4096 / 4)
+        return; /* still the same IMEM image as the last time */
+    if (fetch_icache() != 0)
+        return;
+
+    for (; i < 4096 / 4; i++) {
+        const u32 word = *(pu32)(IMEM + 4*i);
+
+        if (decoded_IMEM[i].word != word)
+            decode_inst(&decoded_IMEM[i], word);
+    }
+    kill_dead_writes();
+    fuse_IMEM();
+    store_icache();
+    return;
 }
 
-PROFILE_MODE void COP2(u32 inst)
+int decodes_to(const decoded_inst * slots)
 {
-    const unsigned int op = (inst >> 21) % (1 << 5); /* inst.R.rs */
-    const unsigned int vt = (inst >> 16) % (1 << 5); /* inst.R.rt */
-    const unsigned int vs = IW_RD(inst);
-    const unsigned int vd = (inst >>  6) % (1 << 5); /* inst.R.sa */
-    const unsigned int func = inst % (1 << 6);
-#ifndef ARCH_MIN_SSE2
+    static decoded_inst saved[4096 / 4];
+    int same;
+    register unsigned int i;
+
+    memcpy(saved, decoded_IMEM, sizeof(saved));
+    for (i = 0; i < 4096 / 4; i++)
+        decode_inst(&decoded_IMEM[i], slots[i].word);
+    kill_dead_writes();
+    fuse_IMEM();
+    same = (memcmp(decoded_IMEM, slots, sizeof(saved)) == 0);
+    memcpy(decoded_IMEM, saved, sizeof(saved));
+    return (same);
+}
+
+PROFILE_MODE void COP2(
+    unsigned int op, unsigned int vd, unsigned int vs, unsigned int vt,
+    unsigned int func)
+{
+#ifdef ARCH_MIN_SSE2
+    if (op & 020)
+        VECTOR_HANDLERS[func](vd, vs, vt, op & 0xF);
+    else
+        res_S();
+#else
     const unsigned int e  = op & 0xF; /* With Intel, LEA offsets beat ANDing. */
-#endif
 
     switch (op) {
         static ALIGNED i16 shuffle_temporary[N];
-#ifdef ARCH_MIN_SSE2
-        v16 target;
-#else
         register unsigned int i;
-#endif
 
-    case 000:
-        MFC2(vt, vs, vd >> 1);
-        break;
-    case 002:
-        CFC2(vt, vs);
-        break;
-    case 004:
-        MTC2(vt, vs, vd >> 1);
-        break;
-    case 006:
-        CTC2(vt, vs);
-        break;
     case 020:
     case 021:
-#ifdef ARCH_MIN_SSE2
-        *(v16 *)(VR[vd]) = COP2_C2[func](*(v16 *)VR[vs], *(v16 *)VR[vt]);
-#else
         COP2_C2[func](&VR[vs][0], &VR[vt][0]);
         vector_copy(&VR[vd][0], &V_result[0]);
-#endif
         break;
     case 022:
     case 023:
-#ifdef ARCH_MIN_SSE2
-#ifdef __ARM_NEON__
-        target = (v16)vld1q_u16(&VR[vt][0 + op - 0x12]);
-        target = (v16)vshlq_n_u32((uint32x4_t)target, 16);
-        target = (v16)vorrq_u16((uint16x8_t)target,
-                                (uint16x8_t)vshrq_n_u32((uint32x4_t)target, 16));
-#else
-        shuffle_temporary[0] = VR[vt][0 + op - 0x12];
-        shuffle_temporary[2] = VR[vt][2 + op - 0x12];
-        shuffle_temporary[4] = VR[vt][4 + op - 0x12];
-        shuffle_temporary[6] = VR[vt][6 + op - 0x12];
-        target = *(v16 *)(&shuffle_temporary[0]);
-        target = _mm_shufflehi_epi16(target, _MM_SHUFFLE(2, 2, 0, 0));
-        target = _mm_shufflelo_epi16(target, _MM_SHUFFLE(2, 2, 0, 0));
-#endif
-        *(v16 *)(VR[vd]) = COP2_C2[func](*(v16 *)VR[vs], target);
-#else
         for (i = 0; i < N; i++)
             shuffle_temporary[i] = VR[vt][(i & 0xE) + (e & 0x1)];
         COP2_C2[func](&VR[vs][0], &shuffle_temporary[0]);
         vector_copy(&VR[vd][0], &V_result[0]);
-#endif
         break;
     case 024:
     case 025:
     case 026:
     case 027:
-#ifdef ARCH_MIN_SSE2
-#ifdef __ARM_NEON__
-        target = (v16)vcombine_s16(vdup_n_s16(VR[vt][0 + op - 0x14]),
-                                   vdup_n_s16(VR[vt][4 + op - 0x14]));
-#else
-        target = _mm_setzero_si128();
-        target = _mm_insert_epi16(target, VR[vt][0 + op - 0x14], 0);
-        target = _mm_insert_epi16(target, VR[vt][4 + op - 0x14], 4);
-        target = _mm_shufflehi_epi16(target, _MM_SHUFFLE(0, 0, 0, 0));
-        target = _mm_shufflelo_epi16(target, _MM_SHUFFLE(0, 0, 0, 0));
-#endif
-        *(v16 *)(VR[vd]) = COP2_C2[func](*(v16 *)VR[vs], target);
-#else
         for (i = 0; i < N; i++)
             shuffle_temporary[i] = VR[vt][(i & 0xC) + (e & 0x3)];
         COP2_C2[func](&VR[vs][0], &shuffle_temporary[0]);
         vector_copy(&VR[vd][0], &V_result[0]);
-#endif
         break;
     case 030:
     case 031:
@@ -1935,140 +2413,606 @@ PROFILE_MODE void COP2(u32 inst)
     case 035:
     case 036:
     case 037:
-#ifdef ARCH_MIN_SSE2
-        *(v16 *)(VR[vd]) = COP2_C2[func](
-            *(v16 *)VR[vs],
-            _mm_set1_epi16(VR[vt][op - 0x18])
-        );
-#else
         for (i = 0; i < N; i++)
             shuffle_temporary[i] = VR[vt][e % N];
         COP2_C2[func](&VR[vs][0], &shuffle_temporary[0]);
         vector_copy(&VR[vd][0], &V_result[0]);
-#endif
         break;
     default:
         res_S();
     }
+#endif
+}
+
+#ifdef SU_FUSE_MULTIPLIES
+/*
+ * the superinstructions for the multiply chains FUSED_MULTIPLIES runs
+ */
+static void run_mul_32x32(const decoded_inst * inst)
+{
+    const decoded_inst * madn = &inst[2];
+    const decoded_inst * madh = &inst[3];
+    int chain;
+    v16 vd;
+
+    chain  = (inst -> func % 64 == 014) ? CHAIN_ACCUMULATE : 0; /* VMADL */
+    chain |= (madh -> func & DEAD_SIDE_EFFECTS) ? 0 : CHAIN_ACC_LIVE;
+    vd = FUSED_MULTIPLIES.mul_32x32(
+        *(v16 *)VR[inst -> rd],
+        *(v16 *)VR[madh -> rd],
+        vector_select(inst -> rt, inst -> rs & 0xF),
+        vector_select(madh -> rt, madh -> rs & 0xF),
+        (madn -> func & DEAD_VD) ? NULL : VR[madn -> sa],
+        chain
+    );
+    if ((madh -> func & DEAD_VD) == 0)
+        *(v16 *)VR[madh -> sa] = vd;
+    return;
+}
+static void run_mulf_macf(const decoded_inst * inst)
+{
+    const decoded_inst * macf = &inst[1];
+    v16 vd;
+
+    vd = FUSED_MULTIPLIES.mulf_macf(
+        *(v16 *)VR[inst -> rd],
+        vector_select(inst -> rt, inst -> rs & 0xF),
+        *(v16 *)VR[macf -> rd],
+        vector_select(macf -> rt, macf -> rs & 0xF),
+        (inst -> func & DEAD_VD) ? NULL : VR[inst -> sa],
+        (macf -> func & DEAD_SIDE_EFFECTS) ? 0 : CHAIN_ACC_LIVE
+    );
+    if ((macf -> func & DEAD_VD) == 0)
+        *(v16 *)VR[macf -> sa] = vd;
+    return;
+}
+static void run_mul_pair(const decoded_inst * inst)
+{
+    const decoded_inst * next = &inst[1];
+    v16 vd;
+
+    vd = FUSED_MULTIPLIES.mul_pair[inst -> func % 8](
+        *(v16 *)VR[inst -> rd],
+        vector_select(inst -> rt, inst -> rs & 0xF),
+        *(v16 *)VR[next -> rd],
+        vector_select(next -> rt, next -> rs & 0xF),
+        (inst -> func & DEAD_VD) ? NULL : VR[inst -> sa],
+        (next -> func & DEAD_SIDE_EFFECTS) ? 0 : CHAIN_ACC_LIVE
+    );
+    if ((next -> func & DEAD_VD) == 0)
+        *(v16 *)VR[next -> sa] = vd;
+    return;
+}
+#endif
+
+/*
+ * Every handler in run_task() finishes with NEXT (or JUMP for taken branches).
+ *
+ * With the portable `switch` loop, NEXT just breaks back out to the top of
+ * the interpreter loop.  With threaded dispatch, the `switch` is only used to
+ * start the task, and from then on every handler fetches the following slot
+ * and jumps directly into its handler through its own indirect branch.
+ */
+#ifdef SU_PROFILE_IDIOMS
+/*
+ * Vector operations and LWC2/SWC2 are counted by their own op-codes, since
+ * the plain handler names would not say which of them are worth fusing.
+ */
+#define IDIOM_VECTOR    (SU_RESERVED + 1)
+#define IDIOM_LWC2      (IDIOM_VECTOR + 64)
+#define IDIOM_SWC2      (IDIOM_LWC2 + 16)
+#define IDIOM_KEYS      (IDIOM_SWC2 + 16)
+
+static const char * const idiom_names[IDIOM_KEYS] = {
+    "SLL"   ,"SRL"   ,"SRA"   ,"SLLV"  ,"SRLV"  ,"SRAV"  ,"JR"    ,"JALR"  ,
+    "BREAK" ,"ADDU"  ,"SUBU"  ,"AND"   ,"OR"    ,"XOR"   ,"NOR"   ,"SLT"   ,
+    "SLTU"  ,"BLTZ"  ,"BGEZ"  ,"BLTZAL","BGEZAL","J"     ,"JAL"   ,"BEQ"   ,
+    "BNE"   ,"BLEZ"  ,"BGTZ"  ,"ADDIU" ,"SLTI"  ,"SLTIU" ,"ANDI"  ,"ORI"   ,
+    "XORI"  ,"LUI"   ,"MFC0"  ,"MTC0"  ,"MFC2"  ,"CFC2"  ,"MTC2"  ,"CTC2"  ,
+    "COP2"  ,"LB"    ,"LH"    ,"LW"    ,"LBU"   ,"LHU"   ,"SB"    ,"SH"    ,
+    "SW"    ,"LWC2"  ,"SWC2"  ,"RESERVED",
+
+    "VMULF" ,"VMULU" ,"VRNDP" ,"VMULQ" ,"VMUDL" ,"VMUDM" ,"VMUDN" ,"VMUDH" ,
+    "VMACF" ,"VMACU" ,"VRNDN" ,"VMACQ" ,"VMADL" ,"VMADM" ,"VMADN" ,"VMADH" ,
+    "VADD"  ,"VSUB"  ,"VSUT"  ,"VABS"  ,"VADDC" ,"VSUBC" ,"VADDB" ,"VSUBB" ,
+    "VACCB" ,"VSUCB" ,"VSAD"  ,"VSAC"  ,"VSUM"  ,"VSAW"  ,"V036"  ,"V037"  ,
+    "VLT"   ,"VEQ"   ,"VNE"   ,"VGE"   ,"VCL"   ,"VCH"   ,"VCR"   ,"VMRG"  ,
+    "VAND"  ,"VNAND" ,"VOR"   ,"VNOR"  ,"VXOR"  ,"VNXOR" ,"V056"  ,"V057"  ,
+    "VRCP"  ,"VRCPL" ,"VRCPH" ,"VMOV"  ,"VRSQ"  ,"VRSQL" ,"VRSQH" ,"VNOP"  ,
+    "VEXTT" ,"VEXTQ" ,"VEXTN" ,"V073"  ,"VINST" ,"VINSQ" ,"VINSN" ,"VNULL" ,
+
+    "LBV"   ,"LSV"   ,"LLV"   ,"LDV"   ,"LQV"   ,"LRV"   ,"LPV"   ,"LUV"   ,
+    "LHV"   ,"LFV"   ,"LWV"   ,"LTV"   ,"LWC2"  ,"LWC2"  ,"LWC2"  ,"LWC2"  ,
+    "SBV"   ,"SSV"   ,"SLV"   ,"SDV"   ,"SQV"   ,"SRV"   ,"SPV"   ,"SUV"   ,
+    "SHV"   ,"SFV"   ,"SWV"   ,"STV"   ,"SWC2"  ,"SWC2"  ,"SWC2"  ,"SWC2"  ,
+};
+
+static u64 idiom_steps;
+static u64 idiom_pairs[IDIOM_KEYS][IDIOM_KEYS];
+
+/*
+ * Most triples never happen, so they are counted in an open-addressed hash
+ * table instead.  Any new triple after the table fills up is not counted.
+ */
+#define IDIOM_TRIPLE_SLOTS  (1 << 16)
+static struct {
+    u32 key; /* zero for an empty slot, else 1 + the three idiom keys */
+    u64 count;
+} idiom_triples[IDIOM_TRIPLE_SLOTS];
+
+static unsigned int idiom_key(const decoded_inst * inst)
+{
+    switch (inst -> base_op) {
+    case SU_VECTOR:  return IDIOM_VECTOR + (inst -> func % 64);
+    case SU_LWC2:    return IDIOM_LWC2 + (inst -> rd % 16);
+    case SU_SWC2:    return IDIOM_SWC2 + (inst -> rd % 16);
+    }
+    return (inst -> base_op);
 }
 
+static void count_triple(unsigned int a, unsigned int b, unsigned int c)
+{
+    const u32 key = 1 + (a*IDIOM_KEYS + b)*IDIOM_KEYS + c;
+    register u32 i, n;
+
+    i = (key * 2654435761u) >> 16;
+    for (n = 0; n < IDIOM_TRIPLE_SLOTS; n++, i = (i + 1) % IDIOM_TRIPLE_SLOTS) {
+        if (idiom_triples[i].key == key) {
+            idiom_triples[i].count += 1;
+            return;
+        }
+        if (idiom_triples[i].key != 0)
+            continue;
+        idiom_triples[i].key = key;
+        idiom_triples[i].count = 1;
+        return;
+    }
+    return;
+}
+
+static void profile_idioms(const decoded_inst * inst)
+{
+    static int last[2] = { -8, -8 };
+    static unsigned int keys[2];
+    const int slot = (int)(inst - &decoded_IMEM[0]);
+    const unsigned int key = idiom_key(inst);
+
+    ++idiom_steps;
+    if (slot == last[0] + 1) {
+        idiom_pairs[keys[0]][key] += 1;
+        if (last[0] == last[1] + 1)
+            count_triple(keys[1], keys[0], key);
+    }
+    last[1] = last[0];
+    keys[1] = keys[0];
+    last[0] = slot;
+    keys[0] = key;
+    return;
+}
+
+typedef struct {
+    u64 count;
+    u32 key;
+} idiom_count;
+
+static int idiom_descending(const void * a, const void * b)
+{
+    const u64 x = ((const idiom_count *)a) -> count;
+    const u64 y = ((const idiom_count *)b) -> count;
+
+    return (x < y) - (x > y);
+}
+
+#define IDIOMS_TO_REPORT    48
+
+NOINLINE void export_idiom_profile(const char * target)
+{
+    static idiom_count found[IDIOM_TRIPLE_SLOTS];
+    FILE * out;
+    register u32 i, n;
+
+    out = fopen(target, "w");
+    if (out == NULL)
+        return;
+    fprintf(out, "%.0f instructions\n", (double)idiom_steps);
+
+    n = 0;
+    for (i = 0; i < IDIOM_KEYS * IDIOM_KEYS; i++) {
+        if (idiom_pairs[i / IDIOM_KEYS][i % IDIOM_KEYS] == 0)
+            continue;
+        found[n].count = idiom_pairs[i / IDIOM_KEYS][i % IDIOM_KEYS];
+        found[n].key = i;
+        ++n;
+    }
+    qsort(found, n, sizeof(found[0]), idiom_descending);
+    fprintf(out, "\nhottest pairs of consecutive instructions:\n");
+    for (i = 0; i < n && i < IDIOMS_TO_REPORT; i++)
+        fprintf(out, "%12.0f  %6.2f%%  %s %s\n",
+            (double)found[i].count,
+            100.0 * (double)found[i].count / (double)idiom_steps,
+            idiom_names[found[i].key / IDIOM_KEYS],
+            idiom_names[found[i].key % IDIOM_KEYS]
+        );
+
+    n = 0;
+    for (i = 0; i < IDIOM_TRIPLE_SLOTS; i++) {
+        if (idiom_triples[i].key == 0)
+            continue;
+        found[n].count = idiom_triples[i].count;
+        found[n].key = idiom_triples[i].key - 1;
+        ++n;
+    }
+    qsort(found, n, sizeof(found[0]), idiom_descending);
+    fprintf(out, "\nhottest triples of consecutive instructions:\n");
+    for (i = 0; i < n && i < IDIOMS_TO_REPORT; i++)
+        fprintf(out, "%12.0f  %6.2f%%  %s %s %s\n",
+            (double)found[i].count,
+            100.0 * (double)found[i].count / (double)idiom_steps,
+            idiom_names[found[i].key / IDIOM_KEYS / IDIOM_KEYS],
+            idiom_names[found[i].key / IDIOM_KEYS % IDIOM_KEYS],
+            idiom_names[found[i].key % IDIOM_KEYS]
+        );
+    fclose(out);
+    return;
+}
+#endif
+
+#if defined(SP_EXECUTE_LOG)
+#define STEP_LOG()      step_SP_commands(inst -> word)
+#elif defined(SU_PROFILE_IDIOMS)
+#define STEP_LOG()      profile_idioms(inst)
+#elif defined(SP_CAPTURE_TASKS)
+#define STEP_LOG()      ++capture_steps
+#else
+#define STEP_LOG()
+#endif
+
+/*
+ * With the recompiler, the threaded interpreter leaves for a recompiled block
+ * whenever it lands on the start of one, though never from a delay slot.
+ * Taken branches also get their targets recompiled as the next block starts.
+ */
+#ifdef SU_X64_JIT
+#define ENTER_BLOCK() \
+    if (recompiled[FIT_IMEM(PC) / 4] != NULL) goto recompiled_block;
+#define RECOMPILE_TARGET()  recompile(temp_PC)
+#else
+#define ENTER_BLOCK()
+#define RECOMPILE_TARGET()
+#endif
+
+/*
+ * Label addresses and `goto *` are GNU C, which -pedantic warns of unless
+ * they are inside __extension__.  Those around the `goto *` need it to be
+ * an expression, hence the statement expression.
+ */
+#ifdef SU_THREADED_DISPATCH
+#define SU_OP(handler)  case SU_##handler: op_##handler
+#define DISPATCH()      __extension__ ({ goto *handlers[inst -> op]; })
+#define NEXT { \
+    ENTER_BLOCK(); \
+    inst = &decoded_IMEM[FIT_IMEM(PC) / 4]; \
+    PC = (PC + 0x004); \
+    STEP_LOG(); \
+    DISPATCH(); }
+#undef JUMP
+#define JUMP { \
+    RECOMPILE_TARGET(); \
+    inst = &decoded_IMEM[FIT_IMEM(PC) / 4]; \
+    PC = FIT_IMEM(temp_PC); \
+    STEP_LOG(); \
+    DISPATCH(); }
+#else
+#define SU_OP(handler)  case SU_##handler
+#define NEXT            break
+#endif
+
+/*
+ * GCC cannot see a "Fall through." comment through the SU_OP() macro.
+ */
+#if defined(__GNUC__) && (__GNUC__ >= 7)
+#define FALL_THROUGH    __attribute__((fallthrough))
+#else
+#define FALL_THROUGH
+#endif
+
 NOINLINE void run_task(void)
 {
+#ifdef SU_THREADED_DISPATCH
+    __extension__
+    static const void * const handlers[NUMBER_OF_SU_HANDLERS] = {
+        &&op_SLL   ,&&op_SRL   ,&&op_SRA   ,&&op_SLLV  ,
+        &&op_SRLV  ,&&op_SRAV  ,&&op_JR    ,&&op_JALR  ,
+        &&op_BREAK ,&&op_ADDU  ,&&op_SUBU  ,&&op_AND   ,
+        &&op_OR    ,&&op_XOR   ,&&op_NOR   ,&&op_SLT   ,
+        &&op_SLTU  ,
+        &&op_BLTZ  ,&&op_BGEZ  ,&&op_BLTZAL,&&op_BGEZAL,
+        &&op_J     ,&&op_JAL   ,&&op_BEQ   ,&&op_BNE   ,
+        &&op_BLEZ  ,&&op_BGTZ  ,
+        &&op_ADDIU ,&&op_SLTI  ,&&op_SLTIU ,&&op_ANDI  ,
+        &&op_ORI   ,&&op_XORI  ,&&op_LUI   ,
+        &&op_MFC0  ,&&op_MTC0  ,&&op_MFC2  ,&&op_CFC2  ,
+        &&op_MTC2  ,&&op_CTC2  ,&&op_VECTOR,
+        &&op_LB    ,&&op_LH    ,&&op_LW    ,&&op_LBU   ,
+        &&op_LHU   ,&&op_SB    ,&&op_SH    ,&&op_SW    ,
+        &&op_LWC2  ,&&op_SWC2  ,
+        &&op_RESERVED,
+        &&op_LUI_ORI,&&op_ADDIU_BNE,&&op_LQV_LRV,&&op_VECTOR_VECTOR,
+        &&op_VMUDL_VMADH,&&op_VMULF_VMACF,&&op_VMUL_PAIR,
+        &&op_SPIN_LOOP,
+    };
+#endif
     register u32 PC;
+    register const decoded_inst * inst;
 
     PC = FIT_IMEM(GET_RCP_REG(SP_PC_REG));
+#ifdef SU_X64_JIT
+    recompile(PC);
+    ENTER_BLOCK();
+#endif
     for (;;) {
-        inst_word = *(pi32)(IMEM + FIT_IMEM(PC));
+        inst = &decoded_IMEM[FIT_IMEM(PC) / 4];
 #ifdef EMULATE_STATIC_PC
         PC = (PC + 0x004);
+#ifndef SU_THREADED_DISPATCH
 EX:
 #endif
-#ifdef SP_EXECUTE_LOG
-        step_SP_commands(inst_word);
 #endif
+        STEP_LOG();
 
 #if (0 != 0)
         if (GET_RCP_REG(SP_STATUS_REG) & SP_STATUS_HALT)
             goto RSP_halted_CPU_exit_point; /* Only BREAK and COP0 set this. */
         SR[zero] = 0x00000000; /* already handled on per-instruction basis */
 #endif
-        switch (inst_word >> 26) {
-        case 000: /* SPECIAL */
-            switch (SPECIAL(inst_word, PC)) {
-            case -1: /* BREAK */
-                goto RSP_halted_CPU_exit_point;
-            case +1: /* JR and JALR */
+        switch (inst -> op) {
+        SU_OP(SLL):
+            SR[inst -> rd] = SR[inst -> rt] << MASK_SA(inst -> sa);
+            SR[zero] = 0x00000000;
+            NEXT;
+        SU_OP(SRL):
+            SR[inst -> rd] = (u32)(SR[inst -> rt]) >> MASK_SA(inst -> sa);
+            SR[zero] = 0x00000000;
+            NEXT;
+        SU_OP(SRA):
+            SR[inst -> rd] = (s32)(SR[inst -> rt]) >> MASK_SA(inst -> sa);
+            SR[zero] = 0x00000000;
+            NEXT;
+        SU_OP(SLLV):
+            SR[inst -> rd] = SR[inst -> rt] << MASK_SA(SR[inst -> rs]);
+            SR[zero] = 0x00000000;
+            NEXT;
+        SU_OP(SRLV):
+            SR[inst -> rd] = (u32)(SR[inst -> rt]) >> MASK_SA(SR[inst -> rs]);
+            SR[zero] = 0x00000000;
+            NEXT;
+        SU_OP(SRAV):
+            SR[inst -> rd] = (s32)(SR[inst -> rt]) >> MASK_SA(SR[inst -> rs]);
+            SR[zero] = 0x00000000;
+            NEXT;
+        SU_OP(JALR):
+            SR[inst -> rd] = FIT_IMEM(PC + LINK_OFF);
+            SR[zero] = 0x00000000;
+            FALL_THROUGH;
+        SU_OP(JR):
+            set_PC(SR[inst -> rs]);
+            JUMP;
+        SU_OP(BREAK):
+            BREAK();
+            goto RSP_halted_CPU_exit_point;
+        SU_OP(ADDU):
+            SR[inst -> rd] = SR[inst -> rs] + SR[inst -> rt];
+            SR[zero] = 0x00000000; /* needed for Rareware micro-codes */
+            NEXT;
+        SU_OP(SUBU):
+            SR[inst -> rd] = SR[inst -> rs] - SR[inst -> rt];
+            SR[zero] = 0x00000000;
+            NEXT;
+        SU_OP(AND):
+            SR[inst -> rd] = SR[inst -> rs] & SR[inst -> rt];
+            SR[zero] = 0x00000000; /* needed for Rareware micro-codes */
+            NEXT;
+        SU_OP(OR):
+            SR[inst -> rd] = SR[inst -> rs] | SR[inst -> rt];
+            SR[zero] = 0x00000000;
+            NEXT;
+        SU_OP(XOR):
+            SR[inst -> rd] = SR[inst -> rs] ^ SR[inst -> rt];
+            SR[zero] = 0x00000000;
+            NEXT;
+        SU_OP(NOR):
+            SR[inst -> rd] = ~(SR[inst -> rs] | SR[inst -> rt]);
+            SR[zero] = 0x00000000;
+            NEXT;
+        SU_OP(SLT):
+            SR[inst -> rd] = ((s32)(SR[inst -> rs]) < (s32)(SR[inst -> rt]));
+            SR[zero] = 0x00000000;
+            NEXT;
+        SU_OP(SLTU):
+            SR[inst -> rd] = ((u32)(SR[inst -> rs]) < (u32)(SR[inst -> rt]));
+            SR[zero] = 0x00000000;
+            NEXT;
+        SU_OP(BLTZAL):
+            SR[ra] = FIT_IMEM(PC + LINK_OFF);
+            FALL_THROUGH;
+        SU_OP(BLTZ):
+            if (BLTZ(inst -> rs, inst -> imm, PC) != 0)
                 JUMP;
-            }
-            break;
-        case 001: /* REGIMM */
-            if (REGIMM(inst_word, PC) != 0)
+            NEXT;
+        SU_OP(BGEZAL):
+            SR[ra] = FIT_IMEM(PC + LINK_OFF);
+            FALL_THROUGH;
+        SU_OP(BGEZ):
+            if (BGEZ(inst -> rs, inst -> imm, PC) != 0)
                 JUMP;
-            break;
-        case 002:
-            J(inst_word);
+            NEXT;
+        SU_OP(J):
+            J(inst -> imm);
             JUMP;
-        case 003:
-            JAL(inst_word, PC);
+        SU_OP(JAL):
+            JAL(inst -> imm, PC);
             JUMP;
-        case 004:
-            if (BEQ(inst_word, PC) != 0)
+        SU_OP(BEQ):
+            if (BEQ(inst -> rs, inst -> rt, inst -> imm, PC) != 0)
                 JUMP;
-            break;
-        case 005:
-            if (BNE(inst_word, PC) != 0)
+            NEXT;
+        SU_OP(BNE):
+            if (BNE(inst -> rs, inst -> rt, inst -> imm, PC) != 0)
                 JUMP;
-            break;
-        case 006:
-            if (BLEZ(inst_word, PC) != 0)
+            NEXT;
+        SU_OP(BLEZ):
+            if (BLEZ(inst -> rs, inst -> imm, PC) != 0)
                 JUMP;
-            break;
-        case 007:
-            if (BGTZ(inst_word, PC) != 0)
+            NEXT;
+        SU_OP(BGTZ):
+            if (BGTZ(inst -> rs, inst -> imm, PC) != 0)
                 JUMP;
-            break;
-        case 010: /* ADDI:  Traps don't exist on the RCP. */
-        case 011:
-            ADDIU(inst_word);
-            break;
-        case 012:
-            SLTI(inst_word);
-            break;
-        case 013:
-            SLTIU(inst_word);
-            break;
-        case 014:
-            ANDI(inst_word);
-            break;
-        case 015:
-            ORI(inst_word);
-            break;
-        case 016:
-            XORI(inst_word);
-            break;
-        case 017:
-            LUI(inst_word);
-            break;
-        case 020:
-            COP0(inst_word);
+            NEXT;
+        SU_OP(ADDIU):
+            ADDIU(inst -> rt, inst -> rs, inst -> imm);
+            NEXT;
+        SU_OP(SLTI):
+            SLTI(inst -> rt, inst -> rs, inst -> imm);
+            NEXT;
+        SU_OP(SLTIU):
+            SLTIU(inst -> rt, inst -> rs, inst -> imm);
+            NEXT;
+        SU_OP(ANDI):
+            ANDI(inst -> rt, inst -> rs, inst -> imm);
+            NEXT;
+        SU_OP(ORI):
+            ORI(inst -> rt, inst -> rs, inst -> imm);
+            NEXT;
+        SU_OP(XORI):
+            XORI(inst -> rt, inst -> rs, inst -> imm);
+            NEXT;
+        SU_OP(LUI):
+            LUI(inst -> rt, inst -> imm);
+            NEXT;
+        SU_OP(MFC0):
+            SP_CP0_MF(inst -> rt, inst -> rd);
             if (GET_RCP_REG(SP_STATUS_REG) & SP_STATUS_HALT)
                 goto RSP_halted_CPU_exit_point;
-            break;
-        case 022:
-            COP2(inst_word);
-            break;
-        case 040:
-            LB(inst_word);
-            break;
-        case 041:
-            LH(inst_word);
-            break;
-        case 043:
-            LW(inst_word);
-            break;
-        case 044:
-            LBU(inst_word);
-            break;
-        case 045:
-            LHU(inst_word);
-            break;
-        case 050:
-            SB(inst_word);
-            break;
-        case 051:
-            SH(inst_word);
-            break;
-        case 053:
-            SW(inst_word);
-            break;
-        case 062: /* LWC2 */
-            MWC2_load(inst_word);
-            break;
-        case 072: /* SWC2 */
-            MWC2_store(inst_word);
-            break;
-        default:
+            NEXT;
+        SU_OP(MTC0):
+            SP_CP0_MT[inst -> rd](inst -> rt);
+            if (GET_RCP_REG(SP_STATUS_REG) & SP_STATUS_HALT)
+                goto RSP_halted_CPU_exit_point;
+            NEXT;
+        SU_OP(MFC2):
+            MFC2(inst -> rt, inst -> rd, inst -> e);
+            NEXT;
+        SU_OP(CFC2):
+            CFC2(inst -> rt, inst -> rd);
+            NEXT;
+        SU_OP(MTC2):
+            MTC2(inst -> rt, inst -> rd, inst -> e);
+            NEXT;
+        SU_OP(CTC2):
+            CTC2(inst -> rt, inst -> rd);
+            NEXT;
+        SU_OP(VECTOR):
+            inst_word = inst -> word; /* VRCP, VSAR and others decode it. */
+            COP2(inst -> rs, inst -> sa, inst -> rd, inst -> rt, inst -> func);
+            NEXT;
+        SU_OP(LB):
+            LB(inst -> rt, inst -> rs, inst -> imm);
+            NEXT;
+        SU_OP(LH):
+            LH(inst -> rt, inst -> rs, inst -> imm);
+            NEXT;
+        SU_OP(LW):
+            LW(inst -> rt, inst -> rs, inst -> imm);
+            NEXT;
+        SU_OP(LBU):
+            LBU(inst -> rt, inst -> rs, inst -> imm);
+            NEXT;
+        SU_OP(LHU):
+            LHU(inst -> rt, inst -> rs, inst -> imm);
+            NEXT;
+        SU_OP(SB):
+            SB(inst -> rt, inst -> rs, inst -> imm);
+            NEXT;
+        SU_OP(SH):
+            SH(inst -> rt, inst -> rs, inst -> imm);
+            NEXT;
+        SU_OP(SW):
+            SW(inst -> rt, inst -> rs, inst -> imm);
+            NEXT;
+        SU_OP(LWC2):
+            LWC2[inst -> rd](inst -> rt, inst -> e, inst -> imm, inst -> rs);
+            NEXT;
+        SU_OP(SWC2):
+            SWC2[inst -> rd](inst -> rt, inst -> e, inst -> imm, inst -> rs);
+            NEXT;
+        SU_OP(RESERVED):
             res_S();
+            NEXT;
+
+        SU_OP(LUI_ORI):
+            LUI(inst -> rt, inst -> imm);
+            ++inst;
+            PC = (PC + 0x004);
+            ORI(inst -> rt, inst -> rs, inst -> imm);
+            NEXT;
+        SU_OP(ADDIU_BNE):
+            ADDIU(inst -> rt, inst -> rs, inst -> imm);
+            ++inst;
+            PC = (PC + 0x004);
+            if (BNE(inst -> rs, inst -> rt, inst -> imm, PC) != 0)
+                JUMP;
+            NEXT;
+        SU_OP(LQV_LRV):
+            LWC2[004](inst -> rt, inst -> e, inst -> imm, inst -> rs);
+            ++inst;
+            PC = (PC + 0x004);
+            LWC2[005](inst -> rt, inst -> e, inst -> imm, inst -> rs);
+            NEXT;
+        SU_OP(VECTOR_VECTOR):
+            inst_word = inst -> word;
+            COP2(inst -> rs, inst -> sa, inst -> rd, inst -> rt, inst -> func);
+            ++inst;
+            PC = (PC + 0x004);
+            inst_word = inst -> word;
+            COP2(inst -> rs, inst -> sa, inst -> rd, inst -> rt, inst -> func);
+            NEXT;
+        SU_OP(VMUDL_VMADH):
+#ifdef SU_FUSE_MULTIPLIES
+            run_mul_32x32(inst);
+            PC = (PC + 0x00C);
+#else
+            inst_word = inst -> word;
+            COP2(inst -> rs, inst -> sa, inst -> rd, inst -> rt, inst -> func);
+#endif
+            NEXT;
+        SU_OP(VMULF_VMACF):
+#ifdef SU_FUSE_MULTIPLIES
+            run_mulf_macf(inst);
+            PC = (PC + 0x004);
+#else
+            inst_word = inst -> word;
+            COP2(inst -> rs, inst -> sa, inst -> rd, inst -> rt, inst -> func);
+#endif
+            NEXT;
+        SU_OP(VMUL_PAIR):
+#ifdef SU_FUSE_MULTIPLIES
+            run_mul_pair(inst);
+            PC = (PC + 0x004);
+#else
+            inst_word = inst -> word;
+            COP2(inst -> rs, inst -> sa, inst -> rd, inst -> rt, inst -> func);
+#endif
+            NEXT;
+
+        SU_OP(SPIN_LOOP):
+#ifdef SU_YIELD_SPIN_LOOPS
+            if (spin_loops_again(inst, PC) != 0) {
+                GET_RCP_REG(SP_STATUS_REG) |= SP_STATUS_HALT;
+                PC = FIT_IMEM(temp_PC); /* Poll again from the top when restarted. */
+                goto RSP_halted_CPU_exit_point;
+            }
+#endif
+            NEXT;
         }
 
 #ifndef EMULATE_STATIC_PC
@@ -2083,12 +3027,22 @@ EX:
         }
 #else
         continue;
+#ifndef SU_THREADED_DISPATCH
 set_branch_delay:
-        inst_word = *(pi32)(IMEM + FIT_IMEM(PC));
+        inst = &decoded_IMEM[FIT_IMEM(PC) / 4];
         PC = FIT_IMEM(temp_PC);
         goto EX;
+#endif
 #endif
     }
+#ifdef SU_X64_JIT
+recompiled_block:
+    PC = recompiled[FIT_IMEM(PC) / 4]();
+    if (GET_RCP_REG(SP_STATUS_REG) & SP_STATUS_HALT)
+        goto RSP_halted_CPU_exit_point;
+    recompile(PC);
+    NEXT;
+#endif
 RSP_halted_CPU_exit_point:
     GET_RCP_REG(SP_PC_REG) = 0x04001000 | FIT_IMEM(PC);
 
@@ -21,6 +21,7 @@
 
 #include "my_types.h"
 #include "rsp.h"
+#include "vu/vu.h"
 
 #define SEMAPHORE_LOCK_CORRECTIONS
 #define WAIT_FOR_CPU_HOST
@@ -30,13 +31,6 @@
 #define VU_EMULATE_SCALAR_ACCUMULATOR_READ
 #endif
 
-/*
- * Currently, the plugin system this module is written for doesn't notify us
- * of how much RDRAM is installed to the system, so we'll use signal handlers
- * to catch memory segment access faults in the trial search to find it out.
- */
-extern unsigned long su_max_address;
-
 /*
  * Interact with memory using server-side byte order (MIPS big-endian) or
  * client-side (VM host's) native byte order on a 32-bit boundary.
@@ -69,6 +63,43 @@ extern unsigned long su_max_address;
 #define EMULATE_STATIC_PC
 #endif
 
+/*
+ * With GCC or Clang, run_task() can use label addresses ("labels as values")
+ * so that each handler jumps straight into the next one, instead of all of
+ * them returning to one shared `switch` jump for the host CPU to mispredict.
+ *
+ * Define SU_SWITCH_DISPATCH to build the portable `switch` loop instead.
+ * Threaded dispatch is only written for the static branch delay slot model.
+ */
+#if defined(__GNUC__) && defined(EMULATE_STATIC_PC)
+#if !defined(SU_SWITCH_DISPATCH)
+#define SU_THREADED_DISPATCH
+#endif
+#endif
+
+/*
+ * Optionally recompile IMEM basic blocks to x86-64 machine code (JIT=1 with
+ * the Unix makefile).  Whatever the recompiler does not translate still runs
+ * in the threaded interpreter, which is also the only fall-back this needs.
+ *
+ * Recompiled vector operations pass their operands in XMM registers, so this
+ * is only for the System V x86-64 calling convention (not Win64) with SSE2.
+ * The code it makes has the addresses of the registers built in, so it also
+ * cannot be shared by the per-thread contexts of RSP_REENTRANT (context.h).
+ * Task capture (module.h) has to count every instruction that runs, too.
+ */
+#if defined(SU_X64_JIT)
+#if !defined(__x86_64__) || defined(_WIN32) || !defined(ARCH_MIN_SSE2)
+#undef SU_X64_JIT
+#elif !defined(SU_THREADED_DISPATCH) || defined(SP_EXECUTE_LOG)
+#undef SU_X64_JIT
+#elif defined(SU_PROFILE_IDIOMS) || defined(RSP_REENTRANT)
+#undef SU_X64_JIT
+#elif defined(SP_CAPTURE_TASKS)
+#undef SU_X64_JIT
+#endif
+#endif
+
 #if (0 != 0)
 #define PROFILE_MODE    static NOINLINE
 #else
@@ -122,21 +153,6 @@ typedef enum {
     S8 = fp /* older name for GPR $fp as of the R4000 ISA */
 } GPR_specifier;
 
-extern RSP_INFO RSP_INFO_NAME;
-extern pu8 DRAM;
-extern pu8 DMEM;
-extern pu8 IMEM;
-
-extern u8 conf[];
-
-/*
- * general-purpose scalar registers
- *
- * based on the MIPS instruction set architecture but without most of the
- * original register names (for example, no kernel-reserved registers)
- */
-extern u32 SR[];
-
 #define FIT_IMEM(PC)    ((PC) & 0xFFFu & 0xFFCu)
 
 #ifdef EMULATE_STATIC_PC
@@ -155,20 +171,6 @@ extern u32 SR[];
 int stage;
 #endif
 
-#ifdef WAIT_FOR_CPU_HOST
-extern short MFC0_count[];
-/* Keep one C0 MF status read count for each scalar register. */
-#endif
-
-/*
- * The number of times to tolerate executing `MFC0    $at, $c4`.
- * Replace $at with any register--the timeout limit is per each.
- *
- * Set to a higher value to avoid prematurely quitting the interpreter.
- * Set to a lower value for speed...you could get away with 10 sometimes.
- */
-extern int MF_SP_STATUS_TIMEOUT;
-
 #define SLOT_OFF    ((BASE_OFF) + 0x000)
 #define LINK_OFF    ((BASE_OFF) + 0x004)
 extern void set_PC(unsigned int address);
@@ -288,13 +290,18 @@ typedef enum {
 
     NUMBER_OF_CP0_REGISTERS
 } CPR_specifier;
-extern pu32 CR[];
 
 extern void SP_DMA_READ(void);
 extern void SP_DMA_WRITE(void);
 
+/*
+ * Hand whatever list DPC_END was last moved to the end of over to the RDP,
+ * if that has not been done yet.
+ */
+extern void flush_RDP_queue(void);
+
 extern u16 rwR_VCE(void);
-extern void rwW_VCE(u16 VCE);
+extern void rwW_VCE(u16 vce);
 
 extern void MFC2(unsigned int rt, unsigned int vs, unsigned int e);
 extern void MTC2(unsigned int rt, unsigned int vd, unsigned int e);
@@ -320,6 +327,8 @@ extern void USW(unsigned int rs, u32 addr);
 NOINLINE extern void res_S(void);
 
 extern void SP_CP0_MF(unsigned int rt, unsigned int rd);
+extern void (*SP_CP0_MT[NUMBER_OF_CP0_REGISTERS])(unsigned int rt);
+extern void BREAK(void);
 
 /*
  * example syntax (basically the same for all LWC2/SWC2 ops):
@@ -388,6 +397,128 @@ extern void LTV(unsigned vt, unsigned element, signed offset, unsigned base);
 extern void SWV(unsigned vt, unsigned element, signed offset, unsigned base);
 extern void STV(unsigned vt, unsigned element, signed offset, unsigned base);
 
+/*
+ * Every IMEM word is kept predecoded into one of these handlers, with all the
+ * register specifiers and immediates the handler needs already split out.
+ */
+typedef enum {
+    SU_SLL = 0, /* must be zero so that a zero-filled slot decodes as NOP */
+    SU_SRL,
+    SU_SRA,
+    SU_SLLV,
+    SU_SRLV,
+    SU_SRAV,
+    SU_JR,
+    SU_JALR,
+    SU_BREAK,
+    SU_ADDU,
+    SU_SUBU,
+    SU_AND,
+    SU_OR,
+    SU_XOR,
+    SU_NOR,
+    SU_SLT,
+    SU_SLTU,
+
+    SU_BLTZ,
+    SU_BGEZ,
+    SU_BLTZAL,
+    SU_BGEZAL,
+
+    SU_J,
+    SU_JAL,
+    SU_BEQ,
+    SU_BNE,
+    SU_BLEZ,
+    SU_BGTZ,
+
+    SU_ADDIU,
+    SU_SLTI,
+    SU_SLTIU,
+    SU_ANDI,
+    SU_ORI,
+    SU_XORI,
+    SU_LUI,
+
+    SU_MFC0,
+    SU_MTC0,
+    SU_MFC2,
+    SU_CFC2,
+    SU_MTC2,
+    SU_CTC2,
+    SU_VECTOR,
+
+    SU_LB,
+    SU_LH,
+    SU_LW,
+    SU_LBU,
+    SU_LHU,
+    SU_SB,
+    SU_SH,
+    SU_SW,
+    SU_LWC2,
+    SU_SWC2,
+
+    SU_RESERVED,
+
+/*
+ * superinstructions:  two neighbouring instructions run from one dispatch
+ * (four for SU_VMUDL_VMADH, the 32-bit fixed-point multiply)
+ */
+    SU_LUI_ORI,
+    SU_ADDIU_BNE,
+    SU_LQV_LRV,
+    SU_VECTOR_VECTOR,
+    SU_VMUDL_VMADH,
+    SU_VMULF_VMACF,
+    SU_VMUL_PAIR,
+
+/*
+ * a backward branch closing a loop which only polls CP0 and so can never
+ * leave the loop without the CPU host first getting to run
+ */
+    SU_SPIN_LOOP,
+
+    NUMBER_OF_SU_HANDLERS
+} su_handler;
+
+/*
+ * out-of-line copies of the scalar loads and stores (SU_LB through SU_SW)
+ * for callers besides the interpreter loop
+ */
+extern void (*const scalar_memory_ops[SU_SW - SU_LB + 1])(
+    unsigned int rt,
+    unsigned int base,
+    s32 offset
+);
+
+/*
+ * Re-decode any IMEM slots whose instruction words have changed, unless the
+ * whole IMEM image can be found already predecoded in the IMEM image cache.
+ * Needed after anything besides the RSP itself might have written IMEM.
+ */
+extern void decode_IMEM(void);
+
+/*
+ * Whether decoding the instruction words of `slots` (all 1024 of them) from
+ * scratch gives exactly `slots` back.  decoded_IMEM[] is used to work in,
+ * then put back the way it was.
+ */
+extern int decodes_to(const decoded_inst * slots);
+
+#ifdef SU_PROFILE_IDIOMS
+/*
+ * With SU_PROFILE_IDIOMS (PROFILE_IDIOMS=1 with the Unix makefile), nothing
+ * is fused, and run_task() instead counts how often each pair and triple of
+ * handlers runs from consecutive IMEM slots.  The hottest of them are then
+ * written out as a text report (in the user cache directory, by way of
+ * cache_file() in module.h), to pick the next superinstructions from.
+ */
+#define IDIOM_PROFILE_FILE      "rsp_idioms.txt"
+
+NOINLINE extern void export_idiom_profile(const char * target);
+#endif
+
 NOINLINE extern void run_task(void);
 
 #endif
@@ -0,0 +1,141 @@
+/******************************************************************************\
+* Project:  RSP Task Trace Format                                              *
+* License:  CC0 Public Domain Dedication                                       *
+*                                                                              *
+* To the extent possible under law, the author(s) have dedicated all copyright *
+* and related and neighboring rights to this software to the public domain     *
+* worldwide. This software is distributed without any warranty.                *
+*                                                                              *
+* You should have received a copy of the CC0 Public Domain Dedication along    *
+* with this software.                                                          *
+* If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.             *
+\******************************************************************************/
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stddef.h>
+#include "my_types.h"
+
+/*
+ * A trace is what a build with SP_CAPTURE_TASKS (CAPTURE=1 with the Unix
+ * makefile) saw of every task it ran itself, to be run again without the
+ * core, a ROM or a graphics plugin by rsp-replay (replay.c).
+ *
+ * The file is one trace_header and then one record per task.  Everything
+ * is in the byte order of the host that wrote it, and DMEM and IMEM are in
+ * the host's layout of them (BES() and friends), so the file can be mapped
+ * and its records used in place.  Every record starts 8-byte aligned.
+ */
+#define TRACE_FILE      "rsp_tasks.trace"
+
+#define TRACE_MAGIC     "cxd4TRC"
+#define TRACE_VERSION   1
+
+typedef struct {
+    char magic[8];
+    u32 version;
+    u32 header_size; /* sizeof(trace_header), where the first record starts */
+    u32 byte_order; /* 0x01020304 written as a u32 */
+    u32 tasks; /* rewritten after each record */
+    u32 RDRAM_size; /* su_max_address + 1 */
+    u32 reserved;
+} trace_header;
+
+/*
+ * The RCP registers, in RSP_INFO order (MI_INTR, then SP, then DPC).
+ */
+enum {
+    TRACE_MI_INTR = 0,
+
+    TRACE_SP_MEM_ADDR,
+    TRACE_SP_DRAM_ADDR,
+    TRACE_SP_RD_LEN,
+    TRACE_SP_WR_LEN,
+    TRACE_SP_STATUS,
+    TRACE_SP_DMA_FULL,
+    TRACE_SP_DMA_BUSY,
+    TRACE_SP_PC,
+    TRACE_SP_SEMAPHORE,
+
+    TRACE_DPC_START,
+    TRACE_DPC_END,
+    TRACE_DPC_CURRENT,
+    TRACE_DPC_STATUS,
+    TRACE_DPC_CLOCK,
+    TRACE_DPC_BUFBUSY,
+    TRACE_DPC_PIPEBUSY,
+    TRACE_DPC_TMEM,
+
+    TRACE_REGISTERS
+};
+
+/*
+ * the RSP as the task found it, and hashes of what it left behind
+ *
+ * `steps` is how many instructions the task ran when it was captured, with
+ * the superinstructions turned off so that each one counted for itself.
+ *
+ * After the record come `reads` trace_span headers, each followed by the
+ * bytes SP_DMA_READ() took from RDRAM there (padded to 8 bytes), then the
+ * `writes` trace_span headers of the RDRAM written by SP_DMA_WRITE(), in
+ * the order they were read or written.  RDRAM_hash hashes each of the
+ * written spans, in that order, as the task left them.
+ */
+typedef struct {
+    u32 record_size; /* from the start of this record to the next one */
+    u32 reads;
+    u32 writes;
+    u32 cycles; /* what the core passed to DoRspCycles() */
+    u64 steps;
+
+    u64 DMEM_hash;
+    u64 IMEM_hash;
+    u64 RDRAM_hash;
+
+/*
+ * The members are named apart from the context's (context.h), whose names
+ * are macros.
+ */
+    u32 regs[TRACE_REGISTERS];
+    u32 scalars[32];
+    i16 vectors[32][8];
+    i16 acc[3][8]; /* high, middle and low 16 bits of each element */
+    u16 vco;
+    u16 vcc;
+    u8 vce;
+    u8 reserved[3];
+    s32 div_in;
+    s32 div_out;
+    s32 div_high; /* DPH */
+    s32 status_timeout; /* MF_SP_STATUS_TIMEOUT */
+    s16 status_reads[32]; /* MFC0_count */
+
+    u8 imem[4096];
+    u8 dmem[4096];
+} trace_task;
+
+typedef struct {
+    u32 address;
+    u32 length;
+} trace_span;
+
+#define TRACE_PADDED(length)    (((length) + 7) & ~(u32)7)
+
+/*
+ * 64-bit FNV-1a, carried on from `hash` (TRACE_HASH_SEED to start with)
+ */
+#define TRACE_HASH_SEED     ((u64)0xCBF29CE4ul << 32 | 0x84222325ul)
+#define TRACE_HASH_PRIME    ((u64)0x00000100ul << 32 | 0x000001B3ul)
+
+static INLINE u64 trace_hash(u64 hash, const void * data, size_t length)
+{
+    const u8 * bytes = (const u8 *)data;
+    register size_t i;
+
+    for (i = 0; i < length; i++)
+        hash = (hash ^ bytes[i]) * TRACE_HASH_PRIME;
+    return (hash);
+}
+
+#endif
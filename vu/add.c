@@ -25,7 +25,7 @@ static INLINE void SIGNED_CLAMP_ADD(pi16 VD, pi16 VS, pi16 VT)
 
     src = _mm_load_si128((v16 *)VS);
     dst = _mm_load_si128((v16 *)VT);
-    vco = _mm_load_si128((v16 *)cf_co);
+    vco = _mm_srli_epi16(flags_to_mask(VCO), 15);
 
 /*
  * Due to premature clamping in between adds, sometimes we need to add the
@@ -47,7 +47,7 @@ static INLINE void SIGNED_CLAMP_SUB(pi16 VD, pi16 VS, pi16 VT)
 
     src = _mm_load_si128((v16 *)VS);
     dst = _mm_load_si128((v16 *)VT);
-    vco = _mm_load_si128((v16 *)cf_co);
+    vco = _mm_srli_epi16(flags_to_mask(VCO), 15);
 
     res = _mm_subs_epi16(src, dst);
 
@@ -73,11 +73,12 @@ static INLINE void SIGNED_CLAMP_SUB(pi16 VD, pi16 VS, pi16 VT)
 static INLINE void SIGNED_CLAMP_ADD(pi16 VD, pi16 VS, pi16 VT)
 {
     i32 sum[N];
-    i16 hi[N], lo[N];
+    i16 hi[N], lo[N], co[N];
     register unsigned int i;
 
+    flags_to_bools(co, VCO);
     for (i = 0; i < N; i++)
-        sum[i] = VS[i] + VT[i] + cf_co[i];
+        sum[i] = VS[i] + VT[i] + co[i];
     for (i = 0; i < N; i++)
         lo[i] = (sum[i] + 0x8000) >> 31;
     for (i = 0; i < N; i++)
@@ -94,11 +95,12 @@ static INLINE void SIGNED_CLAMP_ADD(pi16 VD, pi16 VS, pi16 VT)
 static INLINE void SIGNED_CLAMP_SUB(pi16 VD, pi16 VS, pi16 VT)
 {
     i32 dif[N];
-    i16 hi[N], lo[N];
+    i16 hi[N], lo[N], co[N];
     register unsigned int i;
 
+    flags_to_bools(co, VCO);
     for (i = 0; i < N; i++)
-        dif[i] = VS[i] - VT[i] - cf_co[i];
+        dif[i] = VS[i] - VT[i] - co[i];
     for (i = 0; i < N; i++)
         lo[i] = (dif[i] + 0x8000) >> 31;
     for (i = 0; i < N; i++)
@@ -114,31 +116,45 @@ static INLINE void SIGNED_CLAMP_SUB(pi16 VD, pi16 VS, pi16 VT)
 }
 #endif
 
-INLINE static void clr_ci(pi16 VD, pi16 VS, pi16 VT)
-{ /* clear CARRY and carry in to accumulators */
+INLINE static void add_ci(pi16 VD, pi16 VS, pi16 VT)
+{ /* carry in to accumulators */
+    i16 co[N];
     register unsigned int i;
 
+    flags_to_bools(co, VCO);
     for (i = 0; i < N; i++)
-        VACC_L[i] = VS[i] + VT[i] + cf_co[i];
+        VACC_L[i] = VS[i] + VT[i] + co[i];
     SIGNED_CLAMP_ADD(VD, VS, VT);
-
- /* CTC2    $0, $vco # zeroing RSP flags VCF[0] */
-    vector_wipe(cf_ne);
-    vector_wipe(cf_co);
     return;
 }
 
-INLINE static void clr_bi(pi16 VD, pi16 VS, pi16 VT)
-{ /* clear CARRY and borrow in to accumulators */
+INLINE static void sub_bi(pi16 VD, pi16 VS, pi16 VT)
+{ /* borrow in to accumulators */
+    i16 co[N];
     register unsigned int i;
 
+    flags_to_bools(co, VCO);
     for (i = 0; i < N; i++)
-        VACC_L[i] = VS[i] - VT[i] - cf_co[i];
+        VACC_L[i] = VS[i] - VT[i] - co[i];
     SIGNED_CLAMP_SUB(VD, VS, VT);
+    return;
+}
+
+INLINE static void clr_ci(pi16 VD, pi16 VS, pi16 VT)
+{ /* clear CARRY and carry in to accumulators */
+    add_ci(VD, VS, VT);
 
  /* CTC2    $0, $vco # zeroing RSP flags VCF[0] */
-    vector_wipe(cf_ne);
-    vector_wipe(cf_co);
+    VCO = 0x0000;
+    return;
+}
+
+INLINE static void clr_bi(pi16 VD, pi16 VS, pi16 VT)
+{ /* clear CARRY and borrow in to accumulators */
+    sub_bi(VD, VS, VT);
+
+ /* CTC2    $0, $vco # zeroing RSP flags VCF[0] */
+    VCO = 0x0000;
     return;
 }
 
@@ -183,6 +199,7 @@ INLINE static void do_abs(pi16 VD, pi16 VS, pi16 VT)
 INLINE static void set_co(pi16 VD, pi16 VS, pi16 VT)
 { /* set CARRY and carry out from sum */
     i32 sum[N];
+    i16 co[N];
     register unsigned int i;
 
     for (i = 0; i < N; i++)
@@ -191,15 +208,16 @@ INLINE static void set_co(pi16 VD, pi16 VS, pi16 VT)
         VACC_L[i] = VS[i] + VT[i];
     vector_copy(VD, VACC_L);
 
-    vector_wipe(cf_ne);
     for (i = 0; i < N; i++)
-        cf_co[i] = sum[i] >> 16; /* native:  (sum[i] > +65535) */
+        co[i] = sum[i] >> 16; /* native:  (sum[i] > +65535) */
+    VCO = (u16)bools_to_flags(co); /* NOTEQUAL is cleared. */
     return;
 }
 
 INLINE static void set_bo(pi16 VD, pi16 VS, pi16 VT)
 { /* set CARRY and borrow out from difference */
     i32 dif[N];
+    i16 ne[N], co[N];
     register unsigned int i;
 
     for (i = 0; i < N; i++)
@@ -207,9 +225,30 @@ INLINE static void set_bo(pi16 VD, pi16 VS, pi16 VT)
     for (i = 0; i < N; i++)
         VACC_L[i] = VS[i] - VT[i];
     for (i = 0; i < N; i++)
-        cf_ne[i] = (VS[i] != VT[i]);
+        ne[i] = (VS[i] != VT[i]);
+    for (i = 0; i < N; i++)
+        co[i] = (dif[i] < 0);
+    VCO = (u16)(bools_to_flags(ne) << 8 | bools_to_flags(co));
+    vector_copy(VD, VACC_L);
+    return;
+}
+
+INLINE static void add_nc(pi16 VD, pi16 VS, pi16 VT)
+{ /* VADDC without the carry out, for when nothing reads $vco */
+    register unsigned int i;
+
     for (i = 0; i < N; i++)
-        cf_co[i] = (dif[i] < 0);
+        VACC_L[i] = VS[i] + VT[i];
+    vector_copy(VD, VACC_L);
+    return;
+}
+
+INLINE static void sub_nb(pi16 VD, pi16 VS, pi16 VT)
+{ /* VSUBC without the borrow out, for when nothing reads $vco */
+    register unsigned int i;
+
+    for (i = 0; i < N; i++)
+        VACC_L[i] = VS[i] - VT[i];
     vector_copy(VD, VACC_L);
     return;
 }
@@ -339,6 +378,110 @@ VECTOR_OPERATION VSUBC(v16 vs, v16 vt)
 #endif
 }
 
+/*
+ * the same operations for when the $vco they set is found to be overwritten
+ * before anything could read it (see the flag liveness pass in su.c)
+ */
+VECTOR_OPERATION VADD_NF(v16 vs, v16 vt)
+{
+    ALIGNED i16 VD[N];
+#ifdef ARCH_MIN_SSE2
+    ALIGNED i16 VS[N], VT[N];
+
+    *(v16 *)VS = vs;
+    *(v16 *)VT = vt;
+#else
+    v16 VS, VT;
+
+    VS = vs;
+    VT = vt;
+#endif
+    add_ci(VD, VS, VT);
+#ifdef ARCH_MIN_SSE2
+    COMPILER_FENCE();
+    vs = *(v16 *)VD;
+    return (vs);
+#else
+    vector_copy(V_result, VD);
+    return;
+#endif
+}
+
+VECTOR_OPERATION VSUB_NF(v16 vs, v16 vt)
+{
+    ALIGNED i16 VD[N];
+#ifdef ARCH_MIN_SSE2
+    ALIGNED i16 VS[N], VT[N];
+
+    *(v16 *)VS = vs;
+    *(v16 *)VT = vt;
+#else
+    v16 VS, VT;
+
+    VS = vs;
+    VT = vt;
+#endif
+    sub_bi(VD, VS, VT);
+#ifdef ARCH_MIN_SSE2
+    COMPILER_FENCE();
+    vs = *(v16 *)VD;
+    return (vs);
+#else
+    vector_copy(V_result, VD);
+    return;
+#endif
+}
+
+VECTOR_OPERATION VADDC_NF(v16 vs, v16 vt)
+{
+    ALIGNED i16 VD[N];
+#ifdef ARCH_MIN_SSE2
+    ALIGNED i16 VS[N], VT[N];
+
+    *(v16 *)VS = vs;
+    *(v16 *)VT = vt;
+#else
+    v16 VS, VT;
+
+    VS = vs;
+    VT = vt;
+#endif
+    add_nc(VD, VS, VT);
+#ifdef ARCH_MIN_SSE2
+    COMPILER_FENCE();
+    vs = *(v16 *)VD;
+    return (vs);
+#else
+    vector_copy(V_result, VD);
+    return;
+#endif
+}
+
+VECTOR_OPERATION VSUBC_NF(v16 vs, v16 vt)
+{
+    ALIGNED i16 VD[N];
+#ifdef ARCH_MIN_SSE2
+    ALIGNED i16 VS[N], VT[N];
+
+    *(v16 *)VS = vs;
+    *(v16 *)VT = vt;
+#else
+    v16 VS, VT;
+
+    VS = vs;
+    VT = vt;
+#endif
+    sub_nb(VD, VS, VT);
+#ifdef ARCH_MIN_SSE2
+    COMPILER_FENCE();
+    vs = *(v16 *)VD;
+    return (vs);
+#else
+    vector_copy(V_result, VD);
+    return;
+#endif
+}
+
 VECTOR_OPERATION VSAW(v16 vs, v16 vt)
 {
     unsigned int element;
@@ -354,7 +497,14 @@ VECTOR_OPERATION VSAW(v16 vs, v16 vt)
         vector_wipe(V_result);
 #endif
     } else {
-#ifdef ARCH_MIN_SSE2
+#if defined(VU_WIDE_ACCUMULATOR)
+        ALIGNED i16 slice[N];
+        register unsigned int i;
+
+        for (i = 0; i < N; i++)
+            slice[i] = (element == HI) ? ACC_H(i) : ACC_M(i);
+        vs = (element == LO) ? *(v16 *)VACC_L : *(v16 *)slice;
+#elif defined(ARCH_MIN_SSE2)
         vs = *(v16 *)VACC[element];
 #else
         vector_copy(V_result, VACC[element]);
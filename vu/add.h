@@ -31,4 +31,13 @@ VECTOR_EXTERN
 VECTOR_EXTERN
     VSAW   (v16 vs, v16 vt);
 
+VECTOR_EXTERN
+    VADD_NF (v16 vs, v16 vt);
+VECTOR_EXTERN
+    VSUB_NF (v16 vs, v16 vt);
+VECTOR_EXTERN
+    VADDC_NF(v16 vs, v16 vt);
+VECTOR_EXTERN
+    VSUBC_NF(v16 vs, v16 vt);
+
 #endif
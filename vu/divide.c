@@ -15,8 +15,16 @@
 
 #include "divide.h"
 
-static s32 DivIn = 0; /* buffered numerator of division read from vector file */
-static s32 DivOut = 0; /* global division result set by VRCP/VRCPL/VRSQ/VRSQL */
+#if defined(_MSC_VER) && !defined(__GNUC__)
+#include <intrin.h>
+#endif
+
+/*
+ * DivIn:  buffered numerator of division read from vector file
+ * DivOut:  global division result set by VRCP/VRCPL/VRSQ/VRSQL
+ *
+ * Both of these, and DPH below, are kept in the rsp_context.
+ */
 
 enum {
     SP_DIV_SQRT_NO,
@@ -37,7 +45,6 @@ enum {
  * else if (lastDivideOp == VMOV, VNOP)
  *     DPH = DPH; // no change--divide-group ops but not real divides
  */
-static int DPH = SP_DIV_PRECISION_SINGLE;
 
 /*
  * 11-bit vector divide result look-up table
@@ -1070,9 +1077,38 @@ static const u16 div_ROM[1 << 10] = {
     0x6A64u,
 };
 
-NOINLINE static void do_div(i32 data, int sqrt, int precision)
+/*
+ * the number of 0 bits above the most significant 1 bit of a nonzero `x`
+ */
+static INLINE unsigned int leading_zeros(u32 x)
+{
+#if defined(__GNUC__)
+    return (unsigned int)__builtin_clz(x);
+#elif defined(_MSC_VER)
+    unsigned long index;
+
+    _BitScanReverse(&index, x);
+    return (unsigned int)(index ^ 31);
+#else
+    unsigned int count;
+
+    for (count = 0; (x & 0x80000000ul) == 0; x <<= 1)
+        count++;
+    return (count);
+#endif
+}
+
+/*
+ * the 32-bit result of dividing 1 by `input` or by its square root
+ *
+ * The callers save it to DivOut themselves, as the next VRCPH or VRSQH reads
+ * its upper half.
+ */
+static INLINE i32 do_div(i32 input, int sqrt, int precision)
 {
-    i32 addr;
+    i32 data = input;
+    u32 addr;
+    u32 result;
     int shift;
 
 #if ((~0 >> 1 == -1) && (0))
@@ -1092,14 +1128,15 @@ NOINLINE static void do_div(i32 data, int sqrt, int precision)
 /*
  * Note, from the code just above, that data cannot be negative.
  * (data >= 0) is unconditionally forced by the above algorithm.
+ *
+ * The ROM is indexed by the 9 bits after the leading 1 bit of the input.
  */
-    addr = data;
     if (data == 0x00000000) {
         shift = (precision == SP_DIV_PRECISION_SINGLE) ? 16 : 0;
-        addr = addr << shift;
+        addr = 0x00000000;
     } else {
-        for (shift = 0; addr >= 0x00000000; addr <<= 1, shift++)
-            ;
+        shift = (int)leading_zeros((u32)data);
+        addr = (u32)data << shift;
     }
     addr = (addr >> 22) & 0x000001FF;
 
@@ -1109,16 +1146,43 @@ NOINLINE static void do_div(i32 data, int sqrt, int precision)
     }
     shift ^= 31; /* flipping shift direction from left- to right- */
     shift >>= (sqrt == SP_DIV_SQRT_YES);
-    DivOut = (0x40000000UL | ((u32)div_ROM[addr] << 14)) >> shift;
-    if (DivIn == 0) /* corner case:  overflow via division by zero */
-        DivOut = +0x7FFFFFFFl;
-    else if (DivIn == -32768) /* corner case:  signed underflow barrier */
-        DivOut = -0x00010000l;
-    else
-        DivOut ^= (DivIn < 0) ? ~0 : 0;
-    return;
+    result = (0x40000000UL | ((u32)div_ROM[addr] << 14)) >> shift;
+    if (input == 0) /* corner case:  overflow via division by zero */
+        return +0x7FFFFFFFl;
+    if (input == -32768) /* corner case:  signed underflow barrier */
+        return -0x00010000l;
+    return (i32)(result ^ ((input < 0) ? ~0u : 0u));
 }
 
+/*
+ * Every operation in the divide group writes vt to the accumulator and one
+ * element of VR[vd] (the same register and element numbers, for the result
+ * and source fields), with the rest of VR[vd] unchanged.
+ *
+ * With SSE2 we merge the element into the old VR[vd] in registers instead of
+ * storing it first and reading the vector back:  whatever called us stores
+ * the vector we return to VR[vd] anyway.
+ */
+#ifdef ARCH_MIN_SSE2
+static INLINE v16 div_result(v16 vt, unsigned int vd, unsigned int e, i16 x)
+{
+    const v16 element = flags_to_mask(1 << e);
+
+    *(v16 *)VACC_L = vt;
+    return _mm_or_si128(
+        _mm_andnot_si128(element, *(v16 *)VR[vd]),
+        _mm_and_si128(element, _mm_set1_epi16(x))
+    );
+}
+#else
+static INLINE void div_result(v16 vt, unsigned int vd, unsigned int e, i16 x)
+{
+    vector_copy(VACC_L, vt);
+    VR[vd][e] = x;
+    vector_copy(V_result, VR[vd]);
+}
+#endif
+
 VECTOR_OPERATION VRCP(v16 vs, v16 vt)
 {
     const int result = (inst_word & 0x000007FF) >>  6;
@@ -1127,20 +1191,13 @@ VECTOR_OPERATION VRCP(v16 vs, v16 vt)
     const unsigned int element = (inst_word >> 21) & 0x7;
 
     DivIn = (i32)VR[target][element];
-    do_div(DivIn, SP_DIV_SQRT_NO, SP_DIV_PRECISION_SINGLE);
-#ifdef ARCH_MIN_SSE2
-    *(v16 *)VACC_L = vt;
-#else
-    vector_copy(VACC_L, vt);
-#endif
-    VR[result][source & 07] = (i16)DivOut;
+    DivOut = do_div(DivIn, SP_DIV_SQRT_NO, SP_DIV_PRECISION_SINGLE);
     DPH = SP_DIV_PRECISION_SINGLE;
 #ifdef ARCH_MIN_SSE2
-    COMPILER_FENCE();
-    vs = *(v16 *)VR[result];
+    vs = div_result(vt, result, source & 07, (i16)DivOut);
     return (vs);
 #else
-    vector_copy(V_result, VR[result]);
+    div_result(vt, result, source & 07, (i16)DivOut);
     vs = vt; /* unused */
     return;
 #endif
@@ -1157,20 +1214,13 @@ VECTOR_OPERATION VRCPL(v16 vs, v16 vt)
         DivIn  = (s32)(s16)(VR[target][element]);
     else
         DivIn |= (s32)(u16)(VR[target][element] & 0xFFFFu);
-    do_div(DivIn, SP_DIV_SQRT_NO, DPH);
-#ifdef ARCH_MIN_SSE2
-    *(v16 *)VACC_L = vt;
-#else
-    vector_copy(VACC_L, vt);
-#endif
-    VR[result][source & 07] = (i16)DivOut;
+    DivOut = do_div(DivIn, SP_DIV_SQRT_NO, DPH);
     DPH = SP_DIV_PRECISION_SINGLE;
 #ifdef ARCH_MIN_SSE2
-    COMPILER_FENCE();
-    vs = *(v16 *)VR[result];
+    vs = div_result(vt, result, source & 07, (i16)DivOut);
     return (vs);
 #else
-    vector_copy(V_result, VR[result]);
+    div_result(vt, result, source & 07, (i16)DivOut);
     vs = vt; /* unused */
     return;
 #endif
@@ -1184,19 +1234,12 @@ VECTOR_OPERATION VRCPH(v16 vs, v16 vt)
     const unsigned int element = (inst_word >> 21) & 0x7;
 
     DivIn = VR[target][element] << 16;
-#ifdef ARCH_MIN_SSE2
-    *(v16 *)VACC_L = vt;
-#else
-    vector_copy(VACC_L, vt);
-#endif
-    VR[result][source & 07] = DivOut >> 16;
     DPH = SP_DIV_PRECISION_DOUBLE;
 #ifdef ARCH_MIN_SSE2
-    COMPILER_FENCE();
-    vs = *(v16 *)VR[result];
+    vs = div_result(vt, result, source & 07, (i16)(DivOut >> 16));
     return (vs);
 #else
-    vector_copy(V_result, VR[result]);
+    div_result(vt, result, source & 07, (i16)(DivOut >> 16));
     vs = vt; /* unused */
     return;
 #endif
@@ -1211,19 +1254,11 @@ VECTOR_OPERATION VMOV(v16 vs, v16 vt)
 #ifdef ARCH_MIN_SSE2
     *(v16 *)VACC_L = vt;
     MovIn = VACC_L[source & 07]; /* _mm_extract_epi16(vt, source & 0x07); */
-#else
-    MovIn = vt[source & 07];
-    vector_copy(VACC_L, vt);
-#endif
-
-    VR[result][source & 07] = (i16)(MovIn & 0x0000FFFF);
-
-#ifdef ARCH_MIN_SSE2
-    COMPILER_FENCE();
-    vs = *(v16 *)VR[result];
+    vs = div_result(vt, result, source & 07, (i16)(MovIn & 0x0000FFFF));
     return (vs);
 #else
-    vector_copy(V_result, VR[result]);
+    MovIn = vt[source & 07];
+    div_result(vt, result, source & 07, (i16)(MovIn & 0x0000FFFF));
     vs = vt; /* unused */
     return;
 #endif
@@ -1237,20 +1272,13 @@ VECTOR_OPERATION VRSQ(v16 vs, v16 vt)
     const unsigned int element = (inst_word >> 21) & 0x7;
 
     DivIn = (i32)VR[target][element];
-    do_div(DivIn, SP_DIV_SQRT_YES, SP_DIV_PRECISION_SINGLE);
-#ifdef ARCH_MIN_SSE2
-    *(v16 *)VACC_L = vt;
-#else
-    vector_copy(VACC_L, vt);
-#endif
-    VR[result][source & 07] = (i16)DivOut;
+    DivOut = do_div(DivIn, SP_DIV_SQRT_YES, SP_DIV_PRECISION_SINGLE);
     DPH = SP_DIV_PRECISION_SINGLE;
 #ifdef ARCH_MIN_SSE2
-    COMPILER_FENCE();
-    vs = *(v16 *)VR[result];
+    vs = div_result(vt, result, source & 07, (i16)DivOut);
     return (vs);
 #else
-    vector_copy(V_result, VR[result]);
+    div_result(vt, result, source & 07, (i16)DivOut);
     vs = vt; /* unused */
     return;
 #endif
@@ -1267,20 +1295,13 @@ VECTOR_OPERATION VRSQL(v16 vs, v16 vt)
         DivIn  = (s32)(s16)(VR[target][element]);
     else
         DivIn |= (s32)(u16)(VR[target][element] & 0xFFFFu);
-    do_div(DivIn, SP_DIV_SQRT_YES, DPH);
-#ifdef ARCH_MIN_SSE2
-    *(v16 *)VACC_L = vt;
-#else
-    vector_copy(VACC_L, vt);
-#endif
-    VR[result][source & 07] = (i16)DivOut;
+    DivOut = do_div(DivIn, SP_DIV_SQRT_YES, DPH);
     DPH = SP_DIV_PRECISION_SINGLE;
 #ifdef ARCH_MIN_SSE2
-    COMPILER_FENCE();
-    vs = *(v16 *)VR[result];
+    vs = div_result(vt, result, source & 07, (i16)DivOut);
     return (vs);
 #else
-    vector_copy(V_result, VR[result]);
+    div_result(vt, result, source & 07, (i16)DivOut);
     vs = vt; /* unused */
     return;
 #endif
@@ -1294,19 +1315,12 @@ VECTOR_OPERATION VRSQH(v16 vs, v16 vt)
     const unsigned int element = (inst_word >> 21) & 0x7;
 
     DivIn = VR[target][element] << 16;
-#ifdef ARCH_MIN_SSE2
-    *(v16 *)VACC_L = vt;
-#else
-    vector_copy(VACC_L, vt);
-#endif
-    VR[result][source & 07] = DivOut >> 16;
     DPH = SP_DIV_PRECISION_DOUBLE;
 #ifdef ARCH_MIN_SSE2
-    COMPILER_FENCE();
-    vs = *(v16 *)VR[result];
+    vs = div_result(vt, result, source & 07, (i16)(DivOut >> 16));
     return (vs);
 #else
-    vector_copy(V_result, VR[result]);
+    div_result(vt, result, source & 07, (i16)(DivOut >> 16));
     vs = vt; /* unused */
     return;
 #endif
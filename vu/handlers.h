@@ -0,0 +1,62 @@
+/******************************************************************************\
+* Project:  MSP Emulation Layer for Vector Unit Computational Operations       *
+* License:  CC0 Public Domain Dedication                                       *
+*                                                                              *
+* To the extent possible under law, the author(s) have dedicated all copyright *
+* and related and neighboring rights to this software to the public domain     *
+* worldwide. This software is distributed without any warranty.                *
+*                                                                              *
+* You should have received a copy of the CC0 Public Domain Dedication along    *
+* with this software.                                                          *
+* If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.             *
+\******************************************************************************/
+
+/*
+ * one vector_handler for each entry of a COP2_C2 matrix
+ *
+ * Define VECTOR_MATRIX as the name of a `const` matrix of the operations
+ * (which must be initialized in the same translation unit) before including
+ * this, and then initialize a vector_handler table with VECTOR_HANDLER_LIST.
+ *
+ * Each handler reads its operands out of VR[], selects the elements of vt
+ * with vector_select() and writes the result to VR[vd].  Since VECTOR_MATRIX
+ * is constant, VECTOR_MATRIX[func] for a constant `func` is a direct call,
+ * so the compiler can inline the whole operation into its handler.
+ */
+#ifndef VECTOR_MATRIX
+#error VECTOR_MATRIX must name the matrix to make the handlers from.
+#endif
+
+/*
+ * `func` is written as four octal digits from 0000 through 0377, so that it
+ * can be both pasted into the handler's name and used as the matrix index.
+ */
+#define VECTOR_HANDLER(func) \
+static void vector_handler_##func( \
+    unsigned int vd, unsigned int vs, unsigned int vt, unsigned int e) \
+{ \
+    *(v16 *)VR[vd] = \
+        VECTOR_MATRIX[func](*(v16 *)VR[vs], vector_select(vt, e)); \
+}
+
+#define VECTOR_HANDLER_NAME(func)   vector_handler_##func,
+
+#define VECTOR_HANDLER_ROW(macro, row) \
+    macro(row##0) macro(row##1) macro(row##2) macro(row##3) \
+    macro(row##4) macro(row##5) macro(row##6) macro(row##7)
+#define VECTOR_HANDLER_MATRIX(macro, matrix) \
+    VECTOR_HANDLER_ROW(macro, matrix##0) VECTOR_HANDLER_ROW(macro, matrix##1) \
+    VECTOR_HANDLER_ROW(macro, matrix##2) VECTOR_HANDLER_ROW(macro, matrix##3) \
+    VECTOR_HANDLER_ROW(macro, matrix##4) VECTOR_HANDLER_ROW(macro, matrix##5) \
+    VECTOR_HANDLER_ROW(macro, matrix##6) VECTOR_HANDLER_ROW(macro, matrix##7)
+
+VECTOR_HANDLER_MATRIX(VECTOR_HANDLER, 00)
+VECTOR_HANDLER_MATRIX(VECTOR_HANDLER, 01)
+VECTOR_HANDLER_MATRIX(VECTOR_HANDLER, 02)
+VECTOR_HANDLER_MATRIX(VECTOR_HANDLER, 03)
+
+#define VECTOR_HANDLER_LIST \
+    VECTOR_HANDLER_MATRIX(VECTOR_HANDLER_NAME, 00) \
+    VECTOR_HANDLER_MATRIX(VECTOR_HANDLER_NAME, 01) \
+    VECTOR_HANDLER_MATRIX(VECTOR_HANDLER_NAME, 02) \
+    VECTOR_HANDLER_MATRIX(VECTOR_HANDLER_NAME, 03)
@@ -0,0 +1,63 @@
+/******************************************************************************\
+* Project:  MSP Emulation Layer for Vector Unit Computational Operations       *
+* License:  CC0 Public Domain Dedication                                       *
+*                                                                              *
+* To the extent possible under law, the author(s) have dedicated all copyright *
+* and related and neighboring rights to this software to the public domain     *
+* worldwide. This software is distributed without any warranty.                *
+*                                                                              *
+* You should have received a copy of the CC0 Public Domain Dedication along    *
+* with this software.                                                          *
+* If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.             *
+\******************************************************************************/
+
+/*
+ * Op-code-accurate matrix of all the known RSP vector operations.
+ * To do:  Either remove VMACQ, or add VRNDP, VRNDN, and VMULQ.
+ *
+ * Note that these are not our literal function names, just macro names.
+ *
+ * Decoding may add 64 to `func` where nothing reads what an operation leaves
+ * in the accumulator (multiplies) or in $vco (adds), and 128 where nothing
+ * reads the vd of a multiply, to pick the cheaper variants in the matrices
+ * after the first one.
+ *
+ * This is only the initializer list, to be included between the braces of
+ * COP2_C2[] in vu.c and of each ISA variant's matrix, which must all match.
+ */
+    VMULF  ,VMULU  ,res_M  ,res_M  ,VMUDL  ,VMUDM  ,VMUDN  ,VMUDH  , /* 000 */
+    VMACF  ,VMACU  ,res_M  ,res_M  ,VMADL  ,VMADM  ,VMADN  ,VMADH  , /* 001 */
+    VADD   ,VSUB   ,res_V  ,VABS   ,VADDC  ,VSUBC  ,res_V  ,res_V  , /* 010 */
+    res_V  ,res_V  ,res_V  ,res_V  ,res_V  ,VSAW   ,res_V  ,res_V  , /* 011 */
+    VLT    ,VEQ    ,VNE    ,VGE    ,VCL    ,VCH    ,VCR    ,VMRG   , /* 100 */
+    VAND   ,VNAND  ,VOR    ,VNOR   ,VXOR   ,VNXOR  ,res_V  ,res_V  , /* 101 */
+    VRCP   ,VRCPL  ,VRCPH  ,VMOV   ,VRSQ   ,VRSQL  ,VRSQH  ,VNOP   , /* 110 */
+    res_V  ,res_V  ,res_V  ,res_V  ,res_V  ,res_V  ,res_V  ,res_V  , /* 111 */
+
+    VMULF_NA,VMULU_NA,res_M,res_M,VMUDL_NA,VMUDM_NA,VMUDN_NA,VMUDH_NA,
+    VMACF_NA,VMACU_NA,res_M,res_M,VMADL_NA,VMADM_NA,VMADN_NA,VMADH_NA,
+    VADD_NF,VSUB_NF,res_V  ,VABS   ,VADDC_NF,VSUBC_NF,res_V ,res_V  ,
+    res_V  ,res_V  ,res_V  ,res_V  ,res_V  ,VSAW   ,res_V  ,res_V  ,
+    VLT    ,VEQ    ,VNE    ,VGE    ,VCL    ,VCH    ,VCR    ,VMRG   ,
+    VAND   ,VNAND  ,VOR    ,VNOR   ,VXOR   ,VNXOR  ,res_V  ,res_V  ,
+    VRCP   ,VRCPL  ,VRCPH  ,VMOV   ,VRSQ   ,VRSQL  ,VRSQH  ,VNOP   ,
+    res_V  ,res_V  ,res_V  ,res_V  ,res_V  ,res_V  ,res_V  ,res_V  ,
+
+    VMULF_NV,VMULU_NV,res_M,res_M,VMUDL_NV,VMUDM_NV,VMUDN_NV,VMUDH_NV,
+    VMACF_NV,VMACU_NV,res_M,res_M,VMADL_NV,VMADM_NV,VMADN_NV,VMADH_NV,
+    VADD   ,VSUB   ,res_V  ,VABS   ,VADDC  ,VSUBC  ,res_V  ,res_V  ,
+    res_V  ,res_V  ,res_V  ,res_V  ,res_V  ,VSAW   ,res_V  ,res_V  ,
+    VLT    ,VEQ    ,VNE    ,VGE    ,VCL    ,VCH    ,VCR    ,VMRG   ,
+    VAND   ,VNAND  ,VOR    ,VNOR   ,VXOR   ,VNXOR  ,res_V  ,res_V  ,
+    VRCP   ,VRCPL  ,VRCPH  ,VMOV   ,VRSQ   ,VRSQL  ,VRSQH  ,VNOP   ,
+    res_V  ,res_V  ,res_V  ,res_V  ,res_V  ,res_V  ,res_V  ,res_V  ,
+
+    VNOP   ,VNOP   ,res_M  ,res_M  ,VNOP   ,VNOP   ,VNOP   ,VNOP   ,
+    VNOP   ,VNOP   ,res_M  ,res_M  ,VNOP   ,VNOP   ,VNOP   ,VNOP   ,
+    VADD_NF,VSUB_NF,res_V  ,VABS   ,VADDC_NF,VSUBC_NF,res_V ,res_V  ,
+    res_V  ,res_V  ,res_V  ,res_V  ,res_V  ,VSAW   ,res_V  ,res_V  ,
+    VLT    ,VEQ    ,VNE    ,VGE    ,VCL    ,VCH    ,VCR    ,VMRG   ,
+    VAND   ,VNAND  ,VOR    ,VNOR   ,VXOR   ,VNXOR  ,res_V  ,res_V  ,
+    VRCP   ,VRCPL  ,VRCPH  ,VMOV   ,VRSQ   ,VRSQL  ,VRSQH  ,VNOP   ,
+    res_V  ,res_V  ,res_V  ,res_V  ,res_V  ,res_V  ,res_V  ,res_V  ,
+/* 000     001     010     011     100     101     110     111 */
@@ -15,6 +15,13 @@
 
 #include "multiply.h"
 
+/*
+ * Every multiply is written once for whether its clamped vd result or what
+ * it leaves in the accumulator could still be read by a later instruction.
+ */
+#define VD_LIVE     0x1
+#define ACC_LIVE    0x2
+
 #ifdef ARCH_MIN_SSE2
 
 #define _mm_allones_si128()     \
@@ -28,6 +35,79 @@
         _mm_xor_si128(src, _mm_setmin_epi16())  \
     )
 
+#ifdef VU_WIDE_ACCUMULATOR
+#define VACC_W_LO   (*(v16 *)&VACC_W[0])
+#define VACC_W_HI   (*(v16 *)&VACC_W[N/2])
+#endif
+
+/*
+ * helpers for accumulator bits 47..16 held as 32-bit lanes, acc_wlo for the
+ * first four elements and acc_whi for the last four
+ */
+static INLINE v16 acc_mid(v16 acc_wlo, v16 acc_whi)
+{ /* bits 31..16 of the accumulator, without clamping them */
+#ifdef ARCH_MIN_SSE4_1
+    const v16 mask = _mm_srli_epi32(_mm_allones_si128(), 16);
+
+    return _mm_packus_epi32(
+        _mm_and_si128(acc_wlo, mask), _mm_and_si128(acc_whi, mask)
+    );
+#else
+    acc_wlo = _mm_srai_epi32(_mm_slli_epi32(acc_wlo, 16), 16);
+    acc_whi = _mm_srai_epi32(_mm_slli_epi32(acc_whi, 16), 16);
+    return _mm_packs_epi32(acc_wlo, acc_whi);
+#endif
+}
+
+static INLINE v16 clamp_acc_lo(v16 acc_lo, v16 acc_wlo, v16 acc_whi)
+{ /* the VM?DL, VM?DN clamp (see VMADL) straight from the 32-bit lanes */
+    v16 clamped, unclamped;
+
+    clamped = _mm_packs_epi32(acc_wlo, acc_whi);
+    unclamped = _mm_cmpeq_epi16(acc_mid(acc_wlo, acc_whi), clamped);
+    acc_lo = _mm_and_si128(acc_lo, unclamped);
+    clamped = _mm_xor_si128(clamped, _mm_setmin_epi16());
+    clamped = _mm_andnot_si128(unclamped, clamped);
+    return _mm_or_si128(clamped, acc_lo);
+}
+
+static INLINE void store_acc(v16 acc_lo, v16 acc_md, v16 acc_hi)
+{
+    *(v16 *)VACC_L = acc_lo;
+#ifdef VU_WIDE_ACCUMULATOR
+    VACC_W_LO = _mm_unpacklo_epi16(acc_md, acc_hi);
+    VACC_W_HI = _mm_unpackhi_epi16(acc_md, acc_hi);
+#else
+    *(v16 *)VACC_M = acc_md;
+    *(v16 *)VACC_H = acc_hi;
+#endif
+}
+
+static INLINE void load_acc_wide(v16 * acc_wlo, v16 * acc_whi)
+{
+#ifdef VU_WIDE_ACCUMULATOR
+    *acc_wlo = VACC_W_LO;
+    *acc_whi = VACC_W_HI;
+#else
+    *acc_wlo = _mm_unpacklo_epi16(*(v16 *)VACC_M, *(v16 *)VACC_H);
+    *acc_whi = _mm_unpackhi_epi16(*(v16 *)VACC_M, *(v16 *)VACC_H);
+#endif
+}
+
+static INLINE void store_acc_wide(v16 acc_lo, v16 acc_wlo, v16 acc_whi)
+{
+    *(v16 *)VACC_L = acc_lo;
+#ifdef VU_WIDE_ACCUMULATOR
+    VACC_W_LO = acc_wlo;
+    VACC_W_HI = acc_whi;
+#else
+    *(v16 *)VACC_M = acc_mid(acc_wlo, acc_whi);
+    *(v16 *)VACC_H = _mm_packs_epi32(
+        _mm_srai_epi32(acc_wlo, 16), _mm_srai_epi32(acc_whi, 16)
+    );
+#endif
+}
+
 #else
 
 static INLINE void SIGNED_CLAMP_AM(pi16 VD)
@@ -83,7 +163,7 @@ static INLINE void SIGNED_CLAMP_AL(pi16 VD)
 }
 #endif
 
-VECTOR_OPERATION VMULF(v16 vs, v16 vt)
+INLINE static VECTOR_OPERATION do_mulf(v16 vs, v16 vt, const int live)
 {
 #ifdef ARCH_MIN_SSE2
     v16 negative;
@@ -115,9 +195,7 @@ VECTOR_OPERATION VMULF(v16 vs, v16 vt)
     round = _mm_slli_epi16(round, 15);
 
     prod_lo = _mm_xor_si128(prod_lo, round); /* Or += 32768 works also. */
-    *(v16 *)VACC_L = prod_lo;
     prod_hi = _mm_add_epi16(prod_hi, negative);
-    *(v16 *)VACC_M = prod_hi;
 
 /*
  * VMULF does signed clamping.  However, in VMULF's case, the only possible
@@ -131,7 +209,8 @@ VECTOR_OPERATION VMULF(v16 vs, v16 vt)
     vs = _mm_and_si128(vs, vt); /* vs == vt == -32768:  corner case confirmed */
 
     negative = _mm_xor_si128(negative, vs);
-    *(v16 *)VACC_H = negative; /* 2*i16*i16 only fills L/M; VACC_H = 0 or ~0. */
+    if (live & ACC_LIVE) /* 2*i16*i16 only fills L/M; VACC_H = 0/~0 */
+        store_acc(prod_lo, prod_hi, negative);
     return _mm_add_epi16(vs, prod_hi); /* prod_hi must be -32768; - 1 = +32767 */
 #else
     word_64 product[N]; /* (-32768 * -32768)<<1 + 32768 confuses 32-bit type. */
@@ -149,11 +228,12 @@ VECTOR_OPERATION VMULF(v16 vs, v16 vt)
         VACC_M[i] = (product[i].UW & 0x0000FFFF0000) >> 16;
     for (i = 0; i < N; i++)
         VACC_H[i] = -(product[i].SW < 0); /* product>>32 & 0xFFFF */
-    SIGNED_CLAMP_AM(V_result);
+    if (live & VD_LIVE)
+        SIGNED_CLAMP_AM(V_result);
 #endif
 }
 
-VECTOR_OPERATION VMULU(v16 vs, v16 vt)
+INLINE static VECTOR_OPERATION do_mulu(v16 vs, v16 vt, const int live)
 {
 #ifdef ARCH_MIN_SSE2
     v16 negative;
@@ -177,9 +257,7 @@ VECTOR_OPERATION VMULU(v16 vs, v16 vt)
     round = _mm_slli_epi16(round, 15);
 
     prod_lo = _mm_xor_si128(prod_lo, round);
-    *(v16 *)VACC_L = prod_lo;
     prod_hi = _mm_add_epi16(prod_hi, negative);
-    *(v16 *)VACC_M = prod_hi;
 
 /*
  * VMULU does unsigned clamping.  However, in VMULU's case, the only possible
@@ -190,7 +268,10 @@ VECTOR_OPERATION VMULU(v16 vs, v16 vt)
     vt = _mm_cmpeq_epi16(vt, round); /* vt == -32768 ? ~0 : 0 */
     vs = _mm_and_si128(vs, vt); /* vs == vt == -32768:  corner case confirmed */
     negative = _mm_xor_si128(negative, vs);
-    *(v16 *)VACC_H = negative; /* 2*i16*i16 only fills L/M; VACC_H = 0 or ~0. */
+    if (live & ACC_LIVE) /* 2*i16*i16 only fills L/M; VACC_H = 0/~0 */
+        store_acc(prod_lo, prod_hi, negative);
+    if ((live & VD_LIVE) == 0)
+        return (prod_hi);
 
     prod_lo = _mm_srai_epi16(prod_hi, 15); /* unsigned overflow mask */
     vs = _mm_or_si128(prod_hi, prod_lo);
@@ -211,18 +292,18 @@ VECTOR_OPERATION VMULU(v16 vs, v16 vt)
         VACC_M[i] = (product[i].UW & 0x0000FFFF0000) >> 16;
     for (i = 0; i < N; i++)
         VACC_H[i] = -(product[i].SW < 0); /* product>>32 & 0xFFFF */
-    UNSIGNED_CLAMP(V_result);
+    if (live & VD_LIVE)
+        UNSIGNED_CLAMP(V_result);
 #endif
 }
 
-VECTOR_OPERATION VMUDL(v16 vs, v16 vt)
+INLINE static VECTOR_OPERATION do_mudl(v16 vs, v16 vt, const int live)
 {
 #ifdef ARCH_MIN_SSE2
     vs = _mm_mulhi_epu16(vs, vt);
     vector_wipe(vt); /* (UINT16_MAX * UINT16_MAX) >> 16 too small for MD/HI */
-    *(v16 *)VACC_L = vs;
-    *(v16 *)VACC_M = vt;
-    *(v16 *)VACC_H = vt;
+    if (live & ACC_LIVE)
+        store_acc(vs, vt, vt);
     return (vs); /* no possibilities to clamp */
 #else
     word_32 product[N];
@@ -232,13 +313,14 @@ VECTOR_OPERATION VMUDL(v16 vs, v16 vt)
         product[i].UW = (u16)vs[i] * (u16)vt[i];
     for (i = 0; i < N; i++)
         VACC_L[i] = product[i].UW >> 16; /* product[i].H[HES(0) >> 1] */
-    vector_copy(V_result, VACC_L);
+    if (live & VD_LIVE)
+        vector_copy(V_result, VACC_L);
     vector_wipe(VACC_M);
     vector_wipe(VACC_H);
 #endif
 }
 
-VECTOR_OPERATION VMUDM(v16 vs, v16 vt)
+INLINE static VECTOR_OPERATION do_mudm(v16 vs, v16 vt, const int live)
 {
 #ifdef ARCH_MIN_SSE2
     v16 prod_hi, prod_lo;
@@ -254,11 +336,10 @@ VECTOR_OPERATION VMUDM(v16 vs, v16 vt)
     vt = _mm_and_si128(vt, vs);
     prod_hi = _mm_sub_epi16(prod_hi, vt);
 
-    *(v16 *)VACC_L = prod_lo;
-    *(v16 *)VACC_M = prod_hi;
     vs = prod_hi;
     prod_hi = _mm_srai_epi16(prod_hi, 15);
-    *(v16 *)VACC_H = prod_hi;
+    if (live & ACC_LIVE)
+        store_acc(prod_lo, vs, prod_hi);
     return (vs);
 #else
     word_32 product[N];
@@ -272,11 +353,12 @@ VECTOR_OPERATION VMUDM(v16 vs, v16 vt)
         VACC_M[i] = (product[i].W & 0x0000FFFF0000) >> 16;
     for (i = 0; i < N; i++)
         VACC_H[i] = -(VACC_M[i] < 0);
-    vector_copy(V_result, VACC_M);
+    if (live & VD_LIVE)
+        vector_copy(V_result, VACC_M);
 #endif
 }
 
-VECTOR_OPERATION VMUDN(v16 vs, v16 vt)
+INLINE static VECTOR_OPERATION do_mudn(v16 vs, v16 vt, const int live)
 {
 #ifdef ARCH_MIN_SSE2
     v16 prod_hi, prod_lo;
@@ -292,10 +374,8 @@ VECTOR_OPERATION VMUDN(v16 vs, v16 vt)
     vs = _mm_and_si128(vs, vt);
     prod_hi = _mm_sub_epi16(prod_hi, vs);
 
-    *(v16 *)VACC_L = prod_lo;
-    *(v16 *)VACC_M = prod_hi;
-    prod_hi = _mm_srai_epi16(prod_hi, 15);
-    *(v16 *)VACC_H = prod_hi;
+    if (live & ACC_LIVE)
+        store_acc(prod_lo, prod_hi, _mm_srai_epi16(prod_hi, 15));
     return (prod_lo);
 #else
     word_32 product[N];
@@ -309,11 +389,12 @@ VECTOR_OPERATION VMUDN(v16 vs, v16 vt)
         VACC_M[i] = (product[i].W & 0x0000FFFF0000) >> 16;
     for (i = 0; i < N; i++)
         VACC_H[i] = -(VACC_M[i] < 0);
-    vector_copy(V_result, VACC_L);
+    if (live & VD_LIVE)
+        vector_copy(V_result, VACC_L);
 #endif
 }
 
-VECTOR_OPERATION VMUDH(v16 vs, v16 vt)
+INLINE static VECTOR_OPERATION do_mudh(v16 vs, v16 vt, const int live)
 {
 #ifdef ARCH_MIN_SSE2
     v16 prod_high;
@@ -321,9 +402,10 @@ VECTOR_OPERATION VMUDH(v16 vs, v16 vt)
     prod_high = _mm_mulhi_epi16(vs, vt);
     vs        = _mm_mullo_epi16(vs, vt);
 
-    *(v16 *)VACC_L = _mm_setzero_si128();
-    *(v16 *)VACC_M = vs; /* acc 31..16 storing (VS*VT)15..0 */
-    *(v16 *)VACC_H = prod_high; /* acc 47..32 storing (VS*VT)31..16 */
+    if (live & ACC_LIVE) /* acc 47..16 storing (VS*VT)31..0 */
+        store_acc(_mm_setzero_si128(), vs, prod_high);
+    if ((live & VD_LIVE) == 0)
+        return (vs);
 
 /*
  * "Unpack" the low 16 bits and the high 16 bits of each 32-bit product to a
@@ -348,13 +430,45 @@ VECTOR_OPERATION VMUDH(v16 vs, v16 vt)
         VACC_M[i] = (s16)(product[i].W >>  0); /* product[i].HW[HES(0) >> 1] */
     for (i = 0; i < N; i++)
         VACC_H[i] = (s16)(product[i].W >> 16); /* product[i].HW[HES(2) >> 1] */
-    SIGNED_CLAMP_AM(V_result);
+    if (live & VD_LIVE)
+        SIGNED_CLAMP_AM(V_result);
 #endif
 }
 
-VECTOR_OPERATION VMACF(v16 vs, v16 vt)
+INLINE static VECTOR_OPERATION do_macf(v16 vs, v16 vt, const int live)
 {
-#ifdef ARCH_MIN_SSE2
+#if defined(VU_WIDE_ACCUMULATOR)
+    v16 acc_lo, acc_wlo, acc_whi;
+    v16 prod_hi, prod_lo;
+    v16 carry;
+
+    prod_hi = _mm_mulhi_epi16(vs, vt);
+    prod_lo = _mm_mullo_epi16(vs, vt);
+
+/*
+ * Bits 47..16 of (2 * s*t) are (s*t) >> 15, so the exact 32-bit products
+ * can go straight into the accumulator's 32-bit lanes, with only the carry
+ * out of bits 15..0 left to find with an unsigned compare.
+ */
+    vs = _mm_srai_epi32(_mm_unpacklo_epi16(prod_lo, prod_hi), 15);
+    vt = _mm_srai_epi32(_mm_unpackhi_epi16(prod_lo, prod_hi), 15);
+    prod_lo = _mm_add_epi16(prod_lo, prod_lo);
+
+    acc_lo = _mm_add_epi16(*(v16 *)VACC_L, prod_lo);
+    carry = _mm_cmplt_epu16(acc_lo, prod_lo); /* a + b < a + 0 ? ~0 : 0 */
+    acc_wlo = _mm_add_epi32(VACC_W_LO, vs);
+    acc_whi = _mm_add_epi32(VACC_W_HI, vt);
+    acc_wlo = _mm_sub_epi32(acc_wlo, _mm_unpacklo_epi16(carry, carry));
+    acc_whi = _mm_sub_epi32(acc_whi, _mm_unpackhi_epi16(carry, carry));
+    if (live & ACC_LIVE) {
+        *(v16 *)VACC_L = acc_lo;
+        VACC_W_LO = acc_wlo;
+        VACC_W_HI = acc_whi;
+    }
+    if ((live & VD_LIVE) == 0)
+        return (acc_lo);
+    return _mm_packs_epi32(acc_wlo, acc_whi);
+#elif defined(ARCH_MIN_SSE2)
     v16 acc_hi, acc_md, acc_lo;
     v16 prod_hi, prod_lo;
     v16 overflow, overflow_new;
@@ -375,7 +489,6 @@ VECTOR_OPERATION VMACF(v16 vs, v16 vt)
     acc_hi = *(v16 *)VACC_H;
 
     acc_lo = _mm_add_epi16(acc_lo, prod_lo);
-    *(v16 *)VACC_L = acc_lo;
     overflow = _mm_cmplt_epu16(acc_lo, prod_lo); /* a + b < a + 0 ? ~0 : 0 */
 
     acc_md = _mm_add_epi16(acc_md, prod_hi);
@@ -383,12 +496,17 @@ VECTOR_OPERATION VMACF(v16 vs, v16 vt)
     acc_md = _mm_sub_epi16(acc_md, overflow); /* m - (overflow = ~0) == m + 1 */
     carry = _mm_cmpeq_epi16(acc_md, _mm_setzero_si128());
     carry = _mm_and_si128(carry, overflow); /* ~0 - (-1) == 0 && (-1) != 0 */
-    *(v16 *)VACC_M = acc_md;
     overflow = _mm_or_si128(carry, overflow_new);
 
     acc_hi = _mm_sub_epi16(acc_hi, overflow);
     acc_hi = _mm_sub_epi16(acc_hi, prod_neg);
-    *(v16 *)VACC_H = acc_hi;
+    if (live & ACC_LIVE) {
+        *(v16 *)VACC_L = acc_lo;
+        *(v16 *)VACC_M = acc_md;
+        *(v16 *)VACC_H = acc_hi;
+    }
+    if ((live & VD_LIVE) == 0)
+        return (acc_md);
 
     vt = _mm_unpackhi_epi16(acc_md, acc_hi);
     vs = _mm_unpacklo_epi16(acc_md, acc_hi);
@@ -415,13 +533,47 @@ VECTOR_OPERATION VMACF(v16 vs, v16 vt)
         VACC_H[i] -= (product[i].SW < 0);
     for (i = 0; i < N; i++)
         VACC_H[i] += addend[i].UW >> 16;
-    SIGNED_CLAMP_AM(V_result);
+    if (live & VD_LIVE)
+        SIGNED_CLAMP_AM(V_result);
 #endif
 }
 
-VECTOR_OPERATION VMACU(v16 vs, v16 vt)
+INLINE static VECTOR_OPERATION do_macu(v16 vs, v16 vt, const int live)
 {
-#ifdef ARCH_MIN_SSE2
+#if defined(VU_WIDE_ACCUMULATOR)
+    v16 acc_lo, acc_wlo, acc_whi;
+    v16 prod_hi, prod_lo;
+    v16 carry;
+
+/*
+ * The same accumulation as VMACF, only with VMULU's unsigned sort of clamp.
+ */
+    prod_hi = _mm_mulhi_epi16(vs, vt);
+    prod_lo = _mm_mullo_epi16(vs, vt);
+
+    vs = _mm_srai_epi32(_mm_unpacklo_epi16(prod_lo, prod_hi), 15);
+    vt = _mm_srai_epi32(_mm_unpackhi_epi16(prod_lo, prod_hi), 15);
+    prod_lo = _mm_add_epi16(prod_lo, prod_lo);
+
+    acc_lo = _mm_add_epi16(*(v16 *)VACC_L, prod_lo);
+    carry = _mm_cmplt_epu16(acc_lo, prod_lo);
+    acc_wlo = _mm_add_epi32(VACC_W_LO, vs);
+    acc_whi = _mm_add_epi32(VACC_W_HI, vt);
+    acc_wlo = _mm_sub_epi32(acc_wlo, _mm_unpacklo_epi16(carry, carry));
+    acc_whi = _mm_sub_epi32(acc_whi, _mm_unpackhi_epi16(carry, carry));
+    if (live & ACC_LIVE) {
+        *(v16 *)VACC_L = acc_lo;
+        VACC_W_LO = acc_wlo;
+        VACC_W_HI = acc_whi;
+    }
+    if ((live & VD_LIVE) == 0)
+        return (acc_lo);
+
+    vs = _mm_packs_epi32(acc_wlo, acc_whi);
+    carry = _mm_cmplt_epi16(acc_mid(acc_wlo, acc_whi), vs);
+    vs = _mm_andnot_si128(_mm_srai_epi16(vs, 15), vs);
+    return _mm_or_si128(vs, carry);
+#elif defined(ARCH_MIN_SSE2)
     v16 acc_hi, acc_md, acc_lo;
     v16 prod_hi, prod_lo;
     v16 overflow, overflow_new;
@@ -442,7 +594,6 @@ VECTOR_OPERATION VMACU(v16 vs, v16 vt)
     acc_hi = *(v16 *)VACC_H;
 
     acc_lo = _mm_add_epi16(acc_lo, prod_lo);
-    *(v16 *)VACC_L = acc_lo;
     overflow = _mm_cmplt_epu16(acc_lo, prod_lo); /* a + b < a + 0 ? ~0 : 0 */
 
     acc_md = _mm_add_epi16(acc_md, prod_hi);
@@ -450,12 +601,17 @@ VECTOR_OPERATION VMACU(v16 vs, v16 vt)
     acc_md = _mm_sub_epi16(acc_md, overflow); /* m - (overflow = ~0) == m + 1 */
     carry = _mm_cmpeq_epi16(acc_md, _mm_setzero_si128());
     carry = _mm_and_si128(carry, overflow); /* ~0 - (-1) == 0 && (-1) != 0 */
-    *(v16 *)VACC_M = acc_md;
     overflow = _mm_or_si128(carry, overflow_new);
 
     acc_hi = _mm_sub_epi16(acc_hi, overflow);
     acc_hi = _mm_sub_epi16(acc_hi, prod_neg);
-    *(v16 *)VACC_H = acc_hi;
+    if (live & ACC_LIVE) {
+        *(v16 *)VACC_L = acc_lo;
+        *(v16 *)VACC_M = acc_md;
+        *(v16 *)VACC_H = acc_hi;
+    }
+    if ((live & VD_LIVE) == 0)
+        return (acc_md);
 
     vt = _mm_unpackhi_epi16(acc_md, acc_hi);
     vs = _mm_unpacklo_epi16(acc_md, acc_hi);
@@ -485,13 +641,33 @@ VECTOR_OPERATION VMACU(v16 vs, v16 vt)
         VACC_H[i] -= (product[i].SW < 0);
     for (i = 0; i < N; i++)
         VACC_H[i] += addend[i].UW >> 16;
-    UNSIGNED_CLAMP(V_result);
+    if (live & VD_LIVE)
+        UNSIGNED_CLAMP(V_result);
 #endif
 }
 
-VECTOR_OPERATION VMADL(v16 vs, v16 vt)
+INLINE static VECTOR_OPERATION do_madl(v16 vs, v16 vt, const int live)
 {
-#ifdef ARCH_MIN_SSE2
+#if defined(VU_WIDE_ACCUMULATOR)
+    v16 acc_lo, acc_wlo, acc_whi;
+    v16 prod_hi;
+    v16 carry;
+
+    prod_hi = _mm_mulhi_epu16(vs, vt);
+    acc_lo = _mm_add_epi16(*(v16 *)VACC_L, prod_hi);
+    carry = _mm_cmplt_epu16(acc_lo, prod_hi); /* overflow:  (x + y < y) */
+
+    acc_wlo = _mm_sub_epi32(VACC_W_LO, _mm_unpacklo_epi16(carry, carry));
+    acc_whi = _mm_sub_epi32(VACC_W_HI, _mm_unpackhi_epi16(carry, carry));
+    if (live & ACC_LIVE) {
+        *(v16 *)VACC_L = acc_lo;
+        VACC_W_LO = acc_wlo;
+        VACC_W_HI = acc_whi;
+    }
+    if ((live & VD_LIVE) == 0)
+        return (acc_lo);
+    return clamp_acc_lo(acc_lo, acc_wlo, acc_whi);
+#elif defined(ARCH_MIN_SSE2)
     v16 acc_hi, acc_md, acc_lo;
     v16 prod_hi;
     v16 overflow, overflow_new;
@@ -504,11 +680,9 @@ VECTOR_OPERATION VMADL(v16 vs, v16 vt)
     acc_hi = *(v16 *)VACC_H;
 
     acc_lo = _mm_add_epi16(acc_lo, prod_hi);
-    *(v16 *)VACC_L = acc_lo;
 
     overflow = _mm_cmplt_epu16(acc_lo, prod_hi); /* overflow:  (x + y < y) */
     acc_md = _mm_sub_epi16(acc_md, overflow);
-    *(v16 *)VACC_M = acc_md;
 
 /*
  * Luckily for us, taking unsigned * unsigned always evaluates to something
@@ -517,7 +691,13 @@ VECTOR_OPERATION VMADL(v16 vs, v16 vt)
     overflow_new = _mm_cmpeq_epi16(acc_md, _mm_setzero_si128());
     overflow = _mm_and_si128(overflow, overflow_new);
     acc_hi = _mm_sub_epi16(acc_hi, overflow);
-    *(v16 *)VACC_H = acc_hi;
+    if (live & ACC_LIVE) {
+        *(v16 *)VACC_L = acc_lo;
+        *(v16 *)VACC_M = acc_md;
+        *(v16 *)VACC_H = acc_hi;
+    }
+    if ((live & VD_LIVE) == 0)
+        return (acc_lo);
 
 /*
  * Do a signed clamp...sort of (VM?DM, VM?DH:  middle; VM?DL, VM?DN:  low).
@@ -558,13 +738,44 @@ VECTOR_OPERATION VMADL(v16 vs, v16 vt)
         VACC_M[i] = addend[i].UW & 0x0000FFFF;
     for (i = 0; i < N; i++)
         VACC_H[i] += addend[i].UW >> 16;
-    SIGNED_CLAMP_AL(V_result);
+    if (live & VD_LIVE)
+        SIGNED_CLAMP_AL(V_result);
 #endif
 }
 
-VECTOR_OPERATION VMADM(v16 vs, v16 vt)
+INLINE static VECTOR_OPERATION do_madm(v16 vs, v16 vt, const int live)
 {
-#ifdef ARCH_MIN_SSE2
+#if defined(VU_WIDE_ACCUMULATOR)
+    v16 acc_lo, acc_wlo, acc_whi;
+    v16 prod_hi, prod_lo;
+    v16 carry;
+
+    prod_lo = _mm_mullo_epi16(vs, vt);
+    prod_hi = _mm_mulhi_epu16(vs, vt);
+
+    vs = _mm_srai_epi16(vs, 15);
+    vt = _mm_and_si128(vt, vs);
+    prod_hi = _mm_sub_epi16(prod_hi, vt);
+
+/*
+ * (VS*VT) >> 16 cannot exceed +32766, so adding the carry to it cannot wrap.
+ */
+    acc_lo = _mm_add_epi16(*(v16 *)VACC_L, prod_lo);
+    carry = _mm_cmplt_epu16(acc_lo, prod_lo); /* overflow:  (x + y < y) */
+    prod_hi = _mm_sub_epi16(prod_hi, carry);
+
+    vs = _mm_srai_epi16(prod_hi, 15);
+    acc_wlo = _mm_add_epi32(VACC_W_LO, _mm_unpacklo_epi16(prod_hi, vs));
+    acc_whi = _mm_add_epi32(VACC_W_HI, _mm_unpackhi_epi16(prod_hi, vs));
+    if (live & ACC_LIVE) {
+        *(v16 *)VACC_L = acc_lo;
+        VACC_W_LO = acc_wlo;
+        VACC_W_HI = acc_whi;
+    }
+    if ((live & VD_LIVE) == 0)
+        return (acc_lo);
+    return _mm_packs_epi32(acc_wlo, acc_whi);
+#elif defined(ARCH_MIN_SSE2)
     v16 acc_hi, acc_md, acc_lo;
     v16 prod_hi, prod_lo;
     v16 overflow;
@@ -585,18 +796,22 @@ VECTOR_OPERATION VMADM(v16 vs, v16 vt)
     acc_hi = *(v16 *)VACC_H;
 
     acc_lo = _mm_add_epi16(acc_lo, prod_lo);
-    *(v16 *)VACC_L = acc_lo;
 
     overflow = _mm_cmplt_epu16(acc_lo, prod_lo); /* overflow:  (x + y < y) */
     prod_hi = _mm_sub_epi16(prod_hi, overflow);
     acc_md = _mm_add_epi16(acc_md, prod_hi);
-    *(v16 *)VACC_M = acc_md;
 
     overflow = _mm_cmplt_epu16(acc_md, prod_hi);
     prod_hi = _mm_srai_epi16(prod_hi, 15);
     acc_hi = _mm_add_epi16(acc_hi, prod_hi);
     acc_hi = _mm_sub_epi16(acc_hi, overflow);
-    *(v16 *)VACC_H = acc_hi;
+    if (live & ACC_LIVE) {
+        *(v16 *)VACC_L = acc_lo;
+        *(v16 *)VACC_M = acc_md;
+        *(v16 *)VACC_H = acc_hi;
+    }
+    if ((live & VD_LIVE) == 0)
+        return (acc_md);
 
     vt = _mm_unpackhi_epi16(acc_md, acc_hi);
     vs = _mm_unpacklo_epi16(acc_md, acc_hi);
@@ -619,13 +834,44 @@ VECTOR_OPERATION VMADM(v16 vs, v16 vt)
         VACC_M[i] = addend[i].UW & 0x0000FFFF;
     for (i = 0; i < N; i++)
         VACC_H[i] += addend[i].UW >> 16;
-    SIGNED_CLAMP_AM(V_result);
+    if (live & VD_LIVE)
+        SIGNED_CLAMP_AM(V_result);
 #endif
 }
 
-VECTOR_OPERATION VMADN(v16 vs, v16 vt)
+INLINE static VECTOR_OPERATION do_madn(v16 vs, v16 vt, const int live)
 {
-#ifdef ARCH_MIN_SSE2
+#if defined(VU_WIDE_ACCUMULATOR)
+    v16 acc_lo, acc_wlo, acc_whi;
+    v16 prod_hi, prod_lo;
+    v16 carry;
+
+    prod_lo = _mm_mullo_epi16(vs, vt);
+    prod_hi = _mm_mulhi_epu16(vs, vt);
+
+    vt = _mm_srai_epi16(vt, 15);
+    vs = _mm_and_si128(vs, vt);
+    prod_hi = _mm_sub_epi16(prod_hi, vs);
+
+/*
+ * (VS*VT) >> 16 cannot exceed +32766, so adding the carry to it cannot wrap.
+ */
+    acc_lo = _mm_add_epi16(*(v16 *)VACC_L, prod_lo);
+    carry = _mm_cmplt_epu16(acc_lo, prod_lo); /* overflow:  (x + y < y) */
+    prod_hi = _mm_sub_epi16(prod_hi, carry);
+
+    vs = _mm_srai_epi16(prod_hi, 15);
+    acc_wlo = _mm_add_epi32(VACC_W_LO, _mm_unpacklo_epi16(prod_hi, vs));
+    acc_whi = _mm_add_epi32(VACC_W_HI, _mm_unpackhi_epi16(prod_hi, vs));
+    if (live & ACC_LIVE) {
+        *(v16 *)VACC_L = acc_lo;
+        VACC_W_LO = acc_wlo;
+        VACC_W_HI = acc_whi;
+    }
+    if ((live & VD_LIVE) == 0)
+        return (acc_lo);
+    return clamp_acc_lo(acc_lo, acc_wlo, acc_whi);
+#elif defined(ARCH_MIN_SSE2)
     v16 acc_hi, acc_md, acc_lo;
     v16 prod_hi, prod_lo;
     v16 overflow;
@@ -646,18 +892,22 @@ VECTOR_OPERATION VMADN(v16 vs, v16 vt)
     acc_hi = *(v16 *)VACC_H;
 
     acc_lo = _mm_add_epi16(acc_lo, prod_lo);
-    *(v16 *)VACC_L = acc_lo;
 
     overflow = _mm_cmplt_epu16(acc_lo, prod_lo); /* overflow:  (x + y < y) */
     prod_hi = _mm_sub_epi16(prod_hi, overflow);
     acc_md = _mm_add_epi16(acc_md, prod_hi);
-    *(v16 *)VACC_M = acc_md;
 
     overflow = _mm_cmplt_epu16(acc_md, prod_hi);
     prod_hi = _mm_srai_epi16(prod_hi, 15);
     acc_hi = _mm_add_epi16(acc_hi, prod_hi);
     acc_hi = _mm_sub_epi16(acc_hi, overflow);
-    *(v16 *)VACC_H = acc_hi;
+    if (live & ACC_LIVE) {
+        *(v16 *)VACC_L = acc_lo;
+        *(v16 *)VACC_M = acc_md;
+        *(v16 *)VACC_H = acc_hi;
+    }
+    if ((live & VD_LIVE) == 0)
+        return (acc_md);
 
 /*
  * Do a signed clamp...sort of (VM?DM, VM?DH:  middle; VM?DL, VM?DN:  low).
@@ -698,13 +948,33 @@ VECTOR_OPERATION VMADN(v16 vs, v16 vt)
         VACC_M[i] = addend[i].UW & 0x0000FFFF;
     for (i = 0; i < N; i++)
         VACC_H[i] += addend[i].UW >> 16;
-    SIGNED_CLAMP_AL(V_result);
+    if (live & VD_LIVE)
+        SIGNED_CLAMP_AL(V_result);
 #endif
 }
 
-VECTOR_OPERATION VMADH(v16 vs, v16 vt)
+INLINE static VECTOR_OPERATION do_madh(v16 vs, v16 vt, const int live)
 {
-#ifdef ARCH_MIN_SSE2
+#if defined(VU_WIDE_ACCUMULATOR)
+    v16 acc_wlo, acc_whi;
+    v16 prod_high;
+
+/*
+ * Accumulator bits 47..16 += (VS*VT) is now just a 32-bit add per element.
+ */
+    prod_high = _mm_mulhi_epi16(vs, vt);
+    vs        = _mm_mullo_epi16(vs, vt);
+
+    acc_wlo = _mm_add_epi32(VACC_W_LO, _mm_unpacklo_epi16(vs, prod_high));
+    acc_whi = _mm_add_epi32(VACC_W_HI, _mm_unpackhi_epi16(vs, prod_high));
+    if (live & ACC_LIVE) {
+        VACC_W_LO = acc_wlo;
+        VACC_W_HI = acc_whi;
+    }
+    if ((live & VD_LIVE) == 0)
+        return (vs);
+    return _mm_packs_epi32(acc_wlo, acc_whi);
+#elif defined(ARCH_MIN_SSE2)
     v16 acc_mid;
     v16 prod_high;
 
@@ -717,7 +987,6 @@ VECTOR_OPERATION VMADH(v16 vs, v16 vt)
  */
     acc_mid = *(v16 *)VACC_M;
     vs = _mm_add_epi16(vs, acc_mid);
-    *(v16 *)VACC_M = vs;
     vt = *(v16 *)VACC_H;
 
 /*
@@ -729,11 +998,15 @@ VECTOR_OPERATION VMADH(v16 vs, v16 vt)
  * MMX-based instruction sets define unsigned comparison ops FOR us, so...
  */
     vt = _mm_add_epi16(vt, prod_high);
-    vs = _mm_cmplt_epu16(vs, acc_mid); /* acc.mid + prod.low < acc.mid */
-    vt = _mm_sub_epi16(vt, vs); /* += 1 if overflow, by doing -= ~0 */
-    *(v16 *)VACC_H = vt;
+    acc_mid = _mm_cmplt_epu16(vs, acc_mid); /* acc.mid + prod.low < acc.mid */
+    vt = _mm_sub_epi16(vt, acc_mid); /* += 1 if overflow, by doing -= ~0 */
+    if (live & ACC_LIVE) {
+        *(v16 *)VACC_M = vs;
+        *(v16 *)VACC_H = vt;
+    }
+    if ((live & VD_LIVE) == 0)
+        return (vs);
 
-    vs = *(v16 *)VACC_M;
     prod_high = _mm_unpackhi_epi16(vs, vt);
     vs        = _mm_unpacklo_epi16(vs, vt);
     return _mm_packs_epi32(vs, prod_high);
@@ -749,6 +1022,205 @@ VECTOR_OPERATION VMADH(v16 vs, v16 vt)
         VACC_M[i] += (i16)product[i].SW;
     for (i = 0; i < N; i++)
         VACC_H[i] += (addend[i].UW >> 16) + (product[i].SW >> 16);
-    SIGNED_CLAMP_AM(V_result);
+    if (live & VD_LIVE)
+        SIGNED_CLAMP_AM(V_result);
+#endif
+}
+
+/*
+ * Decoding selects the _NV variants when vd is overwritten before it is read
+ * and the _NA ones when the accumulator is, or VNOP when both of them are.
+ */
+#ifdef ARCH_MIN_SSE2
+#define MULTIPLY_VARIANTS(name, worker) \
+VECTOR_OPERATION name(v16 vs, v16 vt) \
+{ return worker(vs, vt, VD_LIVE | ACC_LIVE); } \
+VECTOR_OPERATION name##_NV(v16 vs, v16 vt) \
+{ return worker(vs, vt, ACC_LIVE); } \
+VECTOR_OPERATION name##_NA(v16 vs, v16 vt) \
+{ return worker(vs, vt, VD_LIVE); }
+#else
+#define MULTIPLY_VARIANTS(name, worker) \
+VECTOR_OPERATION name(v16 vs, v16 vt) \
+{ worker(vs, vt, VD_LIVE | ACC_LIVE); } \
+VECTOR_OPERATION name##_NV(v16 vs, v16 vt) \
+{ worker(vs, vt, ACC_LIVE); } \
+VECTOR_OPERATION name##_NA(v16 vs, v16 vt) \
+{ worker(vs, vt, VD_LIVE); }
+#endif
+
+MULTIPLY_VARIANTS(VMULF, do_mulf)
+MULTIPLY_VARIANTS(VMULU, do_mulu)
+MULTIPLY_VARIANTS(VMUDL, do_mudl)
+MULTIPLY_VARIANTS(VMUDM, do_mudm)
+MULTIPLY_VARIANTS(VMUDN, do_mudn)
+MULTIPLY_VARIANTS(VMUDH, do_mudh)
+MULTIPLY_VARIANTS(VMACF, do_macf)
+MULTIPLY_VARIANTS(VMACU, do_macu)
+MULTIPLY_VARIANTS(VMADL, do_madl)
+MULTIPLY_VARIANTS(VMADM, do_madm)
+MULTIPLY_VARIANTS(VMADN, do_madn)
+MULTIPLY_VARIANTS(VMADH, do_madh)
+
+/*
+ * Micro-code multiplies 32-bit fixed-point vectors, each kept as one vector
+ * of the fractions and one of the integer halves, with these four in a row:
+ *     VMUDL    $v29, a_lo, b_lo[e]     # or VMADL to add to the accumulator
+ *     VMADM    $v29, a_hi, b_lo[e]
+ *     VMADN    vd_lo, a_lo, b_hi[e]
+ *     VMADH    vd_hi, a_hi, b_hi[e]
+ * All that the four of them add to the accumulator is (a * b) >> 16, so with
+ * SSE4.1 we find that as the full 64-bit product, two elements per PMULDQ.
+ * su.c calls this for the chain only if the first two results are not read.
+ */
+#ifdef ARCH_MIN_SSE2
+#ifdef ARCH_MIN_SSE4_1
+static INLINE v16 mul_32x32_half(v16 a, v16 b, v16 * prod_lo)
+{ /* a * b for four lanes:  bits 63..32 returned, bits 31..0 to *prod_lo */
+    v16 even, odd;
+
+    even = _mm_mul_epi32(a, b);
+    odd = _mm_mul_epi32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    *prod_lo = _mm_blend_epi16(even, _mm_slli_epi64(odd, 32), 0xCC);
+    return _mm_blend_epi16(_mm_srli_epi64(even, 32), odd, 0xCC);
+}
+#endif
+
+static v16 mul_32x32(v16 a_lo, v16 a_hi, v16 b_lo, v16 b_hi, pi16 vd_lo,
+    int chain)
+{
+#ifdef ARCH_MIN_SSE4_1
+    v16 acc_lo, acc_wlo, acc_whi;
+    v16 prod_lo, prod_wlo, prod_whi;
+    v16 low_wlo, low_whi;
+    v16 carry;
+
+    prod_wlo = mul_32x32_half(
+        _mm_unpacklo_epi16(a_lo, a_hi), _mm_unpacklo_epi16(b_lo, b_hi),
+        &low_wlo
+    );
+    prod_whi = mul_32x32_half(
+        _mm_unpackhi_epi16(a_lo, a_hi), _mm_unpackhi_epi16(b_lo, b_hi),
+        &low_whi
+    );
+    prod_lo = _mm_packs_epi32( /* bits 31..16 of each product */
+        _mm_srai_epi32(low_wlo, 16), _mm_srai_epi32(low_whi, 16)
+    );
+
+    if (chain & CHAIN_ACCUMULATE) {
+        load_acc_wide(&acc_wlo, &acc_whi);
+        acc_lo = _mm_add_epi16(*(v16 *)VACC_L, prod_lo);
+        carry = _mm_cmplt_epu16(acc_lo, prod_lo);
+        acc_wlo = _mm_add_epi32(acc_wlo, prod_wlo);
+        acc_whi = _mm_add_epi32(acc_whi, prod_whi);
+        acc_wlo = _mm_sub_epi32(acc_wlo, _mm_unpacklo_epi16(carry, carry));
+        acc_whi = _mm_sub_epi32(acc_whi, _mm_unpackhi_epi16(carry, carry));
+    } else {
+        acc_lo = prod_lo;
+        acc_wlo = prod_wlo;
+        acc_whi = prod_whi;
+    }
+
+/*
+ * VMADN clamped the accumulator from before VMADH added a_hi * b_hi to it.
+ */
+    if (vd_lo != NULL) {
+        const v16 prod_hi = _mm_mulhi_epi16(a_hi, b_hi);
+        const v16 prod_md = _mm_mullo_epi16(a_hi, b_hi);
+
+        *(v16 *)vd_lo = clamp_acc_lo(acc_lo,
+            _mm_sub_epi32(acc_wlo, _mm_unpacklo_epi16(prod_md, prod_hi)),
+            _mm_sub_epi32(acc_whi, _mm_unpackhi_epi16(prod_md, prod_hi))
+        );
+    }
+    if (chain & CHAIN_ACC_LIVE)
+        store_acc_wide(acc_lo, acc_wlo, acc_whi);
+    else
+        *(v16 *)VACC_L = acc_lo; /* VMADN's, which VMADH would not change */
+    return _mm_packs_epi32(acc_wlo, acc_whi);
+#else
+    v16 vd;
+
+/*
+ * Without PMULDQ, the best we can do is to run all four of them from here,
+ * so that the accumulator only gets passed along in registers.
+ */
+    if (chain & CHAIN_ACCUMULATE)
+        do_madl(a_lo, b_lo, ACC_LIVE);
+    else
+        do_mudl(a_lo, b_lo, ACC_LIVE);
+    do_madm(a_hi, b_lo, ACC_LIVE);
+    vd = do_madn(a_lo, b_hi, ACC_LIVE | VD_LIVE);
+    if (chain & CHAIN_ACC_LIVE)
+        a_hi = do_madh(a_hi, b_hi, ACC_LIVE | VD_LIVE);
+    else
+        a_hi = do_madh(a_hi, b_hi, VD_LIVE);
+    if (vd_lo != NULL)
+        *(v16 *)vd_lo = vd;
+    return (a_hi);
 #endif
 }
+
+/*
+ * VMULF followed by VMACF, also to pass the accumulator in registers.
+ * su.c calls this only if the VMACF does not read what the VMULF wrote.
+ */
+static v16 mulf_macf(v16 vs, v16 vt, v16 vs_next, v16 vt_next, pi16 vd,
+    int chain)
+{
+    vs = do_mulf(vs, vt, ACC_LIVE | VD_LIVE);
+    if (chain & CHAIN_ACC_LIVE)
+        vt = do_macf(vs_next, vt_next, ACC_LIVE | VD_LIVE);
+    else
+        vt = do_macf(vs_next, vt_next, VD_LIVE);
+    if (vd != NULL)
+        *(v16 *)vd = vs;
+    return (vt);
+}
+
+/*
+ * Two multiplies of the same kind in a row, where the second one reads
+ * neither the first one's vd nor (being VMUL* or VMUD*) the accumulator.
+ * Only the second one's accumulator is stored, as it overwrites the first's.
+ *
+ * Packing both into the halves of one AVX2 register turned out slower than
+ * this:  the VINSERTI128 and VEXTRACTI128 to do it cost more than the one
+ * 128-bit multiply saved, so what we gain here is only the dispatch.
+ */
+static INLINE v16 mul_pair(
+    VECTOR_OPERATION (*worker)(v16, v16, const int),
+    v16 vs, v16 vt, v16 vs_next, v16 vt_next, pi16 vd, int chain)
+{
+    vs = worker(vs, vt, VD_LIVE);
+    if (chain & CHAIN_ACC_LIVE)
+        vt = worker(vs_next, vt_next, ACC_LIVE | VD_LIVE);
+    else
+        vt = worker(vs_next, vt_next, VD_LIVE);
+    if (vd != NULL)
+        *(v16 *)vd = vs;
+    return (vt);
+}
+
+#define MULTIPLY_PAIR(name, worker) \
+static v16 name(v16 vs, v16 vt, v16 vs_next, v16 vt_next, pi16 vd, \
+    int chain) \
+{ return mul_pair(worker, vs, vt, vs_next, vt_next, vd, chain); }
+
+MULTIPLY_PAIR(mulf_pair, do_mulf)
+MULTIPLY_PAIR(mulu_pair, do_mulu)
+MULTIPLY_PAIR(mudl_pair, do_mudl)
+MULTIPLY_PAIR(mudm_pair, do_mudm)
+MULTIPLY_PAIR(mudn_pair, do_mudn)
+MULTIPLY_PAIR(mudh_pair, do_mudh)
+
+#ifndef VU_ISA_VARIANT
+fused_multiplies FUSED_MULTIPLIES = {
+    mul_32x32,
+    mulf_macf,
+    {
+        mulf_pair, mulu_pair, NULL, NULL,
+        mudl_pair, mudm_pair, mudn_pair, mudh_pair,
+    },
+};
+#endif
+#endif
@@ -66,6 +66,26 @@ VECTOR_EXTERN
 VECTOR_EXTERN
     VMADH  (v16 vs, v16 vt);
 
+/*
+ * the same, without the vd clamp (_NV) or without the accumulator write (_NA)
+ */
+#define MULTIPLY_VARIANT_EXTERNS(name) \
+VECTOR_EXTERN name##_NV(v16 vs, v16 vt); \
+VECTOR_EXTERN name##_NA(v16 vs, v16 vt);
+
+MULTIPLY_VARIANT_EXTERNS(VMULF)
+MULTIPLY_VARIANT_EXTERNS(VMULU)
+MULTIPLY_VARIANT_EXTERNS(VMUDL)
+MULTIPLY_VARIANT_EXTERNS(VMUDM)
+MULTIPLY_VARIANT_EXTERNS(VMUDN)
+MULTIPLY_VARIANT_EXTERNS(VMUDH)
+MULTIPLY_VARIANT_EXTERNS(VMACF)
+MULTIPLY_VARIANT_EXTERNS(VMACU)
+MULTIPLY_VARIANT_EXTERNS(VMADL)
+MULTIPLY_VARIANT_EXTERNS(VMADM)
+MULTIPLY_VARIANT_EXTERNS(VMADN)
+MULTIPLY_VARIANT_EXTERNS(VMADH)
+
 /*
  * an useful idea I thought of for the single-precision multiplies
  * VMULF and VMULU
@@ -15,6 +15,226 @@
 
 #include "select.h"
 
+#ifdef ARCH_MIN_SSE2
+/*
+ * vector select merge (`VMRG`) formula:  (mask) ? pass : fail
+ */
+static INLINE v16 merge(v16 mask, v16 pass, v16 fail)
+{
+#ifdef ARCH_MIN_SSE4_1
+    return _mm_blendv_epi8(fail, pass, mask);
+#else
+    pass = _mm_and_si128(mask, pass);
+    fail = _mm_andnot_si128(mask, fail);
+    return _mm_or_si128(pass, fail);
+#endif
+}
+
+VECTOR_OPERATION VLT(v16 vs, v16 vt)
+{
+    v16 eq, lt;
+
+    eq = _mm_cmpeq_epi16(vs, vt);
+    eq = _mm_and_si128(eq, flags_to_mask(VCO & (VCO >> 8)));
+    lt = _mm_cmplt_epi16(vs, vt); /* less than */
+    lt = _mm_or_si128(lt, eq); /* ... or equal (uncommonly) */
+
+    vs = merge(lt, vs, vt);
+    *(v16 *)VACC_L = vs;
+    VCC = (u16)mask_to_flags(lt); /* The clip flags are cleared. */
+
+ /* CTC2    $0, $vco # zeroing RSP flags VCF[0] */
+    VCO = 0x0000;
+    return (vs);
+}
+
+VECTOR_OPERATION VEQ(v16 vs, v16 vt)
+{
+    v16 eq;
+
+    eq = _mm_cmpeq_epi16(vs, vt);
+    eq = _mm_andnot_si128(flags_to_mask(VCO >> 8), eq);
+
+    *(v16 *)VACC_L = vt;
+    VCC = (u16)mask_to_flags(eq); /* The clip flags are cleared. */
+
+ /* CTC2    $0, $vco # zeroing RSP flags VCF[0] */
+    VCO = 0x0000;
+    return (vt);
+}
+
+VECTOR_OPERATION VNE(v16 vs, v16 vt)
+{
+    v16 ne;
+
+    ne = _mm_cmpeq_epi16(vs, vt);
+    ne = _mm_xor_si128(ne, _mm_cmpeq_epi16(vs, vs));
+    ne = _mm_or_si128(ne, flags_to_mask(VCO >> 8));
+
+    *(v16 *)VACC_L = vs;
+    VCC = (u16)mask_to_flags(ne); /* The clip flags are cleared. */
+
+ /* CTC2    $0, $vco # zeroing RSP flags VCF[0] */
+    VCO = 0x0000;
+    return (vs);
+}
+
+VECTOR_OPERATION VGE(v16 vs, v16 vt)
+{
+    v16 eq, ge;
+
+    eq = flags_to_mask(VCO & (VCO >> 8));
+    eq = _mm_andnot_si128(eq, _mm_cmpeq_epi16(vs, vt));
+    ge = _mm_cmpgt_epi16(vs, vt); /* greater than */
+    ge = _mm_or_si128(ge, eq); /* ... or equal (commonly) */
+
+    vs = merge(ge, vs, vt);
+    *(v16 *)VACC_L = vs;
+    VCC = (u16)mask_to_flags(ge); /* The clip flags are cleared. */
+
+ /* CTC2    $0, $vco # zeroing RSP flags VCF[0] */
+    VCO = 0x0000;
+    return (vs);
+}
+
+VECTOR_OPERATION VCL(v16 vs, v16 vt)
+{
+    v16 eq, sn, vce;
+    v16 vc, lz, uz, ge, le;
+    v16 gen, len;
+
+    eq = flags_to_mask(~VCO >> 8);
+    sn = flags_to_mask(VCO);
+    vce = flags_to_mask(VCE);
+
+/*
+ * Now that we have extracted all the flags, we will essentially be masking
+ * them back in where they came from redundantly, unless the corresponding
+ * NOTEQUAL bit from VCO upper was not set....
+ */
+    vc = _mm_xor_si128(vt, sn);
+    vc = _mm_sub_epi16(vc, sn); /* conditional negation, if sn */
+    lz = _mm_cmpeq_epi16(vs, vc);
+
+/*
+ * unsigned (VS + VT) did not carry out if the saturating sum is the sum
+ */
+    uz = _mm_cmpeq_epi16(_mm_adds_epu16(vs, vt), _mm_add_epi16(vs, vt));
+
+    gen = _mm_and_si128(_mm_or_si128(lz, uz), vce);
+    len = _mm_andnot_si128(vce, _mm_and_si128(lz, uz));
+    len = _mm_or_si128(len, gen);
+    gen = _mm_cmpeq_epi16(_mm_subs_epu16(vc, vs), _mm_setzero_si128());
+
+    le = merge(_mm_and_si128(eq, sn), len, flags_to_mask(VCC));
+    ge = merge(_mm_andnot_si128(sn, eq), gen, flags_to_mask(VCC >> 8));
+
+    vs = merge(merge(sn, le, ge), vc, vs);
+    *(v16 *)VACC_L = vs;
+
+ /* CTC2    $0, $vco # zeroing RSP flags VCF[0] */
+    VCO = 0x0000;
+
+    VCC = (u16)(mask_to_flags(ge) << 8 | mask_to_flags(le));
+
+ /* CTC2    $0, $vce # zeroing RSP flags VCF[2] */
+    VCE = 0x00;
+    return (vs);
+}
+
+VECTOR_OPERATION VCH(v16 vs, v16 vt)
+{
+    v16 cch, sn, vc, vce;
+    v16 eq, ge, le;
+    v16 ones;
+
+    ones = _mm_cmpeq_epi16(vs, vs);
+
+    cch = _mm_cmpeq_epi16(vt, _mm_set1_epi16(-32768)); /* -(-32768) */
+    sn = _mm_srai_epi16(_mm_xor_si128(vs, vt), 15);
+    vc = _mm_xor_si128(vt, sn); /* if (sn == ~0) {VT = ~VT;} else {VT =  VT;} */
+    vce = _mm_and_si128(_mm_cmpeq_epi16(vs, vc), sn);
+
+/*
+ * if (sign flag), then converts ~(VT) into -(VT) a.k.a. ~(VT) - (-1)
+ * Note that if (VT == INT16_MIN) a.k.a. cch, -(-32768) is undefined.
+ */
+    vc = _mm_sub_epi16(vc, _mm_andnot_si128(cch, sn));
+    eq = _mm_andnot_si128(cch, _mm_cmpeq_epi16(vs, vc));
+    eq = _mm_or_si128(eq, vce);
+
+    ge = _mm_cmpgt_epi16(vt, _mm_or_si128(sn, vs));
+    ge = _mm_xor_si128(ge, ones); /* (sn | VS) >= VT */
+
+    le = _mm_srai_epi16(_mm_sub_epi16(vc, vs), 15);
+    le = _mm_xor_si128(le, ones); /* (VC - VS) >= 0 */
+    le = merge(sn, le, _mm_srai_epi16(vt, 15));
+
+    vs = merge(merge(sn, le, ge), vc, vs);
+    *(v16 *)VACC_L = vs;
+
+    VCC = (u16)(mask_to_flags(ge) << 8 | mask_to_flags(le));
+    VCO = (u16)(mask_to_flags(_mm_xor_si128(eq, ones)) << 8 | mask_to_flags(sn));
+    VCE = (u8)mask_to_flags(vce);
+    return (vs);
+}
+
+VECTOR_OPERATION VCR(v16 vs, v16 vt)
+{
+    v16 sn, vc, ge, le;
+    v16 ones;
+
+    ones = _mm_cmpeq_epi16(vs, vs);
+    sn = _mm_srai_epi16(_mm_xor_si128(vs, vt), 15);
+    le = _mm_cmpgt_epi16(vt, _mm_xor_si128(_mm_and_si128(vs, sn), ones));
+    ge = _mm_cmpgt_epi16(vt, _mm_or_si128(vs, sn));
+    le = _mm_xor_si128(le, ones); /* VT <= ~(VS & sn) */
+    ge = _mm_xor_si128(ge, ones); /* (VS | sn) >= VT */
+    vc = _mm_xor_si128(vt, sn); /* if (sn == ~0) {VT = ~VT;} else {VT =  VT;} */
+
+    vs = merge(merge(sn, le, ge), vc, vs);
+    *(v16 *)VACC_L = vs;
+
+ /* CTC2    $0, $vco # zeroing RSP flags VCF[0] */
+    VCO = 0x0000;
+
+    VCC = (u16)(mask_to_flags(ge) << 8 | mask_to_flags(le));
+
+ /* CTC2    $0, $vce # zeroing RSP flags VCF[2] */
+    VCE = 0x00;
+    return (vs);
+}
+
+VECTOR_OPERATION VMRG(v16 vs, v16 vt)
+{
+    vs = merge(flags_to_mask(VCC), vs, vt);
+    *(v16 *)VACC_L = vs;
+    return (vs);
+}
+#else
+/*
+ * The scalar versions work on the flags as arrays of Booleans (the cf_*
+ * arrays in the rsp_context), expanded from $vco, $vcc and $vce before each
+ * operation and packed back afterwards.
+ */
+
+static void expand_flags(void)
+{
+    flags_to_bools(cf_ne, VCO >> 8);
+    flags_to_bools(cf_co, VCO);
+    flags_to_bools(cf_clip, VCC >> 8);
+    flags_to_bools(cf_comp, VCC);
+    flags_to_bools(cf_vce, VCE);
+    return;
+}
+static void pack_flags(void)
+{
+    VCO = (u16)(bools_to_flags(cf_ne) << 8 | bools_to_flags(cf_co));
+    VCC = (u16)(bools_to_flags(cf_clip) << 8 | bools_to_flags(cf_comp));
+    VCE = (u8)bools_to_flags(cf_vce);
+    return;
+}
+
 /*
  * vector select merge (`VMRG`) formula
  *
@@ -327,6 +547,8 @@ INLINE static void do_cr(pi16 VD, pi16 VS, pi16 VT)
 #endif
     for (i = 0; i < N; i++)
         VC[i] ^= sn[i]; /* if (sn == ~0) {VT = ~VT;} else {VT =  VT;} */
+    for (i = 0; i < N; i++)
+        sn[i] = (u16)(sn[i]) >> 15; /* ~0 to 1, 0 to 0, as merge() expects */
     merge(cmp, sn, le, ge);
     merge(VACC_L, cmp, VC, VS);
     vector_copy(VD, VACC_L);
@@ -353,199 +575,88 @@ INLINE static void do_mrg(pi16 VD, pi16 VS, pi16 VT)
 VECTOR_OPERATION VLT(v16 vs, v16 vt)
 {
     ALIGNED i16 VD[N];
-#ifdef ARCH_MIN_SSE2
-    ALIGNED i16 VS[N], VT[N];
-
-    *(v16 *)VS = vs;
-    *(v16 *)VT = vt;
-#else
-    v16 VS, VT;
 
-    VS = vs;
-    VT = vt;
-#endif
-    do_lt(VD, VS, VT);
-#ifdef ARCH_MIN_SSE2
-    COMPILER_FENCE();
-    vs = *(v16 *)VD;
-    return (vs);
-#else
+    expand_flags();
+    do_lt(VD, vs, vt);
+    pack_flags();
     vector_copy(V_result, VD);
     return;
-#endif
 }
 
 VECTOR_OPERATION VEQ(v16 vs, v16 vt)
 {
     ALIGNED i16 VD[N];
-#ifdef ARCH_MIN_SSE2
-    ALIGNED i16 VS[N], VT[N];
-
-    *(v16 *)VS = vs;
-    *(v16 *)VT = vt;
-#else
-    v16 VS, VT;
 
-    VS = vs;
-    VT = vt;
-#endif
-    do_eq(VD, VS, VT);
-#ifdef ARCH_MIN_SSE2
-    COMPILER_FENCE();
-    vs = *(v16 *)VD;
-    return (vs);
-#else
+    expand_flags();
+    do_eq(VD, vs, vt);
+    pack_flags();
     vector_copy(V_result, VD);
     return;
-#endif
 }
 
 VECTOR_OPERATION VNE(v16 vs, v16 vt)
 {
     ALIGNED i16 VD[N];
-#ifdef ARCH_MIN_SSE2
-    ALIGNED i16 VS[N], VT[N];
 
-    *(v16 *)VS = vs;
-    *(v16 *)VT = vt;
-#else
-    v16 VS, VT;
-
-    VS = vs;
-    VT = vt;
-#endif
-    do_ne(VD, VS, VT);
-#ifdef ARCH_MIN_SSE2
-    COMPILER_FENCE();
-    vs = *(v16 *)VD;
-    return (vs);
-#else
+    expand_flags();
+    do_ne(VD, vs, vt);
+    pack_flags();
     vector_copy(V_result, VD);
     return;
-#endif
 }
 
 VECTOR_OPERATION VGE(v16 vs, v16 vt)
 {
     ALIGNED i16 VD[N];
-#ifdef ARCH_MIN_SSE2
-    ALIGNED i16 VS[N], VT[N];
 
-    *(v16 *)VS = vs;
-    *(v16 *)VT = vt;
-#else
-    v16 VS, VT;
-
-    VS = vs;
-    VT = vt;
-#endif
-    do_ge(VD, VS, VT);
-#ifdef ARCH_MIN_SSE2
-    COMPILER_FENCE();
-    vs = *(v16 *)VD;
-    return (vs);
-#else
+    expand_flags();
+    do_ge(VD, vs, vt);
+    pack_flags();
     vector_copy(V_result, VD);
     return;
-#endif
 }
 
 VECTOR_OPERATION VCL(v16 vs, v16 vt)
 {
     ALIGNED i16 VD[N];
-#ifdef ARCH_MIN_SSE2
-    ALIGNED i16 VS[N], VT[N];
 
-    *(v16 *)VS = vs;
-    *(v16 *)VT = vt;
-#else
-    v16 VS, VT;
-
-    VS = vs;
-    VT = vt;
-#endif
-    do_cl(VD, VS, VT);
-#ifdef ARCH_MIN_SSE2
-    COMPILER_FENCE();
-    vs = *(v16 *)VD;
-    return (vs);
-#else
+    expand_flags();
+    do_cl(VD, vs, vt);
+    pack_flags();
     vector_copy(V_result, VD);
     return;
-#endif
 }
 
 VECTOR_OPERATION VCH(v16 vs, v16 vt)
 {
     ALIGNED i16 VD[N];
-#ifdef ARCH_MIN_SSE2
-    ALIGNED i16 VS[N], VT[N];
 
-    *(v16 *)VS = vs;
-    *(v16 *)VT = vt;
-#else
-    v16 VS, VT;
-
-    VS = vs;
-    VT = vt;
-#endif
-    do_ch(VD, VS, VT);
-#ifdef ARCH_MIN_SSE2
-    COMPILER_FENCE();
-    vs = *(v16 *)VD;
-    return (vs);
-#else
+    expand_flags();
+    do_ch(VD, vs, vt);
+    pack_flags();
     vector_copy(V_result, VD);
     return;
-#endif
 }
 
 VECTOR_OPERATION VCR(v16 vs, v16 vt)
 {
     ALIGNED i16 VD[N];
-#ifdef ARCH_MIN_SSE2
-    ALIGNED i16 VS[N], VT[N];
 
-    *(v16 *)VS = vs;
-    *(v16 *)VT = vt;
-#else
-    v16 VS, VT;
-
-    VS = vs;
-    VT = vt;
-#endif
-    do_cr(VD, VS, VT);
-#ifdef ARCH_MIN_SSE2
-    COMPILER_FENCE();
-    vs = *(v16 *)VD;
-    return (vs);
-#else
+    expand_flags();
+    do_cr(VD, vs, vt);
+    pack_flags();
     vector_copy(V_result, VD);
     return;
-#endif
 }
 
 VECTOR_OPERATION VMRG(v16 vs, v16 vt)
 {
     ALIGNED i16 VD[N];
-#ifdef ARCH_MIN_SSE2
-    ALIGNED i16 VS[N], VT[N];
 
-    *(v16 *)VS = vs;
-    *(v16 *)VT = vt;
-#else
-    v16 VS, VT;
-
-    VS = vs;
-    VT = vt;
-#endif
-    do_mrg(VD, VS, VT);
-#ifdef ARCH_MIN_SSE2
-    COMPILER_FENCE();
-    vs = *(v16 *)VD;
-    return (vs);
-#else
+    expand_flags();
+    do_mrg(VD, vs, vt);
+    pack_flags();
     vector_copy(V_result, VD);
     return;
-#endif
 }
+#endif
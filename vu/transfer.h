@@ -0,0 +1,382 @@
+/******************************************************************************\
+* Project:  MSP Simulation Layer for Vector Unit Loads and Stores              *
+* License:  CC0 Public Domain Dedication                                       *
+*                                                                              *
+* To the extent possible under law, the author(s) have dedicated all copyright *
+* and related and neighboring rights to this software to the public domain     *
+* worldwide. This software is distributed without any warranty.                *
+*                                                                              *
+* You should have received a copy of the CC0 Public Domain Dedication along    *
+* with this software.                                                          *
+* If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.             *
+\******************************************************************************/
+
+/*
+ * LDV, SDV, LQV, LRV, SQV and SRV, and the packed PV, UV and HV transfers,
+ * each done with one 16-byte load from DMEM or VR, one PSHUFB and a merge
+ * into the 16 bytes it partly overwrites
+ *
+ * Include this only in a translation unit built for SSSE3, and then
+ * initialize a vector_transfers set with VECTOR_TRANSFER_LIST.  Whatever
+ * these do not handle (illegal elements, odd addresses and, unless DMEM is
+ * mirrored, the 8-byte transfers wrapping around the end of DMEM) is left to
+ * the plain versions in su.c.
+ */
+#ifndef ARCH_MIN_SSSE3
+#error The vector transfers with byte shuffles need SSSE3.
+#endif
+
+#include "../su.h"
+
+/*
+ * The PSHUFB control for byte `i` of the destination, in the host's order.
+ *
+ * `to` and `from` undo the byte swapping of the destination and the source
+ * (ENDIAN_SWAP_BIMI for a vector register, ENDIAN_SWAP_BYTE for DMEM).  RSP
+ * byte `d` of the destination, for (lo <= d < hi) and every `every`-th `d`
+ * from `lo` on, gets RSP byte `(d - lo)*mul/div + base` of the source.  The
+ * other bytes of the destination are kept or cleared (0x80).
+ */
+#define CONTROL_BYTE(i, to, from, lo, hi, every, mul, div, base) ( \
+    (((i) ^ (to)) >= (lo) && ((i) ^ (to)) < (hi) \
+  && (((i) ^ (to)) - (lo)) % (every) == 0) \
+  ? (((((i) ^ (to)) - (lo))*(mul)/(div) + (base)) ^ (from)) : 0x80)
+
+#define CONTROL(to, from, lo, hi, every, mul, div, base) { \
+    CONTROL_BYTE( 0, to, from, lo, hi, every, mul, div, base), \
+    CONTROL_BYTE( 1, to, from, lo, hi, every, mul, div, base), \
+    CONTROL_BYTE( 2, to, from, lo, hi, every, mul, div, base), \
+    CONTROL_BYTE( 3, to, from, lo, hi, every, mul, div, base), \
+    CONTROL_BYTE( 4, to, from, lo, hi, every, mul, div, base), \
+    CONTROL_BYTE( 5, to, from, lo, hi, every, mul, div, base), \
+    CONTROL_BYTE( 6, to, from, lo, hi, every, mul, div, base), \
+    CONTROL_BYTE( 7, to, from, lo, hi, every, mul, div, base), \
+    CONTROL_BYTE( 8, to, from, lo, hi, every, mul, div, base), \
+    CONTROL_BYTE( 9, to, from, lo, hi, every, mul, div, base), \
+    CONTROL_BYTE(10, to, from, lo, hi, every, mul, div, base), \
+    CONTROL_BYTE(11, to, from, lo, hi, every, mul, div, base), \
+    CONTROL_BYTE(12, to, from, lo, hi, every, mul, div, base), \
+    CONTROL_BYTE(13, to, from, lo, hi, every, mul, div, base), \
+    CONTROL_BYTE(14, to, from, lo, hi, every, mul, div, base), \
+    CONTROL_BYTE(15, to, from, lo, hi, every, mul, div, base), }
+
+#define TO_VR(lo, hi, every, mul, div, base) CONTROL( \
+    ENDIAN_SWAP_BIMI, ENDIAN_SWAP_BYTE, lo, hi, every, mul, div, base)
+#define TO_DMEM(lo, hi, every, mul, div, base) CONTROL( \
+    ENDIAN_SWAP_BYTE, ENDIAN_SWAP_BIMI, lo, hi, every, mul, div, base)
+
+/*
+ * LQV:  bytes [b, 16) of the DMEM quadword go to bytes [e, e + 16 - b).
+ * LRV:  bytes [0, b) of the DMEM quadword go to bytes [16 - b, 16).
+ * SQV:  bytes [0, 16 - b) of the register go to bytes [b, 16) of DMEM.
+ * SRV:  bytes [16 - b, 16) of the register go to bytes [0, b) of DMEM.
+ */
+#define LQV_SHUFFLE(b, e)   TO_VR(e, e + 16 - b, 1, 1, 1, b)
+#define LRV_SHUFFLE(b)      TO_VR(16 - b, 16, 1, 1, 1, 0)
+#define SQV_SHUFFLE(b)      TO_DMEM(b, 16, 1, 1, 1, 0)
+#define SRV_SHUFFLE(b)      TO_DMEM(0, b, 1, 1, 1, 16 - b)
+
+/*
+ * LDV and SDV move 8 bytes to or from any address, not just within the one
+ * quadword, so they use the 16 bytes of DMEM starting at (addr & ~3), which
+ * covers the 8 from `addr` on and keeps the word swapping of DMEM in line.
+ * The packed loads and stores (PV and UV) use the same window.
+ */
+#define LDV_SHUFFLE(a, e)   TO_VR(e, e + 8, 1, 1, 1, a)
+#define SDV_SHUFFLE(a, e)   TO_DMEM(a, a + 8, 1, 1, 1, e)
+
+/*
+ * The packed transfers move one byte per element, as the upper byte of the
+ * element (PV) or shifted one bit lower than that (UV and HV).  LPV and LHV
+ * clear the lower bytes, so LUV and LHV just need a shift right after it.
+ * SPV stores the upper bytes; SUV and SHV shift the register left first.
+ *
+ * LPV:  bytes [a, a + 8) of DMEM go to bytes 0, 2, 4, ..., 14.
+ * LHV:  bytes a, a + 2, a + 4, ..., a + 14 go to bytes 0, 2, 4, ..., 14.
+ * SPV:  bytes 0, 2, 4, ..., 14 go to bytes [a, a + 8) of DMEM.
+ * SHV:  bytes 0, 2, 4, ..., 14 go to bytes a, a + 2, a + 4, ..., a + 14.
+ */
+#define LPV_SHUFFLE(a)      TO_VR(0, 16, 2, 1, 2, a)
+#define LHV_SHUFFLE(a)      TO_VR(0, 16, 2, 1, 1, a)
+#define SPV_SHUFFLE(a)      TO_DMEM(a, a + 8, 1, 2, 1, 0)
+#define SHV_SHUFFLE(a)      TO_DMEM(a, 16, 2, 1, 1, 0)
+
+#define EVEN_ELEMENTS(table, x) { \
+    table(x, 0x0), table(x, 0x2), table(x, 0x4), table(x, 0x6), \
+    table(x, 0x8), table(x, 0xA), table(x, 0xC), table(x, 0xE), }
+
+ALIGNED static const u8 LQV_shuffles[8][8][16] = {
+    EVEN_ELEMENTS(LQV_SHUFFLE, 0x0), EVEN_ELEMENTS(LQV_SHUFFLE, 0x2),
+    EVEN_ELEMENTS(LQV_SHUFFLE, 0x4), EVEN_ELEMENTS(LQV_SHUFFLE, 0x6),
+    EVEN_ELEMENTS(LQV_SHUFFLE, 0x8), EVEN_ELEMENTS(LQV_SHUFFLE, 0xA),
+    EVEN_ELEMENTS(LQV_SHUFFLE, 0xC), EVEN_ELEMENTS(LQV_SHUFFLE, 0xE),
+};
+ALIGNED static const u8 LRV_shuffles[8][16] = {
+    LRV_SHUFFLE(0x0), LRV_SHUFFLE(0x2), LRV_SHUFFLE(0x4), LRV_SHUFFLE(0x6),
+    LRV_SHUFFLE(0x8), LRV_SHUFFLE(0xA), LRV_SHUFFLE(0xC), LRV_SHUFFLE(0xE),
+};
+ALIGNED static const u8 SQV_shuffles[8][16] = {
+    SQV_SHUFFLE(0x0), SQV_SHUFFLE(0x2), SQV_SHUFFLE(0x4), SQV_SHUFFLE(0x6),
+    SQV_SHUFFLE(0x8), SQV_SHUFFLE(0xA), SQV_SHUFFLE(0xC), SQV_SHUFFLE(0xE),
+};
+ALIGNED static const u8 SRV_shuffles[8][16] = {
+    SRV_SHUFFLE(0x0), SRV_SHUFFLE(0x2), SRV_SHUFFLE(0x4), SRV_SHUFFLE(0x6),
+    SRV_SHUFFLE(0x8), SRV_SHUFFLE(0xA), SRV_SHUFFLE(0xC), SRV_SHUFFLE(0xE),
+};
+ALIGNED static const u8 LDV_shuffles[4][8][16] = {
+    EVEN_ELEMENTS(LDV_SHUFFLE, 0), EVEN_ELEMENTS(LDV_SHUFFLE, 1),
+    EVEN_ELEMENTS(LDV_SHUFFLE, 2), EVEN_ELEMENTS(LDV_SHUFFLE, 3),
+};
+ALIGNED static const u8 SDV_shuffles[4][8][16] = {
+    EVEN_ELEMENTS(SDV_SHUFFLE, 0), EVEN_ELEMENTS(SDV_SHUFFLE, 1),
+    EVEN_ELEMENTS(SDV_SHUFFLE, 2), EVEN_ELEMENTS(SDV_SHUFFLE, 3),
+};
+ALIGNED static const u8 LPV_shuffles[4][16] = {
+    LPV_SHUFFLE(0), LPV_SHUFFLE(1), LPV_SHUFFLE(2), LPV_SHUFFLE(3),
+};
+ALIGNED static const u8 SPV_shuffles[4][16] = {
+    SPV_SHUFFLE(0), SPV_SHUFFLE(1), SPV_SHUFFLE(2), SPV_SHUFFLE(3),
+};
+ALIGNED static const u8 LHV_shuffles[2][16] = {
+    LHV_SHUFFLE(0), LHV_SHUFFLE(1),
+};
+ALIGNED static const u8 SHV_shuffles[2][16] = {
+    SHV_SHUFFLE(0), SHV_SHUFFLE(1),
+};
+
+/*
+ * the bytes of `source` selected by `shuffle` merged into `old`
+ */
+static INLINE v16 shuffle_into(v16 old, v16 source, const u8 * shuffle)
+{
+    const v16 control = *(v16 *)shuffle;
+    v16 kept;
+
+    kept = _mm_cmplt_epi8(control, _mm_setzero_si128());
+    kept = _mm_and_si128(kept, old);
+    return _mm_or_si128(_mm_shuffle_epi8(source, control), kept);
+}
+
+static void
+LDV_shuffled(unsigned vt, unsigned element, signed offset, unsigned base)
+{
+    register u32 addr;
+    const unsigned int e = element;
+    pu8 window;
+
+    addr = (SR[base] + 8*offset) & 0x00000FFF;
+    if ((e & 0x1) || (addr & ~0x00000003) > DMEM_window_end) {
+        LDV(vt, element, offset, base);
+        return;
+    }
+    window = DMEM + (addr & ~0x00000003);
+    *(v16 *)VR[vt] = shuffle_into(
+        *(v16 *)VR[vt], _mm_loadu_si128((v16 *)window),
+        LDV_shuffles[addr % 4][e / 2]
+    );
+    return;
+}
+static void
+SDV_shuffled(unsigned vt, unsigned element, signed offset, unsigned base)
+{
+    register u32 addr;
+    const unsigned int e = element;
+    pu8 window;
+
+    addr = (SR[base] + 8*offset) & 0x00000FFF;
+    if (e > 0x8 || (e & 0x1) || (addr & ~0x00000003) > DMEM_window_end) {
+        SDV(vt, element, offset, base);
+        return;
+    }
+    window = DMEM + (addr & ~0x00000003);
+    _mm_storeu_si128((v16 *)window, shuffle_into(
+        _mm_loadu_si128((v16 *)window), *(v16 *)VR[vt],
+        SDV_shuffles[addr % 4][e / 2]
+    ));
+    return;
+}
+
+static void
+LQV_shuffled(unsigned vt, unsigned element, signed offset, unsigned base)
+{
+    register u32 addr;
+    const unsigned int e = element;
+
+    addr = (SR[base] + 16*offset) & 0x00000FFF;
+    if ((e | addr) & 0x1) {
+        LQV(vt, element, offset, base);
+        return;
+    }
+    *(v16 *)VR[vt] = shuffle_into(
+        *(v16 *)VR[vt], _mm_loadu_si128((v16 *)(DMEM + (addr & ~0xF))),
+        LQV_shuffles[addr/2 % 8][e / 2]
+    );
+    return;
+}
+static void
+LRV_shuffled(unsigned vt, unsigned element, signed offset, unsigned base)
+{
+    register u32 addr;
+
+    addr = (SR[base] + 16*offset) & 0x00000FFF;
+    if (element != 0x0 || (addr & 0x00000001)) {
+        LRV(vt, element, offset, base);
+        return;
+    }
+    *(v16 *)VR[vt] = shuffle_into(
+        *(v16 *)VR[vt], _mm_loadu_si128((v16 *)(DMEM + (addr & ~0xF))),
+        LRV_shuffles[addr/2 % 8]
+    );
+    return;
+}
+static void
+SQV_shuffled(unsigned vt, unsigned element, signed offset, unsigned base)
+{
+    register u32 addr;
+    pu8 quadword;
+
+    addr = (SR[base] + 16*offset) & 0x00000FFF;
+    if (element != 0x0 || (addr & 0x00000009)) {
+        SQV(vt, element, offset, base);
+        return;
+    } /* SQV itself only does (addr % 16) = 0, 2, 4 or 6 with element 0. */
+    quadword = DMEM + (addr & ~0x0000000F);
+    _mm_storeu_si128((v16 *)quadword, shuffle_into(
+        _mm_loadu_si128((v16 *)quadword), *(v16 *)VR[vt],
+        SQV_shuffles[addr/2 % 8]
+    ));
+    return;
+}
+static void
+SRV_shuffled(unsigned vt, unsigned element, signed offset, unsigned base)
+{
+    register u32 addr;
+    pu8 quadword;
+
+    addr = (SR[base] + 16*offset) & 0x00000FFF;
+    if (element != 0x0 || (addr & 0x00000001)) {
+        SRV(vt, element, offset, base);
+        return;
+    }
+    quadword = DMEM + (addr & ~0x0000000F);
+    _mm_storeu_si128((v16 *)quadword, shuffle_into(
+        _mm_loadu_si128((v16 *)quadword), *(v16 *)VR[vt],
+        SRV_shuffles[addr/2 % 8]
+    ));
+    return;
+}
+
+static void
+LPV_shuffled(unsigned vt, unsigned element, signed offset, unsigned base)
+{
+    register u32 addr;
+
+    addr = (SR[base] + 8*offset) & 0x00000FFF;
+    if (element != 0x0 || (addr & ~0x00000003) > DMEM_window_end) {
+        LPV(vt, element, offset, base);
+        return;
+    }
+    *(v16 *)VR[vt] = _mm_shuffle_epi8(
+        _mm_loadu_si128((v16 *)(DMEM + (addr & ~0x00000003))),
+        *(v16 *)LPV_shuffles[addr % 4]
+    );
+    return;
+}
+static void
+LUV_shuffled(unsigned vt, unsigned element, signed offset, unsigned base)
+{
+    register u32 addr;
+    v16 bytes;
+
+    addr = (SR[base] + 8*offset) & 0x00000FFF;
+    if (element != 0x0 || (addr & ~0x00000003) > DMEM_window_end) {
+        LUV(vt, element, offset, base);
+        return;
+    }
+    bytes = _mm_shuffle_epi8(
+        _mm_loadu_si128((v16 *)(DMEM + (addr & ~0x00000003))),
+        *(v16 *)LPV_shuffles[addr % 4]
+    );
+    *(v16 *)VR[vt] = _mm_srli_epi16(bytes, 1);
+    return;
+}
+static void
+LHV_shuffled(unsigned vt, unsigned element, signed offset, unsigned base)
+{
+    register u32 addr;
+    v16 bytes;
+
+    addr = (SR[base] + 16*offset) & 0x00000FFF;
+    if (element != 0x0 || (addr & 0x0000000E)) {
+        LHV(vt, element, offset, base);
+        return;
+    }
+    bytes = _mm_shuffle_epi8(
+        _mm_loadu_si128((v16 *)(DMEM + (addr & ~0x0000000F))),
+        *(v16 *)LHV_shuffles[addr % 2]
+    );
+    *(v16 *)VR[vt] = _mm_srli_epi16(bytes, 1);
+    return;
+}
+
+static void
+SPV_shuffled(unsigned vt, unsigned element, signed offset, unsigned base)
+{
+    register u32 addr;
+    pu8 window;
+
+    addr = (SR[base] + 8*offset) & 0x00000FFF;
+    if (element != 0x0 || (addr & ~0x00000003) > DMEM_window_end) {
+        SPV(vt, element, offset, base);
+        return;
+    }
+    window = DMEM + (addr & ~0x00000003);
+    _mm_storeu_si128((v16 *)window, shuffle_into(
+        _mm_loadu_si128((v16 *)window), *(v16 *)VR[vt],
+        SPV_shuffles[addr % 4]
+    ));
+    return;
+}
+static void
+SUV_shuffled(unsigned vt, unsigned element, signed offset, unsigned base)
+{
+    register u32 addr;
+    pu8 window;
+
+    addr = (SR[base] + 8*offset) & 0x00000FFF;
+    if (element != 0x0 || (addr & 0x00000003) || addr > DMEM_window_end) {
+        SUV(vt, element, offset, base);
+        return;
+    } /* SUV itself only does (addr % 8) = 0 or 4. */
+    window = DMEM + addr;
+    _mm_storeu_si128((v16 *)window, shuffle_into(
+        _mm_loadu_si128((v16 *)window), _mm_slli_epi16(*(v16 *)VR[vt], 1),
+        SPV_shuffles[0]
+    ));
+    return;
+}
+static void
+SHV_shuffled(unsigned vt, unsigned element, signed offset, unsigned base)
+{
+    register u32 addr;
+    pu8 quadword;
+
+    addr = (SR[base] + 16*offset) & 0x00000FFF;
+    if (element != 0x0 || (addr & 0x0000000E)) {
+        SHV(vt, element, offset, base);
+        return;
+    }
+    quadword = DMEM + (addr & ~0x0000000F);
+    _mm_storeu_si128((v16 *)quadword, shuffle_into(
+        _mm_loadu_si128((v16 *)quadword), _mm_slli_epi16(*(v16 *)VR[vt], 1),
+        SHV_shuffles[addr % 2]
+    ));
+    return;
+}
+
+#define VECTOR_TRANSFER_LIST { \
+    LDV_shuffled, LQV_shuffled, LRV_shuffled, \
+    LPV_shuffled, LUV_shuffled, LHV_shuffled, \
+    SDV_shuffled, SQV_shuffled, SRV_shuffled, \
+    SPV_shuffled, SUV_shuffled, SHV_shuffled, \
+}
@@ -24,22 +24,14 @@
 #include "pack.h"
 #endif
 
-ALIGNED i16 VR[32][N << VR_STATIC_WRAPAROUND];
-ALIGNED i16 VACC[3][N];
-#ifndef ARCH_MIN_SSE2
-ALIGNED i16 V_result[N];
+#ifdef VU_ISA_DISPATCH
+#include <string.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
 #endif
-
-/*
- * These normally should have type `int` because they are Boolean T/F arrays.
- * However, since SSE2 uses 128-bit XMM's, and Win32 `int` storage is 32-bit,
- * we have the problem of 32*8 > 128 bits, so we use `short` to reduce packs.
- */
-ALIGNED i16 cf_ne[N]; /* $vco:  high "NOTEQUAL" */
-ALIGNED i16 cf_co[N]; /* $vco:  low "carry/borrow in/out" */
-ALIGNED i16 cf_clip[N]; /* $vcc:  high (clip tests:  VCL, VCH, VCR) */
-ALIGNED i16 cf_comp[N]; /* $vcc:  low (VEQ, VNE, VLT, VGE, VCL, VCH, VCR) */
-ALIGNED i16 cf_vce[N]; /* $vce:  vector compare extension register */
 
 VECTOR_OPERATION res_V(v16 vs, v16 vt)
 {
@@ -67,170 +59,156 @@ VECTOR_OPERATION res_M(v16 vs, v16 vt)
 #endif
 }
 
-/*
- * Op-code-accurate matrix of all the known RSP vector operations.
- * To do:  Either remove VMACQ, or add VRNDP, VRNDN, and VMULQ.
- *
- * Note that these are not our literal function names, just macro names.
- */
-VECTOR_OPERATION (*COP2_C2[8 * 8])(v16, v16) = {
-    VMULF  ,VMULU  ,res_M  ,res_M  ,VMUDL  ,VMUDM  ,VMUDN  ,VMUDH  , /* 000 */
-    VMACF  ,VMACU  ,res_M  ,res_M  ,VMADL  ,VMADM  ,VMADN  ,VMADH  , /* 001 */
-    VADD   ,VSUB   ,res_V  ,VABS   ,VADDC  ,VSUBC  ,res_V  ,res_V  , /* 010 */
-    res_V  ,res_V  ,res_V  ,res_V  ,res_V  ,VSAW   ,res_V  ,res_V  , /* 011 */
-    VLT    ,VEQ    ,VNE    ,VGE    ,VCL    ,VCH    ,VCR    ,VMRG   , /* 100 */
-    VAND   ,VNAND  ,VOR    ,VNOR   ,VXOR   ,VNXOR  ,res_V  ,res_V  , /* 101 */
-    VRCP   ,VRCPL  ,VRCPH  ,VMOV   ,VRSQ   ,VRSQL  ,VRSQH  ,VNOP   , /* 110 */
-    res_V  ,res_V  ,res_V  ,res_V  ,res_V  ,res_V  ,res_V  ,res_V  , /* 111 */
-}; /* 000     001     010     011     100     101     110     111 */
-
-#ifndef ARCH_MIN_SSE2
-u16 get_VCO(void)
+VECTOR_OPERATION (*COP2_C2[4 * 8*8])(v16, v16) = {
+#include "matrix.h"
+};
+
+#ifdef ARCH_MIN_SSE2
+static VECTOR_OPERATION (*const COP2_C2_SSE2[4 * 8*8])(v16, v16) = {
+#include "matrix.h"
+};
+
+#define VECTOR_MATRIX   COP2_C2_SSE2
+#include "handlers.h"
+
+vector_handler VECTOR_HANDLERS[4 * 8*8] = {
+    VECTOR_HANDLER_LIST
+};
+#endif
+
+#if defined(ARCH_MIN_SSSE3) && !defined(VU_ISA_DISPATCH)
+#include "transfer.h"
+
+static const vector_transfers VECTOR_TRANSFERS = VECTOR_TRANSFER_LIST;
+#endif
+
+#ifdef VU_ISA_DISPATCH
+#define CPUID_1_ECX_SSSE3       (1ul <<  9)
+#define CPUID_1_ECX_SSE4_1      (1ul << 19)
+#define CPUID_1_ECX_OSXSAVE     (1ul << 27)
+#define CPUID_1_ECX_AVX         (1ul << 28)
+#define CPUID_7_EBX_AVX2        (1ul <<  5)
+
+#define XCR0_SSE_AVX_STATE      0x00000006ul
+
+static void get_cpuid(u32 leaf, u32 regs[4])
 {
-    register u16 vco;
-
-    vco = 0x0000
-      | (cf_ne[0xF % 8] << 0xF)
-      | (cf_ne[0xE % 8] << 0xE)
-      | (cf_ne[0xD % 8] << 0xD)
-      | (cf_ne[0xC % 8] << 0xC)
-      | (cf_ne[0xB % 8] << 0xB)
-      | (cf_ne[0xA % 8] << 0xA)
-      | (cf_ne[0x9 % 8] << 0x9)
-      | (cf_ne[0x8 % 8] << 0x8)
-      | (cf_co[0x7 % 8] << 0x7)
-      | (cf_co[0x6 % 8] << 0x6)
-      | (cf_co[0x5 % 8] << 0x5)
-      | (cf_co[0x4 % 8] << 0x4)
-      | (cf_co[0x3 % 8] << 0x3)
-      | (cf_co[0x2 % 8] << 0x2)
-      | (cf_co[0x1 % 8] << 0x1)
-      | (cf_co[0x0 % 8] << 0x0);
-    return (vco); /* Big endian becomes little. */
+#ifdef _MSC_VER
+    int info[4];
+
+    __cpuid(info, 0);
+    if ((u32)info[0] < leaf) {
+        regs[0] = regs[1] = regs[2] = regs[3] = 0x00000000;
+        return;
+    }
+    __cpuidex(info, leaf, 0);
+    regs[0] = info[0];
+    regs[1] = info[1];
+    regs[2] = info[2];
+    regs[3] = info[3];
+#else
+    if (__get_cpuid_max(0, NULL) < leaf) {
+        regs[0] = regs[1] = regs[2] = regs[3] = 0x00000000;
+        return;
+    }
+    __cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    return;
 }
-u16 get_VCC(void)
+
+/*
+ * AVX2 needs the OS to save the upper halves of the YMM registers too, which
+ * is not something the CPUID feature bits alone can tell us.
+ */
+static u32 get_XCR0(void)
 {
-    register u16 vcc;
-
-    vcc = 0x0000
-      | (cf_clip[0xF % 8] << 0xF)
-      | (cf_clip[0xE % 8] << 0xE)
-      | (cf_clip[0xD % 8] << 0xD)
-      | (cf_clip[0xC % 8] << 0xC)
-      | (cf_clip[0xB % 8] << 0xB)
-      | (cf_clip[0xA % 8] << 0xA)
-      | (cf_clip[0x9 % 8] << 0x9)
-      | (cf_clip[0x8 % 8] << 0x8)
-      | (cf_comp[0x7 % 8] << 0x7)
-      | (cf_comp[0x6 % 8] << 0x6)
-      | (cf_comp[0x5 % 8] << 0x5)
-      | (cf_comp[0x4 % 8] << 0x4)
-      | (cf_comp[0x3 % 8] << 0x3)
-      | (cf_comp[0x2 % 8] << 0x2)
-      | (cf_comp[0x1 % 8] << 0x1)
-      | (cf_comp[0x0 % 8] << 0x0);
-    return (vcc); /* Big endian becomes little. */
+#ifdef _MSC_VER
+    return (u32)_xgetbv(0);
+#else
+    u32 eax, edx;
+
+    __asm__ __volatile__ ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (eax);
+#endif
 }
-u8 get_VCE(void)
+#endif
+
+void select_vector_ISA(void)
 {
-    unsigned int result;
-    register u8 vce;
-
-    result = 0x00
-      | (cf_vce[0x7] << 0x7)
-      | (cf_vce[0x6] << 0x6)
-      | (cf_vce[0x5] << 0x5)
-      | (cf_vce[0x4] << 0x4)
-      | (cf_vce[0x3] << 0x3)
-      | (cf_vce[0x2] << 0x2)
-      | (cf_vce[0x1] << 0x1)
-      | (cf_vce[0x0] << 0x0)
-    ;
-    vce = (u8)(result & 0xFF);
-    return (vce); /* Big endian becomes little. */
+#ifdef VU_ISA_DISPATCH
+    VECTOR_OPERATION (*const * matrix)(v16, v16);
+    const fused_multiplies * fused;
+    const vector_handler * handlers;
+    const vector_transfers * transfers;
+    u32 leaf_1[4], leaf_7[4];
+
+    get_cpuid(1, leaf_1);
+    get_cpuid(7, leaf_7);
+    matrix = NULL;
+    fused = NULL;
+    handlers = NULL;
+    transfers = NULL;
+    if (leaf_1[2] & CPUID_1_ECX_SSSE3) {
+        matrix = COP2_C2_SSSE3;
+        fused = &FUSED_MULTIPLIES_SSSE3;
+        handlers = VECTOR_HANDLERS_SSSE3;
+        transfers = &VECTOR_TRANSFERS_SSSE3; /* kept for SSE4.1 and AVX2 */
+    }
+    if (leaf_1[2] & CPUID_1_ECX_SSE4_1) {
+        matrix = COP2_C2_SSE4_1;
+        fused = &FUSED_MULTIPLIES_SSE4_1;
+        handlers = VECTOR_HANDLERS_SSE4_1;
+    }
+    if ((leaf_1[2] & CPUID_1_ECX_OSXSAVE) && (leaf_1[2] & CPUID_1_ECX_AVX))
+        if ((get_XCR0() & XCR0_SSE_AVX_STATE) == XCR0_SSE_AVX_STATE)
+            if (leaf_7[1] & CPUID_7_EBX_AVX2) {
+                matrix = COP2_C2_AVX2;
+                fused = &FUSED_MULTIPLIES_AVX2;
+                handlers = VECTOR_HANDLERS_AVX2;
+            }
+    if (matrix != NULL)
+        memcpy(COP2_C2, matrix, sizeof(COP2_C2));
+    if (fused != NULL)
+        FUSED_MULTIPLIES = *fused;
+    if (handlers != NULL)
+        memcpy(VECTOR_HANDLERS, handlers, sizeof(VECTOR_HANDLERS));
+    if (transfers != NULL)
+        set_vector_transfers(transfers);
+#elif defined(ARCH_MIN_SSSE3)
+    set_vector_transfers(&VECTOR_TRANSFERS);
+#endif
+    return;
 }
-#else
-u16 get_VCO(void)
-{
-    v16 xmm, hi, lo;
-    register u16 vco;
-
-    hi = _mm_load_si128((v16 *)cf_ne);
-    lo = _mm_load_si128((v16 *)cf_co);
 
 /*
- * Rotate Boolean storage from LSB to MSB.
+ * CFC2 and CTC2 resources
+ * The flags are already stored the way these move them.
  */
-    hi = _mm_slli_epi16(hi, 15);
-    lo = _mm_slli_epi16(lo, 15);
-
-    xmm = _mm_packs_epi16(lo, hi); /* Decompress INT16 Booleans to INT8 ones. */
-    vco = _mm_movemask_epi8(xmm) & 0x0000FFFF; /* PMOVMSKB combines each MSB. */
-    return (vco);
+u16 get_VCO(void)
+{
+    return (VCO);
 }
 u16 get_VCC(void)
 {
-    v16 xmm, hi, lo;
-    register u16 vcc;
-
-    hi = _mm_load_si128((v16 *)cf_clip);
-    lo = _mm_load_si128((v16 *)cf_comp);
-
-/*
- * Rotate Boolean storage from LSB to MSB.
- */
-    hi = _mm_slli_epi16(hi, 15);
-    lo = _mm_slli_epi16(lo, 15);
-
-    xmm = _mm_packs_epi16(lo, hi); /* Decompress INT16 Booleans to INT8 ones. */
-    vcc = _mm_movemask_epi8(xmm) & 0x0000FFFF; /* PMOVMSKB combines each MSB. */
-    return (vcc);
+    return (VCC);
 }
 u8 get_VCE(void)
 {
-    v16 xmm, hi, lo;
-    register u8 vce;
-
-    hi = _mm_setzero_si128();
-    lo = _mm_load_si128((v16 *)cf_vce);
-
-    lo = _mm_slli_epi16(lo, 15); /* Rotate Boolean storage from LSB to MSB. */
-
-    xmm = _mm_packs_epi16(lo, hi); /* Decompress INT16 Booleans to INT8 ones. */
-    vce = _mm_movemask_epi8(xmm) & 0x000000FF; /* PMOVMSKB combines each MSB. */
-    return (vce);
+    return (VCE);
 }
-#endif
 
-/*
- * CTC2 resources
- * not sure how to vectorize going the other direction into SSE2
- */
 void set_VCO(u16 vco)
 {
-    register unsigned int i;
-
-    for (i = 0; i < N; i++)
-        cf_co[i] = (vco >> (i + 0x0)) & 1;
-    for (i = 0; i < N; i++)
-        cf_ne[i] = (vco >> (i + 0x8)) & 1;
-    return; /* Little endian becomes big. */
+    VCO = vco;
+    return;
 }
 void set_VCC(u16 vcc)
 {
-    register unsigned int i;
-
-    for (i = 0; i < N; i++)
-        cf_comp[i] = (vcc >> (i + 0x0)) & 1;
-    for (i = 0; i < N; i++)
-        cf_clip[i] = (vcc >> (i + 0x8)) & 1;
-    return; /* Little endian becomes big. */
+    VCC = vcc;
+    return;
 }
 void set_VCE(u8 vce)
 {
-    register unsigned int i;
-
-    for (i = 0; i < N; i++)
-        cf_vce[i] = (vce >> i) & 1;
-    return; /* Little endian becomes big. */
+    VCE = vce;
+    return;
 }
@@ -15,8 +15,33 @@
 #ifndef _VU_H_
 #define _VU_H_
 
+/*
+ * The vector operations are compiled once for the SSE2 baseline, then again
+ * in vu_ssse3.c, vu_sse41.c and vu_avx2.c for the later Intel extensions,
+ * with select_vector_ISA() picking one set to use on whatever CPU we run on.
+ * Builds for just the host CPU (-march=native) define VU_NO_ISA_DISPATCH.
+ */
+#ifdef ARCH_MIN_AVX2
+#define ARCH_MIN_SSE4_1
+#endif
+#ifdef ARCH_MIN_SSE4_1
+#define ARCH_MIN_SSSE3
+#endif
+
 #if defined(ARCH_MIN_SSE2) && !defined(SSE2NEON)
 #include <emmintrin.h>
+#if !defined(VU_NO_ISA_DISPATCH)
+#define VU_ISA_DISPATCH
+#endif
+#endif
+#if defined(ARCH_MIN_SSSE3)
+#include <tmmintrin.h>
+#endif
+#if defined(ARCH_MIN_SSE4_1)
+#include <smmintrin.h>
+#endif
+#if defined(ARCH_MIN_AVX2)
+#include <immintrin.h>
 #endif
 
 #include "../my_types.h"
@@ -38,39 +63,22 @@
 #endif
 
 /*
- * We are going to need this for vector operations doing scalar things.
- * The divides and VSAW need bit-wise information from the instruction word.
- */
-extern u32 inst_word;
-
-/*
- * RSP virtual registers (of vector unit)
- * The most important are the 32 general-purpose vector registers.
- * The correct way to accurately store these is using big-endian vectors.
+ * The vector registers, the accumulator and the flags are kept in the
+ * rsp_context, together with everything else in the RSP's state.
  *
- * For ?WC2 we may need to do byte-precision access just as directly.
- * This is amended by using the `VU_S` and `VU_B` macros defined in `rsp.h`.
+ * Building with VU_WIDE_ACCUMULATOR (SSE2 and later only) keeps bits 47..16
+ * of each accumulator element together in one 32-bit lane of VACC_W, so
+ * that the multiply-accumulates can carry into them with plain 32-bit adds
+ * and clamp them with one pack.  Bits 15..0 stay a vector of their own in
+ * VACC_L, as nearly every other vector operation writes them and nothing
+ * else.
  */
-ALIGNED extern i16 VR[32][N << VR_STATIC_WRAPAROUND];
-
-/*
- * The RSP accumulator is a vector of 3 48-bit integers.  Nearly all of the
- * vector operations access it, but it's for multiply-accumulate operations.
- *
- * Access dimensions would be VACC[8][3] but are inverted for SIMD benefits.
- */
-ALIGNED extern i16 VACC[3][N];
-
-/*
- * When compiling without SSE2, we need to use a pointer to a destination
- * vector instead of an XMM register in the return slot of the function.
- * The vector "result" register will be emulated to serve this pointer
- * as a shared global rather than the return slot of a function call.
- */
-#ifndef ARCH_MIN_SSE2
-ALIGNED extern i16 V_result[N];
+#if defined(VU_WIDE_ACCUMULATOR) && !defined(ARCH_MIN_SSE2)
+#undef VU_WIDE_ACCUMULATOR
 #endif
 
+#include "../context.h"
+
 /*
  * accumulator-indexing macros
  */
@@ -78,6 +86,11 @@ ALIGNED extern i16 V_result[N];
 #define MD      01
 #define LO      02
 
+#ifdef VU_WIDE_ACCUMULATOR
+#define ACC_L(i)    (VACC_L)[i]
+#define ACC_M(i)    ((i16)(VACC_W[i] >>  0))
+#define ACC_H(i)    ((i16)(VACC_W[i] >> 16))
+#else
 #define VACC_L      (VACC[LO])
 #define VACC_M      (VACC[MD])
 #define VACC_H      (VACC[HI])
@@ -85,6 +98,7 @@ ALIGNED extern i16 V_result[N];
 #define ACC_L(i)    (VACC_L)[i]
 #define ACC_M(i)    (VACC_M)[i]
 #define ACC_H(i)    (VACC_H)[i]
+#endif
 
 #ifdef ARCH_MIN_SSE2
 typedef __m128i v16;
@@ -97,11 +111,103 @@ typedef pi16 v16;
 #else
 #define VECTOR_OPERATION    void
 #endif
+
+/*
+ * In the translation units for the later ISA variants, every operation is
+ * declared static, so that their definitions (which have no storage class)
+ * can reuse the same names without clashing with the SSE2 baseline's.
+ */
+#ifdef VU_ISA_VARIANT
+#define VECTOR_EXTERN       static VECTOR_OPERATION
+#else
 #define VECTOR_EXTERN       extern VECTOR_OPERATION
+#endif
 
 NOINLINE extern void message(const char* body);
 
-VECTOR_EXTERN (*COP2_C2[8*7 + 8])(v16, v16);
+extern VECTOR_OPERATION (*COP2_C2[4 * 8*8])(v16, v16);
+
+extern VECTOR_OPERATION res_V(v16 vs, v16 vt);
+extern VECTOR_OPERATION res_M(v16 vs, v16 vt);
+
+/*
+ * Some chains and pairs of multiplies are run at once by superinstructions
+ * in su.c (for which see fused_handler() there), through these instead of
+ * COP2_C2.  Each returns the last multiply's vd and stores the first's
+ * through a pointer to the vector register, or not at all if it is NULL.
+ */
+#ifdef ARCH_MIN_SSE2
+#define CHAIN_ACCUMULATE    0x1 /* VMADL starts it instead of VMUDL */
+#define CHAIN_ACC_LIVE      0x2 /* The accumulator is read after the chain. */
+
+typedef struct {
+    v16 (*mul_32x32)(v16 a_lo, v16 a_hi, v16 b_lo, v16 b_hi, pi16 vd_lo,
+        int chain);
+    v16 (*mulf_macf)(v16 vs, v16 vt, v16 vs_next, v16 vt_next, pi16 vd,
+        int chain);
+    v16 (*mul_pair[8])(v16 vs, v16 vt, v16 vs_next, v16 vt_next, pi16 vd,
+        int chain); /* VMULF..VMUDH by func, for two of them in a row */
+} fused_multiplies;
+
+extern fused_multiplies FUSED_MULTIPLIES;
+#endif
+
+/*
+ * COP2_C2 again, as handlers that also load vs and vt out of VR[] (with the
+ * element selection) and store vd, each with its operation inlined into it.
+ * su.c runs vector instructions through these, the recompiler through
+ * COP2_C2.  See handlers.h.
+ */
+#ifdef ARCH_MIN_SSE2
+typedef void (*vector_handler)(
+    unsigned int vd, unsigned int vs, unsigned int vt, unsigned int e);
+
+extern vector_handler VECTOR_HANDLERS[4 * 8*8];
+#endif
+
+/*
+ * LDV, LQV, LRV, LPV, LUV and LHV and the matching stores done with byte
+ * shuffles, for CPUs with SSSE3 (see transfer.h).  set_vector_transfers() in
+ * su.c puts them into the LWC2[] and SWC2[] tables in place of the plain
+ * versions.
+ */
+typedef void (*vector_transfer)(
+    unsigned int vt,
+    unsigned int element,
+    signed int offset,
+    unsigned int base
+);
+
+typedef struct {
+    vector_transfer LDV, LQV, LRV, LPV, LUV, LHV;
+    vector_transfer SDV, SQV, SRV, SPV, SUV, SHV;
+} vector_transfers;
+
+extern void set_vector_transfers(const vector_transfers * transfers);
+
+#ifdef VU_ISA_DISPATCH
+extern VECTOR_OPERATION (*const COP2_C2_SSSE3[4 * 8*8])(v16, v16);
+extern VECTOR_OPERATION (*const COP2_C2_SSE4_1[4 * 8*8])(v16, v16);
+extern VECTOR_OPERATION (*const COP2_C2_AVX2[4 * 8*8])(v16, v16);
+
+extern const fused_multiplies FUSED_MULTIPLIES_SSSE3;
+extern const fused_multiplies FUSED_MULTIPLIES_SSE4_1;
+extern const fused_multiplies FUSED_MULTIPLIES_AVX2;
+
+extern const vector_handler VECTOR_HANDLERS_SSSE3[4 * 8*8];
+extern const vector_handler VECTOR_HANDLERS_SSE4_1[4 * 8*8];
+extern const vector_handler VECTOR_HANDLERS_AVX2[4 * 8*8];
+
+extern const vector_transfers VECTOR_TRANSFERS_SSSE3;
+#endif
+
+/*
+ * Install the fastest set of vector operations the host CPU can run into
+ * COP2_C2[], VECTOR_HANDLERS[] and FUSED_MULTIPLIES, and the fastest vector
+ * transfers into LWC2[] and SWC2[].  Only the tables' contents change, never
+ * their addresses.
+ */
+extern void select_vector_ISA(void);
 
 #ifdef ARCH_MIN_SSE2
 
@@ -229,24 +335,132 @@ VECTOR_EXTERN (*COP2_C2[8*7 + 8])(v16, v16);
 #endif
 
 /*
- * Many vector units have pairs of "vector condition flags" registers.
- * In SGI's vector unit implementation, these are denoted as the
- * "vector control registers" under coprocessor 2.
+ * The flags are kept packed, the same as CFC2 reads them out:  bit `i` of
+ * each byte is the flag for vector element `i`.  $vco has the carry-out in
+ * its low byte and NOTEQUAL in its high byte, and $vcc has the compare code
+ * in its low byte and the clip test in its high byte.
  *
- * VCF-0 is the carry-out flags register:  $vco.
- * VCF-1 is the compare code flags register:  $vcc.
- * VCF-2 is the compare extension flags register:  $vce.
- * There is no fourth RSP flags register.
+ * Operations that need them per element expand eight of the bits at a time
+ * to a vector of either masks (all 1s or all 0s) or Booleans (1 or 0).
+ */
+#ifdef ARCH_MIN_SSE2
+static INLINE v16 flags_to_mask(unsigned int flags)
+{
+    const v16 bits = _mm_setr_epi16(
+        0x0001, 0x0002, 0x0004, 0x0008, 0x0010, 0x0020, 0x0040, 0x0080
+    );
+    v16 xmm;
+
+    xmm = _mm_set1_epi16((i16)flags);
+    xmm = _mm_and_si128(xmm, bits);
+    return _mm_cmpeq_epi16(xmm, bits);
+}
+static INLINE unsigned int mask_to_flags(v16 mask)
+{
+    mask = _mm_packs_epi16(mask, _mm_setzero_si128());
+    return (_mm_movemask_epi8(mask) & 0x000000FF);
+}
+#endif
+
+/*
+ * the vt operand of a vector operation, VR[vt] with the elements its 4-bit
+ * element specifier `e` selects:
+ *     0, 1:  all of them, in order
+ *     2, 3:  the even or the odd ones, each copied to its pair (0q, 1q)
+ *     4..7:  one element of each half, copied to all four in the half (#h)
+ *     8..15:  element e - 8, copied to all eight (#w)
+ */
+#ifdef ARCH_MIN_SSE2
+#define SELECT_ELEMENT(i)   (2*(i) + 0), (2*(i) + 1)
+#define SELECT_ELEMENTS(a, b, c, d, e, f, g, h) { \
+    SELECT_ELEMENT(a), SELECT_ELEMENT(b), SELECT_ELEMENT(c), SELECT_ELEMENT(d),\
+    SELECT_ELEMENT(e), SELECT_ELEMENT(f), SELECT_ELEMENT(g), SELECT_ELEMENT(h),\
+}
+
+static INLINE v16 vector_select(unsigned int vt, unsigned int e)
+{
+#ifdef ARCH_MIN_SSSE3
+    static ALIGNED const u8 masks[16][16] = {
+        SELECT_ELEMENTS(0, 1, 2, 3, 4, 5, 6, 7),
+        SELECT_ELEMENTS(0, 1, 2, 3, 4, 5, 6, 7),
+        SELECT_ELEMENTS(0, 0, 2, 2, 4, 4, 6, 6),
+        SELECT_ELEMENTS(1, 1, 3, 3, 5, 5, 7, 7),
+        SELECT_ELEMENTS(0, 0, 0, 0, 4, 4, 4, 4),
+        SELECT_ELEMENTS(1, 1, 1, 1, 5, 5, 5, 5),
+        SELECT_ELEMENTS(2, 2, 2, 2, 6, 6, 6, 6),
+        SELECT_ELEMENTS(3, 3, 3, 3, 7, 7, 7, 7),
+        SELECT_ELEMENTS(0, 0, 0, 0, 0, 0, 0, 0),
+        SELECT_ELEMENTS(1, 1, 1, 1, 1, 1, 1, 1),
+        SELECT_ELEMENTS(2, 2, 2, 2, 2, 2, 2, 2),
+        SELECT_ELEMENTS(3, 3, 3, 3, 3, 3, 3, 3),
+        SELECT_ELEMENTS(4, 4, 4, 4, 4, 4, 4, 4),
+        SELECT_ELEMENTS(5, 5, 5, 5, 5, 5, 5, 5),
+        SELECT_ELEMENTS(6, 6, 6, 6, 6, 6, 6, 6),
+        SELECT_ELEMENTS(7, 7, 7, 7, 7, 7, 7, 7),
+    };
+
+    return _mm_shuffle_epi8(*(v16 *)VR[vt], *(const v16 *)masks[e]);
+#elif defined(__ARM_NEON__)
+    v16 target;
+
+    if (e >= 0x8)
+        return _mm_set1_epi16(VR[vt][e - 0x8]);
+    if (e >= 0x4)
+        return (v16)vcombine_s16(vdup_n_s16(VR[vt][0 + e - 0x4]),
+                                 vdup_n_s16(VR[vt][4 + e - 0x4]));
+    if (e >= 0x2) {
+        target = (v16)vld1q_u16(&VR[vt][e - 0x2]);
+        target = (v16)vshlq_n_u32((uint32x4_t)target, 16);
+        return (v16)vorrq_u16((uint16x8_t)target,
+                              (uint16x8_t)vshrq_n_u32((uint32x4_t)target, 16));
+    }
+    return (*(v16 *)VR[vt]);
+#else
+    v16 target;
+
+/*
+ * Without PSHUFB, the shuffles need their selections as immediates, so we
+ * shift the selected element down to the bottom of its pair or half first.
  */
-extern u16 VCO;
-extern u16 VCC;
-extern u8 VCE;
-
-ALIGNED extern i16 cf_ne[N];
-ALIGNED extern i16 cf_co[N];
-ALIGNED extern i16 cf_clip[N];
-ALIGNED extern i16 cf_comp[N];
-ALIGNED extern i16 cf_vce[N];
+    if (e >= 0x8)
+        return _mm_set1_epi16(VR[vt][e - 0x8]);
+    target = *(v16 *)VR[vt];
+    if (e >= 0x4) {
+        target = _mm_srl_epi64(target, _mm_cvtsi32_si128(16 * (e - 0x4)));
+        target = _mm_shufflelo_epi16(target, _MM_SHUFFLE(0, 0, 0, 0));
+        return _mm_shufflehi_epi16(target, _MM_SHUFFLE(0, 0, 0, 0));
+    }
+    if (e >= 0x2) {
+        target = _mm_srl_epi32(target, _mm_cvtsi32_si128(16 * (e - 0x2)));
+        target = _mm_slli_epi32(target, 16);
+        return _mm_or_si128(target, _mm_srli_epi32(target, 16));
+    }
+    return (target);
+#endif
+}
+
+#undef SELECT_ELEMENTS
+#undef SELECT_ELEMENT
+#endif
+
+static INLINE void flags_to_bools(pi16 bools, unsigned int flags)
+{
+    register unsigned int i;
+
+    for (i = 0; i < N; i++)
+        bools[i] = (flags >> i) & 1;
+    return;
+}
+static INLINE unsigned int bools_to_flags(const i16 * bools)
+{
+    unsigned int flags;
+    register unsigned int i;
+
+    flags = 0x00;
+    for (i = 0; i < N; i++)
+        flags |= (bools[i] & 1) << i;
+    return (flags);
+}
 
 extern u16 get_VCO(void);
 extern u16 get_VCC(void);
@@ -0,0 +1,49 @@
+/******************************************************************************\
+* Project:  MSP Emulation Layer for Vector Unit Computational Operations       *
+* License:  CC0 Public Domain Dedication                                       *
+*                                                                              *
+* To the extent possible under law, the author(s) have dedicated all copyright *
+* and related and neighboring rights to this software to the public domain     *
+* worldwide. This software is distributed without any warranty.                *
+*                                                                              *
+* You should have received a copy of the CC0 Public Domain Dedication along    *
+* with this software.                                                          *
+* If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.             *
+\******************************************************************************/
+
+/*
+ * all of the vector operations again, for CPUs with AVX2
+ * (Compile this file with -mavx2, or the equivalent for your compiler.)
+ */
+#define ARCH_MIN_AVX2
+#define VU_ISA_VARIANT
+
+#include "vu.h"
+
+#ifdef VU_ISA_DISPATCH
+#include "multiply.c"
+#include "add.c"
+#include "select.c"
+#include "logical.c"
+#include "divide.c"
+
+VECTOR_OPERATION (*const COP2_C2_AVX2[4 * 8*8])(v16, v16) = {
+#include "matrix.h"
+};
+
+#define VECTOR_MATRIX   COP2_C2_AVX2
+#include "handlers.h"
+
+const vector_handler VECTOR_HANDLERS_AVX2[4 * 8*8] = {
+    VECTOR_HANDLER_LIST
+};
+
+const fused_multiplies FUSED_MULTIPLIES_AVX2 = {
+    mul_32x32,
+    mulf_macf,
+    {
+        mulf_pair, mulu_pair, NULL, NULL,
+        mudl_pair, mudm_pair, mudn_pair, mudh_pair,
+    },
+};
+#endif